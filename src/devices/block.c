@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include "devices/ide.h"
 #include "threads/malloc.h"
+#include "threads/thread.h"
 
 /* A block device. */
 struct block
@@ -123,6 +124,7 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
   check_sector (block, sector);
   block->ops->read (block->aux, sector, buffer);
   block->read_cnt++;
+  thread_current ()->sectors_read++;
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -2,15 +2,22 @@
 #include <debug.h>
 #include "devices/intq.h"
 #include "devices/serial.h"
+#include "threads/synch.h"
 
 /* Stores keys from the keyboard and serial port. */
 static struct intq buffer;
 
+/* Threads waiting in input_getc_unless().  Unlike BUFFER, which
+   lets one thread wait at a time, any number may wait here, and
+   each wait can be cancelled. */
+static struct semaphore key_ready;
+
 /* Initializes the input buffer. */
 void
 input_init (void) 
 {
   intq_init (&buffer);
+  sema_init (&key_ready, 0);
 }
 
 /* Adds a key to the input buffer.
@@ -23,6 +30,10 @@ input_putc (uint8_t key)
 
   intq_putc (&buffer, key);
   serial_notify ();
+
+  /* Wake every waiter; those that find no key left wait again. */
+  while (!list_empty (&key_ready.waiters))
+    sema_up (&key_ready);
 }
 
 /* Retrieves a key from the input buffer.
@@ -41,6 +52,29 @@ input_getc (void)
   return key;
 }
 
+/* Retrieves a key from the input buffer into *KEY, waiting for
+   a key to be pressed if the buffer is empty, unless *CANCEL is
+   true or becomes true while waiting, as in sema_down_unless().
+   Returns true if successful, false if the wait was cancelled. */
+bool
+input_getc_unless (uint8_t *key, const volatile bool *cancel) 
+{
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  while (intq_empty (&buffer))
+    if (!sema_down_unless (&key_ready, cancel))
+      {
+        intr_set_level (old_level);
+        return false;
+      }
+  *key = intq_getc (&buffer);
+  serial_notify ();
+  intr_set_level (old_level);
+
+  return true;
+}
+
 /* Returns true if the input buffer is full,
    false otherwise.
    Interrupts must be off. */
@@ -8,11 +8,18 @@
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
+#include "userprog/exec-cache.h"
+#include "userprog/futex.h"
+#include "userprog/syscall.h"
 #endif
 #ifdef FILESYS
 #include "devices/block.h"
 #include "filesys/filesys.h"
 #endif
+#ifdef VM
+#include "devices/swap.h"
+#include "vm/ksm.h"
+#endif
 
 /* Keyboard control register port. */
 #define CONTROL_REG 0x64
@@ -129,5 +136,12 @@ print_stats (void)
   kbd_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
+  syscall_print_stats ();
+  exec_cache_print_stats ();
+  futex_print_stats ();
+#endif
+#ifdef VM
+  swap_print_stats ();
+  ksm_print_stats ();
 #endif
 }
@@ -1,10 +1,16 @@
 #include "devices/swap.h"
 #include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <inttypes.h>
+#include <list.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 /* Pointer to the swap device */
 static struct block *swap_device;
@@ -12,16 +18,96 @@ static struct block *swap_device;
 /* Pointer to a bitmap to track used swap pages */
 static struct bitmap *swap_bitmap;
 
-/* Lock that protects swap_bitmap from unsynchronised access */
+/* Lock that protects swap_bitmap and the compressed pool from
+   unsynchronised access */
 static struct lock swap_lock;
 
 /* Number of sectors needed to store a page */
 #define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
 
-/* Sets up the swap space */
+/* Compressed swap pool.
+
+   Pages handed to swap_out() are first compressed into an
+   in-memory pool and only written to the swap device when the
+   pool runs over its budget, at which point the oldest pooled
+   pages are written back.  Every pooled page still owns the swap
+   slot it was given, so writeback never has to allocate.
+
+   Pages made of a single repeated word (most commonly zero pages)
+   are recorded by that word alone.  Other pages are compressed
+   with a word-level zero-run encoding: a token byte whose top bit
+   is clear introduces a run of (token + 1) zero words, while a set
+   top bit introduces (token & 0x7f) + 1 literal words that follow
+   it.  Pages that do not shrink below ZSWAP_MAX_LEN go straight
+   to disk. */
+
+/* Largest compressed page the pool accepts, in bytes. */
+#define ZSWAP_MAX_LEN (PGSIZE / 4 * 3)
+
+/* Words in a page and the longest run a token can describe. */
+#define PAGE_WORDS (PGSIZE / sizeof (uint32_t))
+#define TOKEN_RUN_MAX 128
+#define TOKEN_LITERAL 0x80
+
+/* A page held in the compressed pool. */
+struct zswap_entry
+  {
+    struct list_elem elem;      /* Element in pool_lru. */
+    size_t slot;                /* Swap slot owned by the page. */
+    size_t length;              /* Compressed length, 0 if same-filled. */
+    uint32_t fill;              /* Repeated word of a same-filled page. */
+    uint8_t *data;              /* Compressed contents, or NULL. */
+  };
+
+/* Pooled pages indexed by swap slot, NULL when the slot's data is
+   on disk (or the slot is free). */
+static struct zswap_entry **pool_entries;
+
+/* Pooled pages, oldest first. */
+static struct list pool_lru;
+
+/* Bytes of memory taken by the pool's entries and their
+   compressed data, as allocated by malloc(), and its budget. */
+static size_t pool_bytes;
+static size_t pool_limit;
+
+/* Scratch buffers, only used with swap_lock held. */
+static uint8_t compress_buf[ZSWAP_MAX_LEN];
+static void *writeback_page;
+
+/* Statistics. */
+static long long zswap_stored_cnt;      /* Pages compressed into the pool. */
+static long long zswap_same_cnt;        /* ...of which were same-filled. */
+static long long zswap_reject_cnt;      /* Pages too big to compress. */
+static long long zswap_writeback_cnt;   /* Pooled pages written to disk. */
+static long long zswap_load_cnt;        /* Pages swapped in from the pool. */
+static long long swap_out_cnt;          /* Pages evicted to swap. */
+static long long swap_in_cnt;           /* Pages brought back in. */
+static long long swap_write_cnt;        /* Pages written to disk. */
+static long long swap_read_cnt;         /* Pages read from disk. */
+
+static size_t zswap_entry_size (size_t length);
+static bool zswap_store (size_t slot, const void *vaddr);
+static void zswap_writeback_oldest (void);
+static void zswap_invalidate (size_t slot);
+static void zswap_load (const struct zswap_entry *, void *page);
+static size_t zswap_compress (const uint32_t *page, uint8_t *dst);
+static void zswap_decompress (const uint8_t *src, size_t length,
+                              uint32_t *page);
+static void swap_write_page (size_t slot, const void *vaddr);
+static void swap_read_page (size_t slot, void *vaddr);
+static void fill_test_page (uint32_t *page, unsigned seed, size_t len);
+static void check_test_page (const uint32_t *page, unsigned seed,
+                             size_t len);
+
+/* Sets up the swap space, with a compressed pool of at most
+   POOL_PAGES pages in front of it.  A POOL_PAGES of 0 disables the
+   pool. */
 void
-swap_init (void) 
+swap_init (size_t pool_pages)
 {
+  size_t slot_cnt = 0;
+
   // locate the swap block allocated to the kernel
   swap_device = block_get_role (BLOCK_SWAP);
   if (swap_device == NULL) {
@@ -29,47 +115,78 @@ swap_init (void)
       swap_bitmap = bitmap_create (0);
   } else {
     // create a bitmap with 1 slot per page-sized chunk of memory on the swap block
-    swap_bitmap = bitmap_create (block_size (swap_device) / PAGE_SECTORS);
+    slot_cnt = block_size (swap_device) / PAGE_SECTORS;
+    swap_bitmap = bitmap_create (slot_cnt);
   }
-  
+
   if (swap_bitmap == NULL){
     PANIC ("couldn't create swap bitmap");
   }
   lock_init (&swap_lock);
+
+  // the pool sits in front of the device, so it needs slots to hand out
+  list_init (&pool_lru);
+  if (slot_cnt == 0 || pool_pages == 0)
+    return;
+
+  pool_entries = calloc (slot_cnt, sizeof *pool_entries);
+  writeback_page = palloc_get_page (0);
+  if (pool_entries == NULL || writeback_page == NULL)
+    {
+      printf ("no memory for compressed swap pool--pool disabled\n");
+      free (pool_entries);
+      palloc_free_page (writeback_page);
+      pool_entries = NULL;
+      return;
+    }
+  pool_limit = pool_pages * PGSIZE;
 }
 
 /* Swaps page at VADDR out of memory, returns the swap-slot used */
 size_t
-swap_out (const void *vaddr) 
+swap_out (const void *vaddr)
 {
   // find available swap-slot for the page to be swapped out
   lock_acquire (&swap_lock);
   size_t slot = bitmap_scan_and_flip (swap_bitmap, 0, 1, false);
-  lock_release (&swap_lock);
-  if (slot == BITMAP_ERROR) 
-    return BITMAP_ERROR; 
+  if (slot == BITMAP_ERROR)
+    {
+      lock_release (&swap_lock);
+      return BITMAP_ERROR;
+    }
 
-  // calculate block sector from swap-slot number
-  size_t sector = slot * PAGE_SECTORS;
-  
-  // loop over each sector of the page, copying it from memory into swap
-  for (size_t i = 0; i < PAGE_SECTORS; i++)
-    block_write (swap_device, sector + i, vaddr + i * BLOCK_SECTOR_SIZE);
+  swap_out_cnt++;
+
+  // keep the page in memory if it compresses into the pool
+  bool pooled = zswap_store (slot, vaddr);
+  lock_release (&swap_lock);
 
+  if (!pooled)
+    swap_write_page (slot, vaddr);
   return slot;
 }
 
 /* Swaps page on disk in swap-slot SLOT into memory at VADDR */
 void
-swap_in (void *vaddr, size_t slot) 
+swap_in (void *vaddr, size_t slot)
 {
-  // calculate block sector from swap-slot number
-  size_t sector = slot * PAGE_SECTORS;
+  // pooled pages never reached the disk, so look there first
+  lock_acquire (&swap_lock);
+  swap_in_cnt++;
+  struct zswap_entry *e = pool_entries != NULL ? pool_entries[slot] : NULL;
+  if (e != NULL)
+    {
+      zswap_load (e, vaddr);
+      zswap_load_cnt++;
+      zswap_invalidate (slot);
+      bitmap_reset (swap_bitmap, slot);
+      lock_release (&swap_lock);
+      return;
+    }
+  lock_release (&swap_lock);
+
+  swap_read_page (slot, vaddr);
 
-  // loop over each sector of the page, copying it from swap into memory
-  for (size_t i = 0; i < PAGE_SECTORS; i++)
-    block_read (swap_device, sector + i, vaddr + i * BLOCK_SECTOR_SIZE);
-  
   // clear the swap-slot previously used by this page
   swap_drop (slot);
 }
@@ -78,5 +195,334 @@ swap_in (void *vaddr, size_t slot)
 void
 swap_drop (size_t slot)
 {
+  lock_acquire (&swap_lock);
+  zswap_invalidate (slot);
   bitmap_reset (swap_bitmap, slot);
+  lock_release (&swap_lock);
+}
+
+/* Prints swap and compressed pool statistics. */
+void
+swap_print_stats (void)
+{
+  printf ("Swap: %lld evictions, %lld swap-ins, "
+          "%lld pages written, %lld pages read\n",
+          swap_out_cnt, swap_in_cnt, swap_write_cnt, swap_read_cnt);
+  printf ("Zswap: %lld pages stored (%lld same-filled), %lld rejected, "
+          "%lld written back, %lld loaded, %zu bytes pooled\n",
+          zswap_stored_cnt, zswap_same_cnt, zswap_reject_cnt,
+          zswap_writeback_cnt, zswap_load_cnt, pool_bytes);
+}
+
+/* Self-test for swap.  Swaps out and back in a zero page and a
+   same-filled page, which the pool keeps as one word each, two
+   pages that compress, and one that does not and so goes to
+   disk.  Checks that a pooled page is charged for all the memory
+   malloc() gives it.  Then swaps out more pages than the pool can
+   hold, so that some are written back, and checks that all of
+   them come back intact. */
+void
+swap_self_test (void)
+{
+  static const size_t lens[] = {0, 0, PAGE_WORDS / 8, PAGE_WORDS / 4,
+                                PAGE_WORDS};
+  long long writeback_cnt = zswap_writeback_cnt;
+  size_t *slots;
+  size_t before;
+  size_t cnt;
+  void *page;
+  size_t i;
+
+  printf ("Testing swap...");
+  if (swap_device == NULL)
+    {
+      printf ("skipped, no swap device.\n");
+      return;
+    }
+  page = palloc_get_page (PAL_ASSERT);
+
+  for (i = 0; i < sizeof lens / sizeof *lens; i++)
+    {
+      size_t slot;
+
+      fill_test_page (page, i, lens[i]);
+      slot = swap_out (page);
+      if (slot == BITMAP_ERROR)
+        PANIC ("swap device full");
+      memset (page, 0xcc, PGSIZE);
+      swap_in (page, slot);
+      check_test_page (page, i, lens[i]);
+    }
+
+  /* Over 1 kB of compressed data takes a whole page. */
+  if (pool_entries != NULL)
+    {
+      size_t slot;
+
+      before = pool_bytes;
+      fill_test_page (page, 1, PAGE_WORDS / 4);
+      slot = swap_out (page);
+      ASSERT (slot != BITMAP_ERROR && pool_entries[slot] != NULL);
+      ASSERT (pool_bytes - before >= PGSIZE);
+      swap_drop (slot);
+      ASSERT (pool_bytes == before);
+    }
+
+  cnt = pool_limit / PGSIZE + 2;
+  slots = malloc (cnt * sizeof *slots);
+  ASSERT (slots != NULL);
+  for (i = 0; i < cnt; i++)
+    {
+      fill_test_page (page, i, PAGE_WORDS / 4);
+      slots[i] = swap_out (page);
+      if (slots[i] == BITMAP_ERROR)
+        PANIC ("swap device full");
+    }
+  ASSERT (pool_entries == NULL || zswap_writeback_cnt > writeback_cnt);
+  for (i = 0; i < cnt; i++)
+    {
+      swap_in (page, slots[i]);
+      check_test_page (page, i, PAGE_WORDS / 4);
+    }
+
+  free (slots);
+  palloc_free_page (page);
+  printf ("done.\n");
+}
+
+/* Fills PAGE for swap_self_test() with LEN words made from SEED,
+   followed by zeros.  A LEN of 0 fills the page with SEED. */
+static void
+fill_test_page (uint32_t *page, unsigned seed, size_t len)
+{
+  for (size_t i = 0; i < PAGE_WORDS; i++)
+    if (i < len)
+      page[i] = ((seed + 1) * 0x9e3779b1u + i * 0x85ebca6bu) | 1;
+    else
+      page[i] = len == 0 ? seed : 0;
+}
+
+/* Panics unless PAGE holds what fill_test_page() put there. */
+static void
+check_test_page (const uint32_t *page, unsigned seed, size_t len)
+{
+  static uint32_t expected[PAGE_WORDS];
+
+  fill_test_page (expected, seed, len);
+  for (size_t i = 0; i < PAGE_WORDS; i++)
+    if (page[i] != expected[i])
+      PANIC ("swapped page %u (%zu words) changed at word %zu",
+             seed, len, i);
+}
+
+/* Returns the bytes of memory that a pool entry holding LENGTH
+   bytes of compressed data takes up.  malloc() rounds small
+   requests up to a power of 2 and gives requests over 1 kB
+   whole pages, so this can be well over LENGTH. */
+static size_t
+zswap_entry_size (size_t length)
+{
+  return malloc_size (sizeof (struct zswap_entry)) + malloc_size (length);
+}
+
+/* Tries to store the page at VADDR in the compressed pool under
+   swap-slot SLOT, writing back older pages if the pool is full.
+   Returns false if the page should go to disk instead.
+   Must be called with swap_lock held. */
+static bool
+zswap_store (size_t slot, const void *vaddr)
+{
+  const uint32_t *words = vaddr;
+  struct zswap_entry *e;
+  size_t length = 0;
+  size_t size;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&swap_lock));
+  if (pool_entries == NULL)
+    return false;
+
+  // same-filled pages only need to remember the repeated word
+  for (i = 1; i < PAGE_WORDS; i++)
+    if (words[i] != words[0])
+      break;
+  if (i < PAGE_WORDS)
+    {
+      length = zswap_compress (words, compress_buf);
+      if (length == 0 || zswap_entry_size (length) > pool_limit)
+        {
+          zswap_reject_cnt++;
+          return false;
+        }
+    }
+
+  size = zswap_entry_size (length);
+  while (pool_bytes + size > pool_limit)
+    zswap_writeback_oldest ();
+
+  e = malloc (sizeof *e);
+  if (e == NULL)
+    return false;
+  e->data = NULL;
+  if (length > 0)
+    {
+      e->data = malloc (length);
+      if (e->data == NULL)
+        {
+          free (e);
+          return false;
+        }
+      memcpy (e->data, compress_buf, length);
+    }
+  else
+    zswap_same_cnt++;
+
+  e->slot = slot;
+  e->length = length;
+  e->fill = words[0];
+  pool_entries[slot] = e;
+  list_push_back (&pool_lru, &e->elem);
+  pool_bytes += size;
+  zswap_stored_cnt++;
+  return true;
+}
+
+/* Evicts the oldest page from the pool, writing it to its swap
+   slot on disk.  The disk write happens with swap_lock held so
+   that the slot cannot be swapped in half-written. */
+static void
+zswap_writeback_oldest (void)
+{
+  ASSERT (lock_held_by_current_thread (&swap_lock));
+  ASSERT (!list_empty (&pool_lru));
+
+  struct zswap_entry *e = list_entry (list_front (&pool_lru),
+                                      struct zswap_entry, elem);
+  size_t slot = e->slot;
+  zswap_load (e, writeback_page);
+  zswap_invalidate (slot);
+
+  swap_write_page (slot, writeback_page);
+  zswap_writeback_cnt++;
+}
+
+/* Releases the pooled copy of swap-slot SLOT, if any.
+   Must be called with swap_lock held. */
+static void
+zswap_invalidate (size_t slot)
+{
+  struct zswap_entry *e;
+
+  if (pool_entries == NULL || (e = pool_entries[slot]) == NULL)
+    return;
+
+  pool_entries[slot] = NULL;
+  list_remove (&e->elem);
+  pool_bytes -= zswap_entry_size (e->length);
+  free (e->data);
+  free (e);
+}
+
+/* Restores the page held by pool entry E into PAGE. */
+static void
+zswap_load (const struct zswap_entry *e, void *page)
+{
+  if (e->length == 0)
+    {
+      uint32_t *words = page;
+      for (size_t i = 0; i < PAGE_WORDS; i++)
+        words[i] = e->fill;
+    }
+  else
+    zswap_decompress (e->data, e->length, page);
+}
+
+/* Compresses the page at PAGE into DST, which must hold
+   ZSWAP_MAX_LEN bytes.  Returns the compressed length, or 0 if the
+   page does not fit. */
+static size_t
+zswap_compress (const uint32_t *page, uint8_t *dst)
+{
+  size_t out = 0;
+  size_t i = 0;
+
+  while (i < PAGE_WORDS)
+    {
+      size_t run = 0;
+      if (page[i] == 0)
+        {
+          while (i + run < PAGE_WORDS && run < TOKEN_RUN_MAX
+                 && page[i + run] == 0)
+            run++;
+          if (out + 1 > ZSWAP_MAX_LEN)
+            return 0;
+          dst[out++] = run - 1;
+        }
+      else
+        {
+          // a single zero word between literals costs more as a run
+          while (i + run < PAGE_WORDS && run < TOKEN_RUN_MAX
+                 && (page[i + run] != 0
+                     || (i + run + 1 < PAGE_WORDS && page[i + run + 1] != 0)))
+            run++;
+          if (out + 1 + run * sizeof (uint32_t) > ZSWAP_MAX_LEN)
+            return 0;
+          dst[out++] = TOKEN_LITERAL | (run - 1);
+          memcpy (dst + out, page + i, run * sizeof (uint32_t));
+          out += run * sizeof (uint32_t);
+        }
+      i += run;
+    }
+  return out;
+}
+
+/* Decompresses LENGTH bytes at SRC, produced by zswap_compress(),
+   into the page at PAGE. */
+static void
+zswap_decompress (const uint8_t *src, size_t length, uint32_t *page)
+{
+  const uint8_t *end = src + length;
+  size_t i = 0;
+
+  while (src < end)
+    {
+      uint8_t token = *src++;
+      size_t run = (token & ~TOKEN_LITERAL) + 1;
+      ASSERT (i + run <= PAGE_WORDS);
+      if (token & TOKEN_LITERAL)
+        {
+          memcpy (page + i, src, run * sizeof (uint32_t));
+          src += run * sizeof (uint32_t);
+        }
+      else
+        memset (page + i, 0, run * sizeof (uint32_t));
+      i += run;
+    }
+  ASSERT (i == PAGE_WORDS);
+}
+
+/* Writes the page at VADDR to swap-slot SLOT on disk. */
+static void
+swap_write_page (size_t slot, const void *vaddr)
+{
+  // calculate block sector from swap-slot number
+  size_t sector = slot * PAGE_SECTORS;
+
+  // loop over each sector of the page, copying it from memory into swap
+  for (size_t i = 0; i < PAGE_SECTORS; i++)
+    block_write (swap_device, sector + i, vaddr + i * BLOCK_SECTOR_SIZE);
+  swap_write_cnt++;
+}
+
+/* Reads swap-slot SLOT from disk into the page at VADDR. */
+static void
+swap_read_page (size_t slot, void *vaddr)
+{
+  // calculate block sector from swap-slot number
+  size_t sector = slot * PAGE_SECTORS;
+
+  // loop over each sector of the page, copying it from swap into memory
+  for (size_t i = 0; i < PAGE_SECTORS; i++)
+    block_read (swap_device, sector + i, vaddr + i * BLOCK_SECTOR_SIZE);
+  swap_read_cnt++;
 }
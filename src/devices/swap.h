@@ -3,9 +3,14 @@
 
 #include <stddef.h>
 
-void swap_init (void);
+/* Default size of the compressed swap pool, in pages. */
+#define SWAP_POOL_PAGES 64
+
+void swap_init (size_t pool_pages);
 size_t swap_out (const void *vaddr);
 void swap_in (void *vaddr, size_t slot);
 void swap_drop (size_t slot);
+void swap_print_stats (void);
+void swap_self_test (void);
 
 #endif /* devices/swap.h */
@@ -3,8 +3,11 @@
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include <vclock.h>
 #include "devices/pit.h"
+#include "devices/rtc.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
   
@@ -24,12 +27,16 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Clock page, which user processes map read-only. */
+static struct vclock *vclock;
+
 /* Info for a sleeping thread. */
 struct sleeper
   {
     struct list_elem elem;
     int64_t sleep_until; /* Ticks that this thread should sleep for. */
-    struct semaphore sema;
+    struct semaphore *sema;  /* Upped when the time comes. */
+    bool expired;            /* Set when SEMA is upped for timeout. */
   };
 
 /* List of sleepers. */
@@ -41,6 +48,7 @@ static intr_handler_func timer_interrupt;
 static bool thread_compare_sleep_ticks (const struct list_elem *a, 
                                         const struct list_elem *b, 
                                         void *aux UNUSED);
+static void wait_for_tick (void);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
@@ -48,25 +56,38 @@ static void real_time_delay (int64_t num, int32_t denom);
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    registers the corresponding interrupt, and initialize the
-   list for sleeping threads. */
+   list for sleeping threads and the clock page. */
 void
 timer_init (void) 
 {
+  vclock = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  vclock->tick_freq = TIMER_FREQ;
+  vclock->boot_time = rtc_get_time ();
+
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 
   list_init (&sleepers);
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Calibrates loops_per_tick, used to implement brief delays,
+   and the time-stamp counter against the timer, for the clock
+   page. */
 void
 timer_calibrate (void) 
 {
   unsigned high_bit, test_bit;
+  int64_t start_ticks;
+  uint64_t start_tsc;
+  enum intr_level old_level;
 
   ASSERT (intr_get_level () == INTR_ON);
   printf ("Calibrating timer...  ");
 
+  wait_for_tick ();
+  start_ticks = ticks;
+  start_tsc = timer_cycles ();
+
   /* Approximate loops_per_tick as the largest power-of-two
      still less than one timer tick. */
   loops_per_tick = 1u << 10;
@@ -82,6 +103,18 @@ timer_calibrate (void)
     if (!too_many_loops (high_bit | test_bit))
       loops_per_tick |= test_bit;
 
+  /* Both samples of the time-stamp counter are taken just after a
+     tick, so it has run for a whole number of ticks. */
+  wait_for_tick ();
+  old_level = intr_disable ();
+  vclock->seq++;
+  barrier ();
+  vclock->tsc_per_tick = ((timer_cycles () - start_tsc)
+                          / (ticks - start_ticks));
+  barrier ();
+  vclock->seq++;
+  intr_set_level (old_level);
+
   printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
 }
 
@@ -107,6 +140,20 @@ timer_elapsed (int64_t then)
    be turned on. */
 void
 timer_sleep (int64_t ticks) 
+{
+  struct semaphore sema;
+
+  sema_init (&sema, 0);
+  timer_sema_down (&sema, ticks);
+}
+
+/* Downs SEMA, giving up once approximately TICKS timer ticks
+   have passed.  Returns true if SEMA was downed, false if the
+   time ran out first; in that case SEMA is left upped, so it
+   should be private to the caller.  Interrupts must be turned
+   on. */
+bool
+timer_sema_down (struct semaphore *sema, int64_t ticks)
 {
   enum intr_level old_level;
   struct sleeper sleeper;
@@ -114,15 +161,21 @@ timer_sleep (int64_t ticks)
   ASSERT (intr_get_level () == INTR_ON);
   
   sleeper.sleep_until = ticks + timer_ticks ();
-
-  sema_init (&sleeper.sema, 0);
+  sleeper.sema = sema;
+  sleeper.expired = false;
 
   old_level = intr_disable ();
   list_insert_ordered (&sleepers, &(sleeper.elem), 
                                   &thread_compare_sleep_ticks, 0);
   intr_set_level (old_level);
 
-  sema_down (&sleeper.sema);
+  sema_down (sema);
+
+  old_level = intr_disable ();
+  if (!sleeper.expired)
+    list_remove (&sleeper.elem);
+  intr_set_level (old_level);
+  return !sleeper.expired;
 }
 
 /* Compares two threads list elements according to sleep_until. */
@@ -199,6 +252,24 @@ timer_ndelay (int64_t ns)
   real_time_delay (ns, 1000 * 1000 * 1000);
 }
 
+/* Returns the number of CPU cycles counted by the time-stamp
+   counter since reset.  Meant for timing short intervals, since
+   the counter's rate is not calibrated against the timer. */
+uint64_t
+timer_cycles (void) 
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns the clock page.  See lib/vclock.h. */
+void *
+timer_clock_page (void)
+{
+  return vclock;
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) 
@@ -208,12 +279,19 @@ timer_print_stats (void)
 
 /* Timer interrupt handler. Wakes sleeping threads if needed. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED)
+timer_interrupt (struct intr_frame *args)
 {
   struct list_elem *e;
 
   ticks++;
 
+  vclock->seq++;
+  barrier ();
+  vclock->ticks = ticks;
+  vclock->tsc = timer_cycles ();
+  barrier ();
+  vclock->seq++;
+
   while (!list_empty (&sleepers))
   {
     e = list_begin (&sleepers);
@@ -221,7 +299,8 @@ timer_interrupt (struct intr_frame *args UNUSED)
     if (sleeper->sleep_until <= ticks)
       {
         list_pop_front (&sleepers);
-        sema_up (&sleeper->sema);
+        sleeper->expired = true;
+        sema_up (sleeper->sema);
       }
     else
       {
@@ -229,7 +308,18 @@ timer_interrupt (struct intr_frame *args UNUSED)
       }
   }
 
-  thread_tick ();
+  /* The low bits of CS are the privilege level that the tick
+     interrupted, 3 for user code. */
+  thread_tick ((args->cs & 3) == 3);
+}
+
+/* Waits for the next timer tick. */
+static void
+wait_for_tick (void)
+{
+  int64_t start = ticks;
+  while (ticks == start)
+    barrier ();
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -237,10 +327,9 @@ timer_interrupt (struct intr_frame *args UNUSED)
 static bool
 too_many_loops (unsigned loops) 
 {
-  /* Wait for a timer tick. */
-  int64_t start = ticks;
-  while (ticks == start)
-    barrier ();
+  int64_t start;
+
+  wait_for_tick ();
 
   /* Run LOOPS loops. */
   start = ticks;
@@ -17,6 +17,7 @@ int64_t timer_elapsed (int64_t);
 
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep (int64_t ticks);
+bool timer_sema_down (struct semaphore *, int64_t ticks);
 void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
@@ -26,6 +27,9 @@ void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
 void timer_ndelay (int64_t nanoseconds);
 
+uint64_t timer_cycles (void);
+void *timer_clock_page (void);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
@@ -36,6 +36,7 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    unsigned write_gen;                 /* Bumped by every write. */
     struct inode_disk data;             /* Inode content. */
   };
 
@@ -137,6 +138,7 @@ inode_open (block_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
+  inode->write_gen = 0;
   block_read (fs_device, inode->sector, &inode->data);
   return inode;
 }
@@ -157,6 +159,21 @@ inode_get_inumber (const struct inode *inode)
   return inode->sector;
 }
 
+/* Returns true if INODE has been removed, false otherwise. */
+bool
+inode_is_removed (const struct inode *inode)
+{
+  return inode->removed;
+}
+
+/* Returns INODE's write generation, which changes whenever data is
+   written to it.  Only meaningful while INODE stays open. */
+unsigned
+inode_write_gen (const struct inode *inode)
+{
+  return inode->write_gen;
+}
+
 /* Closes INODE and writes it to disk.
    If this was the last reference to INODE, frees its memory.
    If INODE was also a removed inode, frees its blocks. */
@@ -313,6 +330,8 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       bytes_written += chunk_size;
     }
   free (bounce);
+  if (bytes_written > 0)
+    inode->write_gen++;
 
   return bytes_written;
 }
@@ -0,0 +1,53 @@
+#ifndef __LIB_RING_H
+#define __LIB_RING_H
+
+#include <stdint.h>
+
+/* Submission and completion rings for asynchronous system calls.
+
+   ring_setup() maps one page holding a struct ring into the
+   process, shared with the kernel.  To queue a system call, the
+   process fills in sqes[sq_tail % RING_ENTRIES] and then
+   increments sq_tail.  ring_enter() hands everything queued to a
+   kernel worker thread, which runs the calls in order and, for
+   each, stores a completion at cqes[cq_tail % RING_ENTRIES] and
+   increments cq_tail.  The process consumes completions by
+   incrementing cq_head.  All four counters run freely and wrap
+   around; only the kernel writes sq_head and cq_tail.
+
+   The worker takes a submission only when the completion ring has
+   room for its result, so a process that lets completions pile
+   up must consume some and call ring_enter() again. */
+
+/* Number of entries in each ring.  Must be a power of 2. */
+#define RING_ENTRIES 64
+
+/* A queued system call: one of SYS_READ, SYS_WRITE, SYS_OPEN,
+   SYS_CLOSE, SYS_SEEK, SYS_PREAD, or SYS_PWRITE, with the
+   arguments the synchronous call would take. */
+struct ring_sqe
+  {
+    uint32_t nr;                /* System call number. */
+    uint32_t args[4];           /* Its arguments. */
+    uint32_t user_data;         /* Copied into the completion. */
+  };
+
+/* The result of a queued system call.  RES is what the call would
+   have returned, or -1 if it could not be run, for example
+   because an argument is a bad pointer. */
+struct ring_cqe
+  {
+    uint32_t user_data;         /* From the submission. */
+    int32_t res;                /* Return value. */
+  };
+
+/* The shared page. */
+struct ring
+  {
+    volatile uint32_t sq_head, sq_tail;
+    volatile uint32_t cq_head, cq_tail;
+    struct ring_sqe sqes[RING_ENTRIES];
+    struct ring_cqe cqes[RING_ENTRIES];
+  };
+
+#endif /* lib/ring.h */
@@ -0,0 +1,28 @@
+#ifndef __LIB_RUSAGE_H
+#define __LIB_RUSAGE_H
+
+/* Whose usage getrusage() reports. */
+#define RUSAGE_SELF 0           /* The calling process. */
+#define RUSAGE_CHILDREN 1       /* Its children that have exited. */
+
+/* Resource usage of a process, as reported by getrusage().  The
+   usage of children includes that of their own children. */
+struct rusage
+  {
+    long long ru_minflt;        /* Page faults serviced without I/O. */
+    long long ru_majflt;        /* Page faults that needed I/O. */
+    unsigned ru_rss;            /* Resident set size, in pages, or 0
+                                   for RUSAGE_CHILDREN. */
+    unsigned ru_held;           /* Pages of data held for the process
+                                   but not mapped by it, such as pipe
+                                   buffers, or 0 for RUSAGE_CHILDREN. */
+    long long ru_utime;         /* Time in user mode, in microseconds. */
+    long long ru_stime;         /* Time in the kernel, in microseconds. */
+    long long ru_nvcsw;         /* Voluntary context switches. */
+    long long ru_nivcsw;        /* Involuntary context switches. */
+    long long ru_inbytes;       /* Bytes read by system calls. */
+    long long ru_outbytes;      /* Bytes written by system calls. */
+    long long ru_nsyscalls;     /* System calls made. */
+  };
+
+#endif /* lib/rusage.h */
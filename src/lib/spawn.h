@@ -0,0 +1,48 @@
+#ifndef __LIB_SPAWN_H
+#define __LIB_SPAWN_H
+
+/* What an action does to the new process. */
+enum spawn_op
+  {
+    SPAWN_END,                  /* Ends the list of actions. */
+    SPAWN_DUP2,                 /* Make NEW_FD a copy of the caller's
+                                   descriptor FD. */
+    SPAWN_CLOSE,                /* Close FD. */
+    SPAWN_LIMIT                 /* Limit resource FD, one of enum
+                                   spawn_limit, to NEW_FD. */
+  };
+
+/* Limits that SPAWN_LIMIT sets.  A limit can only be lowered:
+   the new process gets the smaller of its parent's limit and the
+   one asked for. */
+enum spawn_limit
+  {
+    SPAWN_LIMIT_RSS,            /* Pages of user data, mapped or held
+                                   for the process (see ru_held). */
+    SPAWN_LIMIT_KMEM,           /* Kernel pages used for the process. */
+    SPAWN_LIMIT_FD              /* Descriptors, which must be less
+                                   than the limit.  Applies before
+                                   any of the actions, so SPAWN_DUP2
+                                   cannot go past it. */
+  };
+
+/* An action for spawn().  The new process starts with the
+   descriptors that exec() would give it and with the limits of
+   its parent, and then the actions are applied in order before
+   it runs. */
+struct spawn_action
+  {
+    int op;                     /* One of enum spawn_op. */
+    int fd;
+    int new_fd;
+  };
+
+/* Most actions one spawn() may take. */
+#define SPAWN_ACTIONS_MAX 32
+
+/* Flags for spawn(). */
+#define SPAWN_ASYNC 1           /* Return before the program is loaded.
+                                   If it fails to load, it exits
+                                   with status -1. */
+
+#endif /* lib/spawn.h */
@@ -28,7 +28,29 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_GETRUSAGE,              /* Report resource usage. */
+    SYS_READV,                  /* Read from a file into several buffers. */
+    SYS_WRITEV,                 /* Write several buffers to a file. */
+    SYS_PREAD,                  /* Read from a given position in a file. */
+    SYS_PWRITE,                 /* Write to a given position in a file. */
+    SYS_RING_SETUP,             /* Set up asynchronous system call rings. */
+    SYS_RING_ENTER,             /* Submit to and wait on the rings. */
+    SYS_PIPE,                   /* Create a pipe. */
+    SYS_DUP2,                   /* Duplicate a file descriptor. */
+    SYS_INHERIT,                /* Pass a file descriptor on to exec(). */
+    SYS_SBRK,                   /* Move the end of the heap. */
+    SYS_THREAD_SPAWN,           /* Start a thread in this process. */
+    SYS_THREAD_JOIN,            /* Wait for a thread to exit. */
+    SYS_THREAD_EXIT,            /* Terminate this thread. */
+    SYS_FUTEX_WAIT,             /* Sleep while an int holds a value. */
+    SYS_FUTEX_WAKE,             /* Wake threads sleeping on an int. */
+    SYS_WAITPID,                /* Wait for a child, or any child. */
+    SYS_SPAWN,                  /* Start a process with given arguments. */
+    SYS_SHM_OPEN,               /* Open a shared memory segment. */
+    SYS_SHM_MAP                 /* Map a shared memory segment. */
   };
 
 #endif /* lib/syscall-nr.h */
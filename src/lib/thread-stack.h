@@ -0,0 +1,34 @@
+#ifndef __LIB_THREAD_STACK_H
+#define __LIB_THREAD_STACK_H
+
+#include <stdint.h>
+
+/* Stacks of the threads of a user process.
+
+   The first thread's stack grows down from the top of user
+   memory, by at most 8 MB.  Threads started with thread_spawn()
+   get fixed stack slots below that: slot I covers the
+   THREAD_STACK_SIZE bytes below THREAD_STACKS_TOP - I *
+   THREAD_STACK_SIZE, and its lowest page is never mapped, so
+   that overflowing the stack faults. */
+#define THREAD_STACKS_TOP ((uint8_t *) 0xc0000000 - 0x800000)
+#define THREAD_STACK_SIZE (128 * 1024)
+#define THREAD_STACK_CNT 63
+
+/* Returns the stack slot that user stack address SP lies in, or
+   -1 if SP is not in a slot, as in the first thread.  A thread
+   can identify itself by passing the address of a local
+   variable. */
+static inline int
+thread_stack_slot (const void *sp)
+{
+  const uint8_t *p = sp;
+  const uint8_t *bottom = THREAD_STACKS_TOP
+                          - THREAD_STACK_CNT * THREAD_STACK_SIZE;
+
+  if (p < bottom || p >= THREAD_STACKS_TOP)
+    return -1;
+  return (THREAD_STACKS_TOP - 1 - p) / THREAD_STACK_SIZE;
+}
+
+#endif /* lib/thread-stack.h */
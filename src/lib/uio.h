@@ -0,0 +1,16 @@
+#ifndef __LIB_UIO_H
+#define __LIB_UIO_H
+
+#include <stddef.h>
+
+/* Most buffers that one readv() or writev() call accepts. */
+#define IOV_MAX 1024
+
+/* A buffer for readv() and writev(). */
+struct iovec
+  {
+    void *iov_base;             /* Start of the buffer. */
+    size_t iov_len;             /* Size of the buffer in bytes. */
+  };
+
+#endif /* lib/uio.h */
@@ -1,14 +1,14 @@
 #include <stdio.h>
-#include <string.h>
 #include <syscall.h>
 #include <syscall-nr.h>
 
 /* The standard vprintf() function,
-   which is like printf() but uses a va_list. */
+   which is like printf() but uses a va_list.
+   Output goes through the stdout stream. */
 int
 vprintf (const char *format, va_list args) 
 {
-  return vhprintf (STDOUT_FILENO, format, args);
+  return vfprintf (stdout, format, args);
 }
 
 /* Like printf(), but writes output to the given HANDLE. */
@@ -30,7 +30,7 @@ hprintf (int handle, const char *format, ...)
 int
 puts (const char *s) 
 {
-  write (STDOUT_FILENO, s, strlen (s));
+  fputs (s, stdout);
   putchar ('\n');
 
   return 0;
@@ -40,8 +40,7 @@ puts (const char *s)
 int
 putchar (int c) 
 {
-  char c2 = c;
-  write (STDOUT_FILENO, &c2, 1);
+  fputc (c, stdout);
   return c;
 }
 
@@ -59,11 +58,16 @@ static void flush (struct vhprintf_aux *);
 
 /* Formats the printf() format specification FORMAT with
    arguments given in ARGS and writes the output to the given
-   HANDLE. */
+   HANDLE.  Output to STDOUT goes through the stdout stream, to
+   stay in order with printf(). */
 int
 vhprintf (int handle, const char *format, va_list args) 
 {
   struct vhprintf_aux aux;
+
+  if (handle == STDOUT_FILENO)
+    return vfprintf (stdout, format, args);
+
   aux.p = aux.buf;
   aux.char_cnt = 0;
   aux.handle = handle;
@@ -0,0 +1,407 @@
+#include <stdlib.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <synch.h>
+#include <syscall.h>
+#include <thread-stack.h>
+
+/* Memory allocator for user programs.
+
+   Memory comes from the heap, which sbrk() grows, in page-aligned
+   runs of pages called "arenas", each starting with a struct
+   arena header.  As in the kernel's allocator (threads/malloc.c),
+   a request of up to MAX_SMALL bytes is rounded up to a power of
+   2, its "size class", and served from a one-page arena divided
+   into blocks of that size.  Bigger requests get an arena of
+   their own.  free() finds a block's arena by rounding its
+   address down to a page boundary.
+
+   Free small blocks go onto per-class lists in a cache.  A cache
+   holds at most CACHE_MAX free blocks of a class.  Beyond that,
+   half of them go back to a shared pool, which is also where a
+   cache refills from before it carves up a new arena.  Each
+   thread has a cache of its own, picked by the stack slot its
+   stack pointer lies in (see lib/thread-stack.h), so the common
+   case touches no shared state.  The pool, the free arenas and
+   the break are shared by all threads and protected by a lock.
+
+   Arenas for small blocks keep their class forever.  Free big
+   arenas are kept in address order and merged with their
+   neighbors, and a free arena at the end of the heap is given
+   back to the system. */
+
+/* Page size. */
+#define PAGE_SIZE 4096
+
+/* Size classes are 16, 32, ..., MAX_SMALL bytes. */
+#define MIN_SHIFT 4
+#define CLASS_CNT 8
+#define MAX_SMALL (1u << (MIN_SHIFT + CLASS_CNT - 1))
+
+/* Most free blocks of a class a cache holds. */
+#define CACHE_MAX 64
+
+/* Magic number for detecting arena corruption. */
+#define ARENA_MAGIC 0x9a548eed
+
+/* Arena. */
+struct arena
+  {
+    unsigned magic;             /* Always set to ARENA_MAGIC. */
+    int class;                  /* Size class, or -1 for a big block. */
+    size_t page_cnt;            /* Number of pages. */
+    struct arena *next;         /* Next free arena, in address order. */
+  };
+
+/* Space taken by an arena header, keeping blocks 16-byte aligned. */
+#define ARENA_HDR ROUND_UP (sizeof (struct arena), 16)
+
+/* Free block. */
+struct block
+  {
+    struct block *next;         /* Next free block of its class. */
+  };
+
+/* Free blocks, by size class. */
+struct cache
+  {
+    struct block *free[CLASS_CNT];      /* Lists of free blocks. */
+    size_t free_cnt[CLASS_CNT];         /* Lengths of the lists. */
+  };
+
+static struct cache caches[THREAD_STACK_CNT + 1]; /* Per thread. */
+static struct cache pool;               /* Shared pool. */
+static struct arena *free_arenas;       /* Free big arenas. */
+
+/* Protects POOL, FREE_ARENAS and the break. */
+static struct mutex heap_lock = MUTEX_INITIALIZER;
+
+static struct cache *thread_cache (void);
+static int size_to_class (size_t);
+static bool refill (struct cache *, int class);
+static void move_blocks (struct cache *to, struct cache *from, int class,
+                         size_t cnt);
+static struct arena *get_arena (size_t page_cnt);
+static void put_arena (struct arena *);
+static struct arena *block_to_arena (void *);
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size)
+{
+  struct arena *a;
+  size_t page_cnt;
+
+  if (size == 0)
+    return NULL;
+
+  if (size <= MAX_SMALL)
+    {
+      struct cache *c = thread_cache ();
+      int class = size_to_class (size);
+      struct block *b;
+
+      if (c->free[class] == NULL)
+        {
+          bool ok;
+
+          mutex_lock (&heap_lock);
+          ok = refill (c, class);
+          mutex_unlock (&heap_lock);
+          if (!ok)
+            return NULL;
+        }
+      b = c->free[class];
+      c->free[class] = b->next;
+      c->free_cnt[class]--;
+      return b;
+    }
+
+  /* Big block: an arena of its own. */
+  if (size > SIZE_MAX - ARENA_HDR - PAGE_SIZE)
+    return NULL;
+  page_cnt = DIV_ROUND_UP (size + ARENA_HDR, PAGE_SIZE);
+  mutex_lock (&heap_lock);
+  a = get_arena (page_cnt);
+  mutex_unlock (&heap_lock);
+  if (a == NULL)
+    return NULL;
+  a->class = -1;
+  return (uint8_t *) a + ARENA_HDR;
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b)
+{
+  void *p;
+  size_t size;
+
+  size = a * b;
+  if (size < a || size < b)
+    return NULL;
+
+  p = malloc (size);
+  if (p != NULL)
+    memset (p, 0, size);
+  return p;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.
+   If successful, returns the new block; on failure, returns a
+   null pointer.
+   A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size)
+{
+  struct arena *a;
+  size_t old_size;
+  void *new_block;
+
+  if (new_size == 0)
+    {
+      free (old_block);
+      return NULL;
+    }
+  if (old_block == NULL)
+    return malloc (new_size);
+
+  a = block_to_arena (old_block);
+  old_size = (a->class >= 0
+              ? (size_t) 1 << (MIN_SHIFT + a->class)
+              : a->page_cnt * PAGE_SIZE - ARENA_HDR);
+  if (new_size <= old_size)
+    return old_block;
+
+  new_block = malloc (new_size);
+  if (new_block != NULL)
+    {
+      memcpy (new_block, old_block,
+              old_size < new_size ? old_size : new_size);
+      free (old_block);
+    }
+  return new_block;
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p)
+{
+  struct arena *a;
+
+  if (p == NULL)
+    return;
+
+  a = block_to_arena (p);
+  if (a->class >= 0)
+    {
+      struct cache *c = thread_cache ();
+      struct block *b = p;
+
+#ifndef NDEBUG
+      /* Clear the block to help detect use-after-free bugs. */
+      memset (b, 0xcc, (size_t) 1 << (MIN_SHIFT + a->class));
+#endif
+
+      b->next = c->free[a->class];
+      c->free[a->class] = b;
+      if (++c->free_cnt[a->class] > CACHE_MAX)
+        {
+          mutex_lock (&heap_lock);
+          move_blocks (&pool, c, a->class, CACHE_MAX / 2);
+          mutex_unlock (&heap_lock);
+        }
+    }
+  else
+    {
+      mutex_lock (&heap_lock);
+      put_arena (a);
+      mutex_unlock (&heap_lock);
+    }
+}
+
+/* Returns the running thread's cache. */
+static struct cache *
+thread_cache (void)
+{
+  int here;
+  return &caches[thread_stack_slot (&here) + 1];
+}
+
+/* Returns the size class for a request of SIZE bytes, which must
+   be between 1 and MAX_SMALL. */
+static int
+size_to_class (size_t size)
+{
+  int class = 0;
+
+  ASSERT (size > 0 && size <= MAX_SMALL);
+  while (((size_t) 1 << (MIN_SHIFT + class)) < size)
+    class++;
+  return class;
+}
+
+/* Adds free blocks of size class CLASS to C, taking them from
+   the shared pool if it has any or from a new arena otherwise.
+   Returns false if memory is not available.  HEAP_LOCK must be
+   held. */
+static bool
+refill (struct cache *c, int class)
+{
+  size_t block_size = (size_t) 1 << (MIN_SHIFT + class);
+  struct arena *a;
+  uint8_t *p;
+
+  if (pool.free[class] != NULL)
+    {
+      move_blocks (c, &pool, class, CACHE_MAX / 2);
+      return true;
+    }
+
+  a = get_arena (1);
+  if (a == NULL)
+    return false;
+  a->class = class;
+  for (p = (uint8_t *) a + ROUND_UP (ARENA_HDR, block_size);
+       p + block_size <= (uint8_t *) a + PAGE_SIZE; p += block_size)
+    {
+      struct block *b = (struct block *) p;
+      b->next = c->free[class];
+      c->free[class] = b;
+      c->free_cnt[class]++;
+    }
+  return true;
+}
+
+/* Moves up to CNT free blocks of size class CLASS from FROM to
+   TO. */
+static void
+move_blocks (struct cache *to, struct cache *from, int class, size_t cnt)
+{
+  for (; cnt > 0 && from->free[class] != NULL; cnt--)
+    {
+      struct block *b = from->free[class];
+      from->free[class] = b->next;
+      from->free_cnt[class]--;
+      b->next = to->free[class];
+      to->free[class] = b;
+      to->free_cnt[class]++;
+    }
+}
+
+/* Returns an arena of PAGE_CNT pages, taken from the first free
+   arena that is big enough or else from new heap space.  Returns
+   a null pointer if the heap cannot grow. */
+static struct arena *
+get_arena (size_t page_cnt)
+{
+  struct arena **ap, *a;
+  uint8_t *brk;
+  size_t pad;
+
+  for (ap = &free_arenas; (a = *ap) != NULL; ap = &a->next)
+    if (a->page_cnt >= page_cnt)
+      {
+        /* Use the front, leaving the rest free. */
+        if (a->page_cnt > page_cnt)
+          {
+            struct arena *rest;
+
+            rest = (struct arena *) ((uint8_t *) a + page_cnt * PAGE_SIZE);
+            rest->magic = ARENA_MAGIC;
+            rest->page_cnt = a->page_cnt - page_cnt;
+            rest->next = a->next;
+            *ap = rest;
+          }
+        else
+          *ap = a->next;
+        a->page_cnt = page_cnt;
+        return a;
+      }
+
+  /* Grow the heap, page-aligning the break first in case the
+     program moved it itself. */
+  brk = sbrk (0);
+  if (brk == (void *) -1)
+    return NULL;
+  pad = ROUND_UP ((uintptr_t) brk, PAGE_SIZE) - (uintptr_t) brk;
+  if (page_cnt > (SIZE_MAX - pad) / PAGE_SIZE
+      || sbrk (pad + page_cnt * PAGE_SIZE) == (void *) -1)
+    return NULL;
+
+  a = (struct arena *) (brk + pad);
+  a->magic = ARENA_MAGIC;
+  a->page_cnt = page_cnt;
+  return a;
+}
+
+/* Frees arena A, merging it with free arenas next to it, and
+   gives it back to the system if it ends the heap. */
+static void
+put_arena (struct arena *a)
+{
+  struct arena **ap;
+  struct arena *prev = NULL;
+
+  for (ap = &free_arenas; *ap != NULL && *ap < a; ap = &(*ap)->next)
+    prev = *ap;
+  a->next = *ap;
+  *ap = a;
+
+  /* Merge with the following arena, then with the preceding one. */
+  if (a->next != NULL
+      && (uint8_t *) a + a->page_cnt * PAGE_SIZE == (uint8_t *) a->next)
+    {
+      a->page_cnt += a->next->page_cnt;
+      a->next = a->next->next;
+    }
+  if (prev != NULL
+      && (uint8_t *) prev + prev->page_cnt * PAGE_SIZE == (uint8_t *) a)
+    {
+      prev->page_cnt += a->page_cnt;
+      prev->next = a->next;
+      a = prev;
+    }
+
+  /* Give back an arena at the end of the heap. */
+  if (a->next == NULL
+      && (uint8_t *) a + a->page_cnt * PAGE_SIZE == (uint8_t *) sbrk (0))
+    {
+      struct arena **pp;
+
+      for (pp = &free_arenas; *pp != a; pp = &(*pp)->next)
+        continue;
+      *pp = NULL;
+      sbrk (-(intptr_t) (a->page_cnt * PAGE_SIZE));
+    }
+}
+
+/* Returns the arena that block P belongs to. */
+static struct arena *
+block_to_arena (void *p)
+{
+  struct arena *a = (struct arena *) ((uintptr_t) p & ~(PAGE_SIZE - 1));
+
+  /* Check that the arena is valid and that P is a block in it. */
+  ASSERT (a->magic == ARENA_MAGIC);
+  if (a->class < 0)
+    {
+      ASSERT ((uint8_t *) p == (uint8_t *) a + ARENA_HDR);
+    }
+  else
+    {
+      size_t block_size = (size_t) 1 << (MIN_SHIFT + a->class);
+      size_t ofs = (uint8_t *) p - (uint8_t *) a;
+      ASSERT (ofs >= ROUND_UP (ARENA_HDR, block_size));
+      ASSERT (ofs % block_size == 0);
+    }
+
+  return a;
+}
@@ -0,0 +1,456 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <synch.h>
+#include <syscall.h>
+
+/* Buffered streams.
+
+   A stream collects output in its buffer and writes it to its
+   file descriptor in one system call when the buffer fills, at a
+   new-line if the stream is line buffered, or when flushed.  A
+   stream that is read from fills its buffer with one system call
+   and hands the data out piece by piece.  Switching a stream
+   between reading and writing flushes it, which moves the file
+   position back over any input read ahead but not yet consumed.
+
+   All open streams are flushed when the process exits through
+   exit().  Each stream has a mutex, so threads may share one; a
+   single call's output, even a whole printf(), is never mixed with
+   another thread's. */
+
+/* A stream. */
+struct FILE
+  {
+    int fd;                     /* File descriptor. */
+    int mode;                   /* _IOFBF, _IOLBF, or _IONBF. */
+    char *buf;                  /* Buffer, null if unbuffered. */
+    size_t size;                /* Size of BUF. */
+    size_t pos;                 /* Bytes of BUF written or consumed. */
+    size_t len;                 /* Bytes of BUF read, when reading. */
+    bool reading;               /* BUF holds input, not output? */
+    bool eof;                   /* Reached end of file? */
+    bool error;                 /* Had an error? */
+    bool own_buf;               /* BUF allocated with malloc()? */
+    FILE *next;                 /* Next open stream. */
+    struct mutex lock;          /* Protects the members above. */
+  };
+
+/* Standard output and error.  Both go to the console, so writing
+   to stderr first flushes stdout, to keep the two in order. */
+static char stdout_buf[BUFSIZ];
+static FILE stdout_file =
+  {STDOUT_FILENO, _IOLBF, stdout_buf, BUFSIZ, 0, 0,
+   false, false, false, false, NULL, MUTEX_INITIALIZER};
+static FILE stderr_file =
+  {STDOUT_FILENO, _IONBF, NULL, 0, 0, 0,
+   false, false, false, false, &stdout_file, MUTEX_INITIALIZER};
+FILE *stdout = &stdout_file;
+FILE *stderr = &stderr_file;
+
+/* All open streams, and a lock for the list.  A thread that
+   holds both takes this one first. */
+static FILE *streams = &stderr_file;
+static struct mutex streams_lock = MUTEX_INITIALIZER;
+
+static int flush (FILE *);
+static size_t write_stream (FILE *, const char *, size_t);
+static bool write_all (FILE *, const char *, size_t);
+
+/* Opens a stream on file descriptor FD, which is closed when the
+   stream is.  The stream is fully buffered.  MODE is accepted for
+   compatibility but ignored, because a stream may be both read
+   and written.  Returns a null pointer if memory is short. */
+FILE *
+fdopen (int fd, const char *mode UNUSED)
+{
+  FILE *f = malloc (sizeof *f);
+  if (f == NULL)
+    return NULL;
+
+  f->buf = malloc (BUFSIZ);
+  if (f->buf == NULL)
+    {
+      free (f);
+      return NULL;
+    }
+  f->fd = fd;
+  f->mode = _IOFBF;
+  f->size = BUFSIZ;
+  f->pos = f->len = 0;
+  f->reading = f->eof = f->error = false;
+  f->own_buf = true;
+  mutex_init (&f->lock);
+  mutex_lock (&streams_lock);
+  f->next = streams;
+  streams = f;
+  mutex_unlock (&streams_lock);
+  return f;
+}
+
+/* Flushes and closes stream F and its file descriptor.  Returns
+   0 if successful, EOF if the flush failed. */
+int
+fclose (FILE *f)
+{
+  int retval = fflush (f);
+  FILE **fp;
+
+  mutex_lock (&streams_lock);
+  for (fp = &streams; *fp != f; fp = &(*fp)->next)
+    continue;
+  *fp = f->next;
+  mutex_unlock (&streams_lock);
+
+  close (f->fd);
+  if (f->own_buf)
+    free (f->buf);
+  if (f != stdout && f != stderr)
+    free (f);
+  return retval;
+}
+
+/* Writes out any output buffered in stream F, or discards any
+   input read ahead, or does so for every open stream if F is a
+   null pointer.  In the latter case, a stream that another thread
+   is using is skipped rather than waited for, so that exit() does
+   not hang on a stream held by a thread blocked in a read or
+   write.  Returns 0 if successful, EOF on error. */
+int
+fflush (FILE *f)
+{
+  int retval = 0;
+
+  if (f == NULL)
+    {
+      mutex_lock (&streams_lock);
+      for (f = streams; f != NULL; f = f->next)
+        if (mutex_trylock (&f->lock))
+          {
+            if (flush (f) == EOF)
+              retval = EOF;
+            mutex_unlock (&f->lock);
+          }
+      mutex_unlock (&streams_lock);
+      return retval;
+    }
+
+  mutex_lock (&f->lock);
+  retval = flush (f);
+  mutex_unlock (&f->lock);
+  return retval;
+}
+
+/* Does the work of fflush() for stream F, whose lock must be
+   held. */
+static int
+flush (FILE *f)
+{
+  int retval = 0;
+
+  if (f->reading)
+    {
+      if (f->len > f->pos)
+        seek (f->fd, tell (f->fd) - (f->len - f->pos));
+      f->reading = false;
+    }
+  else if (f->pos > 0 && !write_all (f, f->buf, f->pos))
+    retval = EOF;
+  f->pos = f->len = 0;
+  return retval;
+}
+
+/* Sets the buffering of stream F to MODE, using the SIZE bytes in
+   BUF as its buffer, or a buffer allocated to that size if BUF is
+   null.  Returns 0 if successful, or EOF if MODE is invalid or
+   memory is short. */
+int
+setvbuf (FILE *f, char *buf, int mode, size_t size)
+{
+  bool own_buf = false;
+
+  if (mode != _IOFBF && mode != _IOLBF && mode != _IONBF)
+    return EOF;
+
+  if (mode == _IONBF)
+    {
+      buf = NULL;
+      size = 0;
+    }
+  else if (buf == NULL)
+    {
+      if (size == 0)
+        size = BUFSIZ;
+      buf = malloc (size);
+      if (buf == NULL)
+        return EOF;
+      own_buf = true;
+    }
+
+  mutex_lock (&f->lock);
+  flush (f);
+  if (f->own_buf)
+    free (f->buf);
+  f->buf = buf;
+  f->size = size;
+  f->mode = mode;
+  f->own_buf = own_buf;
+  mutex_unlock (&f->lock);
+  return 0;
+}
+
+/* Reads up to CNT elements of SIZE bytes each from stream F into
+   BUFFER.  Returns the number of whole elements read, which is
+   less than CNT only at end of file or on error. */
+size_t
+fread (void *buffer_, size_t size, size_t cnt, FILE *f)
+{
+  char *buffer = buffer_;
+  size_t total, done;
+
+  if (size == 0 || cnt == 0)
+    return 0;
+  total = size * cnt;
+  if (total / size != cnt)
+    return 0;
+
+  mutex_lock (&f->lock);
+  if (!f->reading)
+    {
+      flush (f);
+      f->reading = true;
+    }
+
+  for (done = 0; done < total; )
+    {
+      bool direct;
+      int n;
+
+      if (f->pos < f->len)
+        {
+          size_t chunk = f->len - f->pos;
+          if (chunk > total - done)
+            chunk = total - done;
+          memcpy (buffer + done, f->buf + f->pos, chunk);
+          f->pos += chunk;
+          done += chunk;
+          continue;
+        }
+
+      /* Read big requests straight into BUFFER, and others
+         through our buffer. */
+      direct = total - done >= f->size;
+      if (direct)
+        n = read (f->fd, buffer + done, total - done);
+      else
+        {
+          n = read (f->fd, f->buf, f->size);
+          f->pos = 0;
+          f->len = n > 0 ? n : 0;
+        }
+      if (n <= 0)
+        {
+          if (n == 0)
+            f->eof = true;
+          else
+            f->error = true;
+          break;
+        }
+      if (direct)
+        done += n;
+    }
+  mutex_unlock (&f->lock);
+  return done / size;
+}
+
+/* Writes CNT elements of SIZE bytes each from BUFFER to stream
+   F.  Returns the number of elements written, which is less than
+   CNT only on error. */
+size_t
+fwrite (const void *buffer, size_t size, size_t cnt, FILE *f)
+{
+  size_t total, written;
+
+  if (size == 0 || cnt == 0)
+    return 0;
+  total = size * cnt;
+  if (total / size != cnt)
+    return 0;
+
+  mutex_lock (&f->lock);
+  written = write_stream (f, buffer, total);
+  mutex_unlock (&f->lock);
+  return written == total ? cnt : 0;
+}
+
+/* Does the work of fwrite() for the SIZE bytes in BUFFER, for
+   stream F, whose lock must be held.  Returns SIZE if successful,
+   0 on error. */
+static size_t
+write_stream (FILE *f, const char *buffer, size_t size)
+{
+  size_t done;
+
+  if (f->reading)
+    flush (f);
+  if (f == stderr)
+    fflush (stdout);
+
+  /* Write big requests and unbuffered output directly. */
+  if (size >= f->size)
+    {
+      if (flush (f) == EOF || !write_all (f, buffer, size))
+        return 0;
+      return size;
+    }
+
+  for (done = 0; done < size; )
+    {
+      size_t chunk = f->size - f->pos;
+      if (chunk > size - done)
+        chunk = size - done;
+      memcpy (f->buf + f->pos, buffer + done, chunk);
+      f->pos += chunk;
+      done += chunk;
+      if (f->pos == f->size && flush (f) == EOF)
+        return 0;
+    }
+  if (f->mode == _IOLBF && memchr (buffer, '\n', size) != NULL
+      && flush (f) == EOF)
+    return 0;
+  return size;
+}
+
+/* Reads and returns a byte from stream F, or EOF at end of file
+   or on error. */
+int
+fgetc (FILE *f)
+{
+  unsigned char c;
+  return fread (&c, 1, 1, f) == 1 ? c : EOF;
+}
+
+/* Writes C to stream F.  Returns C, or EOF on error. */
+int
+fputc (int c, FILE *f)
+{
+  unsigned char c2 = c;
+  return fwrite (&c2, 1, 1, f) == 1 ? c2 : EOF;
+}
+
+/* Writes string S to stream F.  Returns 0 if successful, EOF on
+   error. */
+int
+fputs (const char *s, FILE *f)
+{
+  size_t len = strlen (s);
+  return len == 0 || fwrite (s, len, 1, f) == 1 ? 0 : EOF;
+}
+
+/* Like printf(), but writes output to stream F. */
+int
+fprintf (FILE *f, const char *format, ...)
+{
+  va_list args;
+  int retval;
+
+  va_start (args, format);
+  retval = vfprintf (f, format, args);
+  va_end (args);
+
+  return retval;
+}
+
+/* Auxiliary data for vfprintf_helper(). */
+struct vfprintf_aux
+  {
+    char buf[64];       /* Character buffer. */
+    char *p;            /* Current position in buffer. */
+    int char_cnt;       /* Total characters written so far. */
+    FILE *f;            /* Output stream. */
+  };
+
+static void add_char (char, void *);
+static void flush_aux (struct vfprintf_aux *);
+
+/* Like vprintf(), but writes output to stream F.  Output is
+   gathered into pieces before it reaches F, so that even an
+   unbuffered stream gets few system calls.  F stays locked
+   throughout, so that other threads' output does not land in
+   the middle. */
+int
+vfprintf (FILE *f, const char *format, va_list args)
+{
+  struct vfprintf_aux aux;
+  aux.p = aux.buf;
+  aux.char_cnt = 0;
+  aux.f = f;
+  mutex_lock (&f->lock);
+  __vprintf (format, args, add_char, &aux);
+  flush_aux (&aux);
+  mutex_unlock (&f->lock);
+  return aux.char_cnt;
+}
+
+/* Adds C to the buffer in AUX, flushing it if the buffer fills
+   up. */
+static void
+add_char (char c, void *aux_)
+{
+  struct vfprintf_aux *aux = aux_;
+  *aux->p++ = c;
+  if (aux->p >= aux->buf + sizeof aux->buf)
+    flush_aux (aux);
+  aux->char_cnt++;
+}
+
+/* Passes the buffer in AUX on to its stream, which vfprintf()
+   holds locked. */
+static void
+flush_aux (struct vfprintf_aux *aux)
+{
+  if (aux->p > aux->buf)
+    write_stream (aux->f, aux->buf, aux->p - aux->buf);
+  aux->p = aux->buf;
+}
+
+/* Returns nonzero if stream F has reached end of file. */
+int
+feof (FILE *f)
+{
+  return f->eof;
+}
+
+/* Returns nonzero if stream F has had an error. */
+int
+ferror (FILE *f)
+{
+  return f->error;
+}
+
+/* Returns the file descriptor that stream F uses. */
+int
+fileno (FILE *f)
+{
+  return f->fd;
+}
+
+/* Writes the SIZE bytes in BUFFER to F's file descriptor,
+   continuing after short writes.  Returns false, and marks F as
+   having had an error, if a write fails. */
+static bool
+write_all (FILE *f, const char *buffer, size_t size)
+{
+  while (size > 0)
+    {
+      int n = write (f->fd, buffer, size);
+      if (n <= 0)
+        {
+          f->error = true;
+          return false;
+        }
+      buffer += n;
+      size -= n;
+    }
+  return true;
+}
@@ -4,4 +4,36 @@
 int hprintf (int, const char *, ...) PRINTF_FORMAT (2, 3);
 int vhprintf (int, const char *, va_list) PRINTF_FORMAT (2, 0);
 
+/* Buffered streams, in lib/user/stdio.c. */
+typedef struct FILE FILE;
+
+extern FILE *stdout;            /* Line buffered. */
+extern FILE *stderr;            /* Unbuffered, also to the console. */
+
+/* Value returned at end of file or on error. */
+#define EOF (-1)
+
+/* Default buffer size. */
+#define BUFSIZ 1024
+
+/* Buffering modes for setvbuf(). */
+#define _IOFBF 0                /* Fully buffered. */
+#define _IOLBF 1                /* Line buffered. */
+#define _IONBF 2                /* Unbuffered. */
+
+FILE *fdopen (int fd, const char *mode);
+int fclose (FILE *);
+int fflush (FILE *);
+int setvbuf (FILE *, char *buf, int mode, size_t size);
+size_t fread (void *, size_t size, size_t cnt, FILE *);
+size_t fwrite (const void *, size_t size, size_t cnt, FILE *);
+int fgetc (FILE *);
+int fputc (int, FILE *);
+int fputs (const char *, FILE *);
+int fprintf (FILE *, const char *, ...) PRINTF_FORMAT (2, 3);
+int vfprintf (FILE *, const char *, va_list) PRINTF_FORMAT (2, 0);
+int feof (FILE *);
+int ferror (FILE *);
+int fileno (FILE *);
+
 #endif /* lib/user/stdio.h */
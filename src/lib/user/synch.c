@@ -0,0 +1,105 @@
+#include <synch.h>
+#include <limits.h>
+#include <syscall.h>
+
+/* Mutexes and condition variables for threads of one process.
+
+   Both are built on futexes.  A mutex is taken and released with
+   atomic instructions alone as long as no other thread wants it
+   at the same time; only a thread that has to wait, and the
+   thread that releases a mutex someone is waiting for, enter the
+   kernel.  Likewise, signaling a condition variable makes a
+   system call only if some thread is waiting on it.
+
+   Pintos runs on one CPU, where the holder of a mutex cannot
+   make progress while another thread spins on it, so a contended
+   mutex goes to sleep at once instead of spinning first. */
+
+/* Initializes M as free. */
+void
+mutex_init (struct mutex *m)
+{
+  m->state = 0;
+}
+
+/* Acquires M, sleeping until it is free if necessary.  M must not
+   already be held by the current thread. */
+void
+mutex_lock (struct mutex *m)
+{
+  if (__sync_val_compare_and_swap (&m->state, 0, 1) == 0)
+    return;
+
+  /* Announce that we are waiting, so that mutex_unlock() wakes us,
+     and sleep until the mutex turns out to be free. */
+  while (__sync_lock_test_and_set (&m->state, 2) != 0)
+    futex_wait (&m->state, 2, -1);
+}
+
+/* Tries to acquire M without sleeping.  Returns true if
+   successful, false if M is held. */
+bool
+mutex_trylock (struct mutex *m)
+{
+  return __sync_val_compare_and_swap (&m->state, 0, 1) == 0;
+}
+
+/* Releases M, which must be held by the current thread, and wakes
+   up a thread waiting for it, if any. */
+void
+mutex_unlock (struct mutex *m)
+{
+  if (__sync_fetch_and_sub (&m->state, 1) != 1)
+    {
+      m->state = 0;
+      futex_wake (&m->state, 1);
+    }
+}
+
+/* Initializes condition variable C. */
+void
+cond_init (struct condvar *c)
+{
+  c->seq = 0;
+  c->waiters = 0;
+}
+
+/* Atomically releases M and waits for C to be signaled, then
+   reacquires M before returning.  M must be held by the current
+   thread.  As with any condition variable, the caller must
+   recheck its condition afterward, since wakeups may be
+   spurious. */
+void
+cond_wait (struct condvar *c, struct mutex *m)
+{
+  int seq;
+
+  __sync_fetch_and_add (&c->waiters, 1);
+  seq = c->seq;
+  mutex_unlock (m);
+  futex_wait (&c->seq, seq, -1);
+  __sync_fetch_and_sub (&c->waiters, 1);
+
+  /* Other threads may have been woken with us, so take M as if
+     it were contended. */
+  while (__sync_lock_test_and_set (&m->state, 2) != 0)
+    futex_wait (&m->state, 2, -1);
+}
+
+/* Wakes up one thread waiting on C, if any. */
+void
+cond_signal (struct condvar *c)
+{
+  __sync_fetch_and_add (&c->seq, 1);
+  if (c->waiters > 0)
+    futex_wake (&c->seq, 1);
+}
+
+/* Wakes up all threads waiting on C. */
+void
+cond_broadcast (struct condvar *c)
+{
+  __sync_fetch_and_add (&c->seq, 1);
+  if (c->waiters > 0)
+    futex_wake (&c->seq, INT_MAX);
+}
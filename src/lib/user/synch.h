@@ -0,0 +1,36 @@
+#ifndef __LIB_USER_SYNCH_H
+#define __LIB_USER_SYNCH_H
+
+#include <stdbool.h>
+
+/* Mutex. */
+struct mutex
+  {
+    int state;          /* 0 if free, 1 if held, 2 if also waited on. */
+  };
+
+/* Initializer for a free mutex with static storage duration. */
+#define MUTEX_INITIALIZER { 0 }
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+bool mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+/* Condition variable. */
+struct condvar
+  {
+    int seq;            /* Bumped by every signal and broadcast. */
+    int waiters;        /* Number of threads in cond_wait(). */
+  };
+
+/* Initializer for a condition variable with static storage
+   duration. */
+#define CONDVAR_INITIALIZER { 0, 0 }
+
+void cond_init (struct condvar *);
+void cond_wait (struct condvar *, struct mutex *);
+void cond_signal (struct condvar *);
+void cond_broadcast (struct condvar *);
+
+#endif /* lib/user/synch.h */
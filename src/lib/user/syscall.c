@@ -1,9 +1,14 @@
 #include <syscall.h>
+#include <stdint.h>
+#include <stdio.h>
 #include "../syscall-nr.h"
 
-/* Invokes syscall NUMBER, passing no arguments, and returns the
-   return value as an `int'. */
-#define syscall0(NUMBER)                                        \
+/* System calls with `int $0x30' pass the system call number and
+   arguments on the user stack.  See userprog/syscall.c. */
+
+/* Invokes syscall NUMBER with `int $0x30', passing no
+   arguments, and returns the return value as an `int'. */
+#define int_syscall0(NUMBER)                                    \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
@@ -14,9 +19,9 @@
           retval;                                               \
         })
 
-/* Invokes syscall NUMBER, passing argument ARG0, and returns the
-   return value as an `int'. */
-#define syscall1(NUMBER, ARG0)                                           \
+/* Invokes syscall NUMBER with `int $0x30', passing argument
+   ARG0, and returns the return value as an `int'. */
+#define int_syscall1(NUMBER, ARG0)                                       \
         ({                                                               \
           int retval;                                                    \
           asm volatile                                                   \
@@ -28,9 +33,9 @@
           retval;                                                        \
         })
 
-/* Invokes syscall NUMBER, passing arguments ARG0 and ARG1, and
-   returns the return value as an `int'. */
-#define syscall2(NUMBER, ARG0, ARG1)                            \
+/* Invokes syscall NUMBER with `int $0x30', passing arguments
+   ARG0 and ARG1, and returns the return value as an `int'. */
+#define int_syscall2(NUMBER, ARG0, ARG1)                        \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
@@ -44,9 +49,10 @@
           retval;                                               \
         })
 
-/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, and
-   ARG2, and returns the return value as an `int'. */
-#define syscall3(NUMBER, ARG0, ARG1, ARG2)                      \
+/* Invokes syscall NUMBER with `int $0x30', passing arguments
+   ARG0, ARG1, and ARG2, and returns the return value as an
+   `int'. */
+#define int_syscall3(NUMBER, ARG0, ARG1, ARG2)                  \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
@@ -61,9 +67,113 @@
           retval;                                               \
         })
 
+/* Invokes syscall NUMBER with `int $0x30', passing arguments
+   ARG0, ARG1, ARG2, and ARG3, and returns the return value as an
+   `int'. */
+#define int_syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)            \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; pushl %[number]; int $0x30; "      \
+             "addl $20, %%esp"                                  \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "g" (ARG0),                             \
+                 [arg1] "g" (ARG1),                             \
+                 [arg2] "g" (ARG2),                             \
+                 [arg3] "g" (ARG3)                              \
+               : "memory");                                     \
+          retval;                                               \
+        })
+
+/* Invokes syscall NUMBER with SYSENTER, passing arguments ARG0,
+   ARG1, and ARG2 in registers, and returns the return value as an
+   `int'.  The kernel returns with SYSEXIT to the address in %edx
+   with the stack pointer in %ecx; see userprog/sysenter.S. */
+#define sysenter_syscall(NUMBER, ARG0, ARG1, ARG2)              \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("movl %%esp, %%ecx; movl $1f, %%edx; sysenter; 1:" \
+               : "=a" (retval)                                  \
+               : "0" (NUMBER),                                  \
+                 "b" (ARG0),                                    \
+                 "S" (ARG1),                                    \
+                 "D" (ARG2)                                     \
+               : "ecx", "edx", "memory");                       \
+          retval;                                               \
+        })
+
+/* Like sysenter_syscall(), but also passes ARG3 in %ebp, which
+   we must save ourselves because it may be the frame pointer. */
+#define sysenter_syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)       \
+        ({                                                      \
+          int retval;                                           \
+          int arg3 = (int) (ARG3);                              \
+          asm volatile                                          \
+            ("pushl %%ebp; movl %%ecx, %%ebp; "                 \
+             "movl %%esp, %%ecx; movl $1f, %%edx; "             \
+             "sysenter; 1: popl %%ebp"                          \
+               : "=a" (retval), "+c" (arg3)                     \
+               : "0" (NUMBER),                                  \
+                 "b" (ARG0),                                    \
+                 "S" (ARG1),                                    \
+                 "D" (ARG2)                                     \
+               : "edx", "memory");                              \
+          retval;                                               \
+        })
+
+/* CPUID leaf 1 feature flag in EDX for SYSENTER and SYSEXIT. */
+#define CPUID_SEP 0x00000800
+
+/* 1 if the CPU supports SYSENTER, 0 if not, -1 if not yet known. */
+static int have_sysenter = -1;
+
+/* Returns true if system calls should use SYSENTER.  The kernel
+   enables it whenever the CPU supports it, so asking the CPU is
+   enough; otherwise we fall back to `int $0x30'. */
+static bool
+use_sysenter (void)
+{
+  if (have_sysenter < 0)
+    {
+      uint32_t eax = 1, ebx, ecx, edx;
+      asm volatile ("cpuid"
+                    : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+      have_sysenter = (edx & CPUID_SEP) != 0;
+    }
+  return have_sysenter;
+}
+
+/* Invoke syscall NUMBER with 0 to 4 arguments, by whichever
+   means the CPU supports, and return the return value as an
+   `int'. */
+#define syscall0(NUMBER)                                        \
+        (use_sysenter ()                                        \
+         ? sysenter_syscall (NUMBER, 0, 0, 0)                   \
+         : int_syscall0 (NUMBER))
+#define syscall1(NUMBER, ARG0)                                  \
+        (use_sysenter ()                                        \
+         ? sysenter_syscall (NUMBER, ARG0, 0, 0)                \
+         : int_syscall1 (NUMBER, ARG0))
+#define syscall2(NUMBER, ARG0, ARG1)                            \
+        (use_sysenter ()                                        \
+         ? sysenter_syscall (NUMBER, ARG0, ARG1, 0)             \
+         : int_syscall2 (NUMBER, ARG0, ARG1))
+#define syscall3(NUMBER, ARG0, ARG1, ARG2)                      \
+        (use_sysenter ()                                        \
+         ? sysenter_syscall (NUMBER, ARG0, ARG1, ARG2)          \
+         : int_syscall3 (NUMBER, ARG0, ARG1, ARG2))
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        (use_sysenter ()                                        \
+         ? sysenter_syscall4 (NUMBER, ARG0, ARG1, ARG2, ARG3)   \
+         : int_syscall4 (NUMBER, ARG0, ARG1, ARG2, ARG3))
+
 void
 halt (void) 
 {
+  fflush (NULL);
   syscall0 (SYS_HALT);
   NOT_REACHED ();
 }
@@ -71,6 +181,9 @@ halt (void)
 void
 exit (int status)
 {
+  /* Flush buffered streams, since returning from main() ends up
+     here too (see lib/user/entry.c). */
+  fflush (NULL);
   syscall1 (SYS_EXIT, status);
   NOT_REACHED ();
 }
@@ -182,3 +295,140 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+int
+getrusage (int who, struct rusage *usage) 
+{
+  return syscall2 (SYS_GETRUSAGE, who, usage);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+struct ring *
+ring_setup (void)
+{
+  return (struct ring *) syscall0 (SYS_RING_SETUP);
+}
+
+int
+ring_enter (unsigned min_complete)
+{
+  return syscall1 (SYS_RING_ENTER, min_complete);
+}
+
+int
+pipe (int fds[2])
+{
+  return syscall1 (SYS_PIPE, fds);
+}
+
+int
+dup2 (int old_fd, int new_fd)
+{
+  return syscall2 (SYS_DUP2, old_fd, new_fd);
+}
+
+bool
+inherit (int fd, bool on)
+{
+  return syscall2 (SYS_INHERIT, fd, (int) on);
+}
+
+void *
+sbrk (intptr_t increment)
+{
+  return (void *) syscall1 (SYS_SBRK, increment);
+}
+
+int
+brk (void *end)
+{
+  uint8_t *old_end = sbrk (0);
+  return sbrk ((uint8_t *) end - old_end) != (void *) -1 ? 0 : -1;
+}
+
+/* Where threads started by thread_spawn() begin, with FUNC and
+   AUX on their new stacks. */
+static void NO_RETURN
+thread_start (thread_func *func, void *aux)
+{
+  thread_exit (func (aux));
+}
+
+tid_t
+thread_spawn (thread_func *func, void *aux)
+{
+  return syscall3 (SYS_THREAD_SPAWN, thread_start, func, aux);
+}
+
+int
+thread_join (tid_t tid)
+{
+  return syscall1 (SYS_THREAD_JOIN, tid);
+}
+
+void
+thread_exit (int status)
+{
+  syscall1 (SYS_THREAD_EXIT, status);
+  NOT_REACHED ();
+}
+
+int
+futex_wait (int *addr, int expected, int timeout)
+{
+  return syscall3 (SYS_FUTEX_WAIT, addr, expected, timeout);
+}
+
+int
+futex_wake (int *addr, int cnt)
+{
+  return syscall2 (SYS_FUTEX_WAKE, addr, cnt);
+}
+
+pid_t
+waitpid (pid_t pid, int *status, int options)
+{
+  return syscall3 (SYS_WAITPID, pid, status, options);
+}
+
+pid_t
+spawn (const char *file, char *const argv[],
+       const struct spawn_action *actions, int flags)
+{
+  return syscall4 (SYS_SPAWN, file, argv, actions, flags);
+}
+
+int
+shm_open (const char *name, size_t size)
+{
+  return syscall2 (SYS_SHM_OPEN, name, size);
+}
+
+void *
+shm_map (int fd)
+{
+  return (void *) syscall1 (SYS_SHM_MAP, fd);
+}
@@ -2,12 +2,27 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <debug.h>
+#include <ring.h>
+#include <rusage.h>
+#include <spawn.h>
+#include <uio.h>
+#include <wait.h>
 
 /* Process identifier. */
 typedef int pid_t;
 #define PID_ERROR ((pid_t) -1)
 
+/* Thread identifier. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+
+/* A function run by a thread started with thread_spawn().  The
+   thread exits with its return value. */
+typedef int thread_func (void *aux);
+
 /* Map region identifier. */
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
@@ -45,4 +60,28 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+int getrusage (int who, struct rusage *);
+int readv (int fd, const struct iovec *, int iovcnt);
+int writev (int fd, const struct iovec *, int iovcnt);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+struct ring *ring_setup (void);
+int ring_enter (unsigned min_complete);
+int pipe (int fds[2]);
+int dup2 (int old_fd, int new_fd);
+bool inherit (int fd, bool on);
+void *sbrk (intptr_t increment);
+int brk (void *end);
+tid_t thread_spawn (thread_func *, void *aux);
+int thread_join (tid_t);
+void thread_exit (int status) NO_RETURN;
+int futex_wait (int *, int expected, int timeout);
+int futex_wake (int *, int cnt);
+pid_t waitpid (pid_t, int *status, int options);
+pid_t spawn (const char *file, char *const argv[],
+             const struct spawn_action *, int flags);
+int shm_open (const char *name, size_t size);
+void *shm_map (int fd);
+
 #endif /* lib/user/syscall.h */
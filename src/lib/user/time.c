@@ -0,0 +1,95 @@
+#include <time.h>
+#include <stddef.h>
+#include <vclock.h>
+
+/* Clocks.
+
+   These functions read the clock page that the kernel maps into
+   every process (see lib/vclock.h), so they never enter the
+   kernel.  The page gives the time at the last timer tick, to
+   which the time-stamp counter adds the time since then. */
+
+#define NSEC_PER_SEC 1000000000
+
+/* Returns the time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns the nanoseconds since boot, and stores the time of boot
+   in seconds since the Epoch into *BOOT_TIME. */
+static uint64_t
+read_clock (uint64_t *boot_time)
+{
+  const volatile struct vclock *vc = VCLOCK_ADDR;
+  uint64_t tsc, tsc_per_tick, now, tick_ns, ns;
+  uint32_t seq;
+  int64_t ticks;
+
+  do
+    {
+      seq = vc->seq;
+      ticks = vc->ticks;
+      tsc = vc->tsc;
+      tsc_per_tick = vc->tsc_per_tick;
+      tick_ns = NSEC_PER_SEC / vc->tick_freq;
+      *boot_time = vc->boot_time;
+      now = rdtsc ();
+    }
+  while ((seq & 1) != 0 || vc->seq != seq);
+
+  ns = ticks * tick_ns;
+  if (tsc_per_tick != 0)
+    {
+      /* Stay short of the next tick, so that the clock never goes
+         backward even if the counter runs fast. */
+      uint64_t cycles = now - tsc;
+      if (cycles >= tsc_per_tick)
+        cycles = tsc_per_tick - 1;
+      ns += cycles * tick_ns / tsc_per_tick;
+    }
+  return ns;
+}
+
+/* Stores the current time on CLOCK into *TS.  Returns 0 if
+   successful, -1 if CLOCK is not a valid clock. */
+int
+clock_gettime (clockid_t clock, struct timespec *ts)
+{
+  uint64_t boot_time;
+  uint64_t ns = read_clock (&boot_time);
+
+  if (clock == CLOCK_REALTIME)
+    ns += boot_time * NSEC_PER_SEC;
+  else if (clock != CLOCK_MONOTONIC)
+    return -1;
+  ts->tv_sec = ns / NSEC_PER_SEC;
+  ts->tv_nsec = ns % NSEC_PER_SEC;
+  return 0;
+}
+
+/* Returns the nanoseconds since boot.  Cheaper than
+   clock_gettime(), for timing short intervals. */
+uint64_t
+clock_ns (void)
+{
+  uint64_t boot_time;
+  return read_clock (&boot_time);
+}
+
+/* Returns the seconds since the Epoch, also storing them into *T
+   if T is not a null pointer. */
+time_t
+time (time_t *t)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_REALTIME, &ts);
+  if (t != NULL)
+    *t = ts.tv_sec;
+  return ts.tv_sec;
+}
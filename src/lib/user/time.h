@@ -0,0 +1,24 @@
+#ifndef __LIB_USER_TIME_H
+#define __LIB_USER_TIME_H
+
+#include <stdint.h>
+
+typedef unsigned long time_t;
+typedef int clockid_t;
+
+/* Clocks for clock_gettime(). */
+#define CLOCK_REALTIME 0        /* Time since the Epoch. */
+#define CLOCK_MONOTONIC 1       /* Time since boot. */
+
+/* A time, as reported by clock_gettime(). */
+struct timespec
+  {
+    time_t tv_sec;              /* Seconds. */
+    long tv_nsec;               /* Nanoseconds, less than 1e9. */
+  };
+
+int clock_gettime (clockid_t, struct timespec *);
+uint64_t clock_ns (void);
+time_t time (time_t *);
+
+#endif /* lib/user/time.h */
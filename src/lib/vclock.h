@@ -0,0 +1,32 @@
+#ifndef __LIB_VCLOCK_H
+#define __LIB_VCLOCK_H
+
+#include <stdint.h>
+
+/* Clock page.
+
+   The kernel maps one read-only page at VCLOCK_ADDR into every
+   user process and updates it on every timer tick, so that user
+   programs can read the time without a system call.  The page
+   lies between the heap's limit and the lowest thread stack (see
+   lib/thread-stack.h), just above the page that system call rings
+   use.
+
+   SEQ is odd while the kernel is updating the page.  A reader
+   copies the other members between two reads of SEQ, and tries
+   again unless both reads returned the same even value.  Between
+   ticks, the time-stamp counter tells how far the current tick
+   has progressed. */
+#define VCLOCK_ADDR ((const volatile struct vclock *) 0xbf001000)
+
+struct vclock
+  {
+    uint32_t seq;               /* Number of updates started, times 2. */
+    uint32_t tick_freq;         /* Timer ticks per second. */
+    int64_t ticks;              /* Timer ticks since boot. */
+    uint64_t tsc;               /* Time-stamp counter at the last tick. */
+    uint64_t tsc_per_tick;      /* Its increase per tick, 0 if unknown. */
+    uint64_t boot_time;         /* Seconds since the Epoch at boot. */
+  };
+
+#endif /* lib/vclock.h */
@@ -0,0 +1,10 @@
+#ifndef __LIB_WAIT_H
+#define __LIB_WAIT_H
+
+/* Options for waitpid(). */
+#define WNOHANG 1               /* Return 0 if no child has exited. */
+
+/* Pid for waitpid() that stands for any child. */
+#define WAIT_ANY (-1)
+
+#endif /* lib/wait.h */
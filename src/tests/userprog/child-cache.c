@@ -0,0 +1,20 @@
+/* Child process run by the exec-cache test.
+   Modifies its initialized and zeroed data, which must not carry
+   over to the next process that executes the same program. */
+
+#include <stdio.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-cache";
+
+static int data = 42;
+static char bss[8192];
+
+int
+main (void) 
+{
+  msg ("data %d, bss %d", data, bss[5000]);
+  data++;
+  bss[5000] = 1;
+  return data;
+}
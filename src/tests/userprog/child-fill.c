@@ -0,0 +1,27 @@
+/* Child process run by spawn-limit test.
+
+   Writes FILL_PAGES pages to standard output from a buffer that
+   is not page-aligned, so that a pipe there has to copy them into
+   pages of its own.  Returns 0 if they were all written. */
+
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+#define PAGE 4096
+#define FILL_PAGES 32
+
+const char *test_name = "child-fill";
+
+static char buf[PAGE * (FILL_PAGES + 1)];
+
+int
+main (void) 
+{
+  char *p = (char *) ROUND_UP ((uintptr_t) buf, PAGE) + 1;
+
+  return write (STDOUT_FILENO, p, FILL_PAGES * PAGE) == FILL_PAGES * PAGE
+         ? 0 : 1;
+}
@@ -0,0 +1,33 @@
+/* Child process run by pipe-exec test.
+
+   Writes the sample data to standard output and then to the file
+   descriptor passed as the first command-line argument, which
+   the parent marked for inheritance, and checks that the
+   descriptor passed as the second argument, which it did not,
+   is not open. */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+
+const char *test_name = "child-pipe";
+
+int
+main (int argc, char *argv[]) 
+{
+  size_t size = sizeof sample - 1;
+  char c;
+
+  if (argc != 3 || !isdigit (*argv[1]) || !isdigit (*argv[2]))
+    return 1;
+  if (write (STDOUT_FILENO, sample, size) != (int) size)
+    return 2;
+  if (write (atoi (argv[1]), sample, size) != (int) size)
+    return 3;
+  if (read (atoi (argv[2]), &c, 1) != -1)
+    return 4;
+  return 0;
+}
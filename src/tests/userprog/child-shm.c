@@ -0,0 +1,32 @@
+/* Child process run by the shm test.
+   Opens the "shm-test" segment, checks the bytes the parent
+   wrote into its first page, then writes a reply into the
+   second. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-shm";
+
+int
+main (void) 
+{
+  char *buf;
+  int fd, i;
+
+  fd = shm_open ("shm-test", 4096);
+  if (fd < 2)
+    fail ("shm_open failed");
+  buf = shm_map (fd);
+  if (buf == NULL)
+    fail ("shm_map failed");
+  close (fd);
+
+  for (i = 0; i < 4096; i++)
+    if (buf[i] != (char) (i % 251))
+      fail ("byte %d is %d", i, buf[i]);
+  strlcpy (buf + 4096, "reply from child", 4096);
+  msg ("checked");
+  return 0;
+}
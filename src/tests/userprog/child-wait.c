@@ -0,0 +1,24 @@
+/* Child process run by the wait-any test.
+   Spins for 100 ms times its argument, then exits with the
+   argument as its status. */
+
+#include <stdlib.h>
+#include <time.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-wait";
+
+int
+main (int argc, char *argv[]) 
+{
+  int n;
+  uint64_t start;
+
+  if (argc != 2)
+    return -1;
+  n = atoi (argv[1]);
+  start = clock_ns ();
+  while (clock_ns () - start < n * 100000000ULL)
+    continue;
+  return n;
+}
@@ -0,0 +1,39 @@
+/* Reads the clocks from the clock page and checks that they are
+   consistent and move forward. */
+
+#include <time.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct timespec ts;
+  uint64_t start, prev, now;
+  time_t t;
+  int i;
+
+  CHECK (clock_gettime (-1, &ts) == -1, "clock_gettime rejects bad clock");
+
+  prev = start = clock_ns ();
+  for (i = 0; i < 10000; i++)
+    {
+      now = clock_ns ();
+      if (now < prev)
+        fail ("clock went from %llu to %llu ns", prev, now);
+      prev = now;
+    }
+  msg ("clock never goes backward");
+
+  /* Spin across several timer ticks. */
+  while (clock_ns () - start < 50 * 1000 * 1000)
+    continue;
+  msg ("clock advances");
+
+  CHECK (clock_gettime (CLOCK_MONOTONIC, &ts) == 0
+         && ts.tv_nsec >= 0 && ts.tv_nsec < 1000 * 1000 * 1000,
+         "monotonic time is valid");
+  CHECK (clock_gettime (CLOCK_REALTIME, &ts) == 0, "get realtime");
+  t = time (NULL);
+  CHECK (t - ts.tv_sec <= 1, "time() agrees with realtime clock");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(clock) begin
+(clock) clock_gettime rejects bad clock
+(clock) clock never goes backward
+(clock) clock advances
+(clock) monotonic time is valid
+(clock) get realtime
+(clock) time() agrees with realtime clock
+(clock) end
+clock: exit(0)
+EOF
+pass;
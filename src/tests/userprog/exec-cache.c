@@ -0,0 +1,16 @@
+/* Executes the same program repeatedly, so that later execs are
+   served from the exec cache, and checks that every child starts
+   out with pristine data. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int i;
+
+  for (i = 0; i < 3; i++)
+    msg ("wait: %d", wait (exec ("child-cache")));
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(exec-cache) begin
+(child-cache) data 42, bss 0
+child-cache: exit(43)
+(exec-cache) wait: 43
+(child-cache) data 42, bss 0
+child-cache: exit(43)
+(exec-cache) wait: 43
+(child-cache) data 42, bss 0
+child-cache: exit(43)
+(exec-cache) wait: 43
+(exec-cache) end
+exec-cache: exit(0)
+EOF
+pass;
@@ -0,0 +1,12 @@
+/* Tests that quotes group words into one argument, are removed,
+   and can quote each other, and that a pair of quotes passes an
+   empty argument. */
+
+#include <syscall.h>
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  wait (exec ("child-args 'two  words' \"it's\"x '' \t last"));
+}
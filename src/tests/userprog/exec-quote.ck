@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(exec-quote) begin
+(args) begin
+(args) argc = 5
+(args) argv[0] = 'child-args'
+(args) argv[1] = 'two  words'
+(args) argv[2] = 'it'sx'
+(args) argv[3] = ''
+(args) argv[4] = 'last'
+(args) argv[5] = null
+(args) end
+child-args: exit(0)
+(exec-quote) end
+exec-quote: exit(0)
+EOF
+pass;
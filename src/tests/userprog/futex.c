@@ -0,0 +1,101 @@
+/* Checks futex_wait() and futex_wake() directly, then has
+   several threads share a counter under a mutex and hand values
+   to each other through a condition variable. */
+
+#include <synch.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define ITER_CNT 1000
+#define VALUE_CNT 100
+
+static struct mutex lock = MUTEX_INITIALIZER;
+static volatile int counter;
+
+/* One-slot mailbox. */
+static struct condvar changed = CONDVAR_INITIALIZER;
+static bool full;
+static int value;
+
+/* Increments COUNTER ITER_CNT times, slowly enough that threads
+   are often preempted while holding LOCK. */
+static int
+count (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      volatile int j;
+      int old;
+
+      mutex_lock (&lock);
+      old = counter;
+      for (j = 0; j < 100; j++)
+        continue;
+      counter = old + 1;
+      mutex_unlock (&lock);
+    }
+  return 0;
+}
+
+/* Takes VALUE_CNT values out of the mailbox and returns their
+   sum. */
+static int
+consume (void *aux UNUSED)
+{
+  int sum = 0;
+  int i;
+
+  for (i = 0; i < VALUE_CNT; i++)
+    {
+      mutex_lock (&lock);
+      while (!full)
+        cond_wait (&changed, &lock);
+      sum += value;
+      full = false;
+      cond_broadcast (&changed);
+      mutex_unlock (&lock);
+    }
+  return sum;
+}
+
+void
+test_main (void) 
+{
+  tid_t tids[THREAD_CNT];
+  int word = 0;
+  int i;
+
+  CHECK (futex_wait (&word, 1, -1) == -1, "wait on changed value fails");
+  CHECK (futex_wait (&word, 0, 10) == 1, "wait times out");
+  CHECK (futex_wake (&word, 1) == 0, "wake with no waiters wakes none");
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      tids[i] = thread_spawn (count, NULL);
+      if (tids[i] == TID_ERROR)
+        fail ("thread_spawn failed");
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    thread_join (tids[i]);
+  CHECK (counter == THREAD_CNT * ITER_CNT, "counter is %d", counter);
+
+  tids[0] = thread_spawn (consume, NULL);
+  if (tids[0] == TID_ERROR)
+    fail ("thread_spawn failed");
+  for (i = 0; i < VALUE_CNT; i++)
+    {
+      mutex_lock (&lock);
+      while (full)
+        cond_wait (&changed, &lock);
+      value = i;
+      full = true;
+      cond_broadcast (&changed);
+      mutex_unlock (&lock);
+    }
+  CHECK (thread_join (tids[0]) == VALUE_CNT * (VALUE_CNT - 1) / 2,
+         "consumer got all values");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex) begin
+(futex) wait on changed value fails
+(futex) wait times out
+(futex) wake with no waiters wakes none
+(futex) counter is 4000
+(futex) consumer got all values
+(futex) end
+futex: exit(0)
+EOF
+pass;
@@ -0,0 +1,72 @@
+/* Reads the resource usage of the calling process, which must
+   have some pages resident, and checks that asking for the usage
+   of anything else fails.  Then checks that a fault on a new heap
+   page is counted as a minor fault, that a pipe's buffer page is
+   counted as held for the writer rather than resident, and that
+   CPU time, system calls and bytes written are counted, for the
+   process itself and for a child it has waited for. */
+
+#include <syscall.h>
+#include <time.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+
+void
+test_main (void) 
+{
+  static const char buf[100];
+  struct rusage usage, after;
+  uint64_t start;
+  char *heap;
+  int fds[2];
+  int fd;
+
+  CHECK (getrusage (RUSAGE_SELF, &usage) == 0, "getrusage (RUSAGE_SELF)");
+  CHECK (usage.ru_rss > 0, "resident set is not empty");
+  CHECK (getrusage (-1, &usage) == -1, "getrusage (-1) fails");
+
+  /* The page holding HEAP + PAGE lies wholly above the old break,
+     so the write below is its first access. */
+  CHECK ((heap = sbrk (2 * PAGE)) != (void *) -1, "grow heap");
+  getrusage (RUSAGE_SELF, &usage);
+  heap[PAGE] = 1;
+  getrusage (RUSAGE_SELF, &after);
+  CHECK (after.ru_minflt > usage.ru_minflt
+         && after.ru_majflt == usage.ru_majflt,
+         "heap fault counted as minor");
+
+  CHECK (pipe (fds) == 0, "pipe");
+  getrusage (RUSAGE_SELF, &usage);
+  write (fds[1], buf, sizeof buf);
+  getrusage (RUSAGE_SELF, &after);
+  CHECK (after.ru_held == usage.ru_held + 1
+         && after.ru_rss == usage.ru_rss, "pipe buffer counted as held");
+  close (fds[0]);
+  close (fds[1]);
+  getrusage (RUSAGE_SELF, &after);
+  CHECK (after.ru_held == usage.ru_held, "pipe buffer given back");
+
+  CHECK (create ("usage", 0), "create \"usage\"");
+  CHECK ((fd = open ("usage")) > 1, "open \"usage\"");
+  getrusage (RUSAGE_SELF, &usage);
+  write (fd, buf, sizeof buf);
+  start = clock_ns ();
+  while (clock_ns () - start < 100 * 1000 * 1000)
+    continue;
+  getrusage (RUSAGE_SELF, &after);
+  CHECK (after.ru_outbytes - usage.ru_outbytes == sizeof buf,
+         "write of %zu bytes counted", sizeof buf);
+  CHECK (after.ru_nsyscalls - usage.ru_nsyscalls == 2,
+         "system calls counted");
+  CHECK (after.ru_utime > usage.ru_utime, "user time counted");
+  close (fd);
+
+  CHECK (getrusage (RUSAGE_CHILDREN, &usage) == 0
+         && usage.ru_nsyscalls == 0, "no child usage yet");
+  wait (exec ("child-simple"));
+  CHECK (getrusage (RUSAGE_CHILDREN, &usage) == 0
+         && usage.ru_nsyscalls > 0 && usage.ru_rss == 0,
+         "child usage counted");
+}
@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(getrusage) begin
+(getrusage) getrusage (RUSAGE_SELF)
+(getrusage) resident set is not empty
+(getrusage) getrusage (-1) fails
+(getrusage) grow heap
+(getrusage) heap fault counted as minor
+(getrusage) pipe
+(getrusage) pipe buffer counted as held
+(getrusage) pipe buffer given back
+(getrusage) create "usage"
+(getrusage) open "usage"
+(getrusage) write of 100 bytes counted
+(getrusage) system calls counted
+(getrusage) user time counted
+(getrusage) no child usage yet
+(child-simple) run
+child-simple: exit(81)
+(getrusage) child usage counted
+(getrusage) end
+getrusage: exit(0)
+EOF
+pass;
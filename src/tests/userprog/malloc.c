@@ -0,0 +1,80 @@
+/* Allocates blocks of many sizes with malloc(), fills each with
+   its own pattern, frees and reallocates half of them, and checks
+   that no block's contents are disturbed.  Also checks calloc()
+   and realloc(). */
+
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_CNT 64
+
+static char *blocks[BLOCK_CNT];
+static size_t sizes[BLOCK_CNT];
+
+/* Allocates block I and fills it with its pattern. */
+static void
+alloc_block (int i)
+{
+  blocks[i] = malloc (sizes[i]);
+  if (blocks[i] == NULL)
+    fail ("malloc(%zu) failed", sizes[i]);
+  memset (blocks[i], i, sizes[i]);
+}
+
+/* Checks that every allocated block still holds its pattern. */
+static void
+check_blocks (void)
+{
+  int i;
+  size_t j;
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    for (j = 0; blocks[i] != NULL && j < sizes[i]; j++)
+      if (blocks[i][j] != (char) i)
+        fail ("byte %zu of block %d is %d", j, i, blocks[i][j]);
+}
+
+void
+test_main (void) 
+{
+  char *p;
+  int i;
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      sizes[i] = (1 << (i % 14)) + i;
+      alloc_block (i);
+    }
+  check_blocks ();
+  msg ("allocated %d blocks", BLOCK_CNT);
+
+  for (i = 1; i < BLOCK_CNT; i += 2)
+    {
+      free (blocks[i]);
+      blocks[i] = NULL;
+    }
+  check_blocks ();
+  for (i = 1; i < BLOCK_CNT; i += 2)
+    alloc_block (i);
+  check_blocks ();
+  msg ("freed and reallocated half of them");
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    free (blocks[i]);
+
+  p = calloc (100, 40);
+  CHECK (p != NULL, "calloc");
+  for (i = 0; i < 4000; i++)
+    if (p[i] != 0)
+      fail ("byte %d from calloc is %d", i, p[i]);
+  free (p);
+
+  p = malloc (10);
+  strlcpy (p, "realloc", 10);
+  p = realloc (p, 5000);
+  CHECK (p != NULL && !strcmp (p, "realloc"), "realloc keeps contents");
+  free (p);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc) begin
+(malloc) allocated 64 blocks
+(malloc) freed and reallocated half of them
+(malloc) calloc
+(malloc) realloc keeps contents
+(malloc) end
+malloc: exit(0)
+EOF
+pass;
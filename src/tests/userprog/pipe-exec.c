@@ -0,0 +1,46 @@
+/* Runs child-pipe with its standard output redirected into a
+   pipe, and checks that the data it writes there, and to the
+   pipe's write end, which it is told to inherit, arrive in
+   order.  The data fits in the pipe, so the child can finish
+   before we read. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char child_cmd[128];
+  char buf[2 * sizeof sample];
+  size_t size = sizeof sample - 1;
+  int fds[2], saved_stdout;
+  int bytes, n;
+  pid_t child;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (inherit (fds[1], true), "inherit write end");
+  CHECK ((saved_stdout = dup2 (STDOUT_FILENO, 100)) == 100,
+         "save stdout");
+
+  /* No output until stdout is restored. */
+  snprintf (child_cmd, sizeof child_cmd, "child-pipe %d %d",
+            fds[1], fds[0]);
+  dup2 (fds[1], STDOUT_FILENO);
+  child = exec (child_cmd);
+  dup2 (saved_stdout, STDOUT_FILENO);
+  close (saved_stdout);
+  close (fds[1]);
+  CHECK (child != PID_ERROR, "exec child-pipe");
+  msg ("wait(exec()) = %d", wait (child));
+
+  for (bytes = 0; (n = read (fds[0], buf + bytes, sizeof buf - bytes)) > 0;
+       bytes += n)
+    continue;
+  CHECK (bytes == (int) (2 * size), "read %d bytes until end of file",
+         bytes);
+  compare_bytes (buf, sample, size, 0, "stdout");
+  compare_bytes (buf + size, sample, size, 0, "write end");
+}
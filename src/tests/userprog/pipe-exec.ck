@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-exec) begin
+(pipe-exec) pipe
+(pipe-exec) inherit write end
+(pipe-exec) save stdout
+(pipe-exec) exec child-pipe
+child-pipe: exit(0)
+(pipe-exec) wait(exec()) = 0
+(pipe-exec) read 478 bytes until end of file
+(pipe-exec) end
+pipe-exec: exit(0)
+EOF
+pass;
@@ -0,0 +1,79 @@
+/* Has a thread wait on a futex in a page-aligned buffer, moves
+   that buffer's page through a pipe, and checks that changing the
+   futex and waking it still wakes the thread.  Does so first for
+   a page written to the pipe, then for a page read from it. */
+
+#include <round.h>
+#include <stdint.h>
+#include <syscall.h>
+#include <time.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+
+static char src_buf[PAGE * 2];
+static char dst_buf[PAGE * 2];
+static volatile bool ready;
+
+/* Waits on the futex at WORD_, which must hold 0. */
+static int
+waiter (void *word_)
+{
+  int *word = word_;
+
+  ready = true;
+  return futex_wait (word, 0, -1);
+}
+
+/* Starts a thread waiting on the futex at WORD and gives it time
+   to go to sleep. */
+static tid_t
+start_waiter (int *word)
+{
+  uint64_t start;
+  tid_t tid;
+
+  ready = false;
+  tid = thread_spawn (waiter, word);
+  if (tid == TID_ERROR)
+    fail ("thread_spawn failed");
+  while (!ready)
+    continue;
+  start = clock_ns ();
+  while (clock_ns () - start < 100 * 1000 * 1000)
+    continue;
+  return tid;
+}
+
+/* Changes the futex at WORD and wakes the thread TID waiting on
+   it, which must return 0. */
+static void
+wake_waiter (int *word, tid_t tid, const char *what)
+{
+  *word = 1;
+  CHECK (futex_wake (word, 1) == 1, "wake waiter on %s page", what);
+  CHECK (thread_join (tid) == 0, "waiter on %s page woken", what);
+}
+
+void
+test_main (void) 
+{
+  int *src = (int *) ROUND_UP ((uintptr_t) src_buf, PAGE);
+  int *dst = (int *) ROUND_UP ((uintptr_t) dst_buf, PAGE);
+  int fds[2];
+  tid_t tid;
+
+  *src = 0;
+  *dst = 0;
+  CHECK (pipe (fds) == 0, "pipe");
+
+  tid = start_waiter (src);
+  CHECK (write (fds[1], src, PAGE) == PAGE, "write page");
+  wake_waiter (src, tid, "written");
+
+  tid = start_waiter (dst);
+  CHECK (read (fds[0], dst, PAGE) == PAGE, "read page");
+  CHECK (*dst == 0, "read back what was written");
+  wake_waiter (dst, tid, "read");
+}
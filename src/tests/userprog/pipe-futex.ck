@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-futex) begin
+(pipe-futex) pipe
+(pipe-futex) write page
+(pipe-futex) wake waiter on written page
+(pipe-futex) waiter on written page woken
+(pipe-futex) read page
+(pipe-futex) read back what was written
+(pipe-futex) wake waiter on read page
+(pipe-futex) waiter on read page woken
+(pipe-futex) end
+pipe-futex: exit(0)
+EOF
+pass;
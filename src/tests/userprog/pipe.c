@@ -0,0 +1,67 @@
+/* Writes to a pipe and reads the data back, in pieces both
+   smaller than a page and of whole page-aligned pages, which the
+   kernel may move from writer to reader without copying.  Checks
+   that changes either side makes afterward stay private, and that
+   the read end sees end of file once the write end is closed. */
+
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+
+static char src_buf[PAGE * 3];
+static char dst_buf[PAGE * 3];
+
+/* Returns the byte expected at offset I of the page test data. */
+static char
+pattern (size_t i)
+{
+  return i % 251;
+}
+
+void
+test_main (void) 
+{
+  char *src = (char *) ROUND_UP ((uintptr_t) src_buf, PAGE);
+  char *dst = (char *) ROUND_UP ((uintptr_t) dst_buf, PAGE);
+  char buf[sizeof sample];
+  size_t size = sizeof sample - 1;
+  int fds[2];
+  size_t i;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (fds[0] > 1 && fds[1] > 1 && fds[0] != fds[1],
+         "pipe returned two new descriptors");
+
+  CHECK (write (fds[1], sample, size) == (int) size, "write sample");
+  CHECK (read (fds[0], buf, 10) == 10, "read first 10 bytes");
+  CHECK (read (fds[0], buf + 10, sizeof buf) == (int) size - 10,
+         "read the rest");
+  compare_bytes (buf, sample, size, 0, "pipe");
+
+  for (i = 0; i < 2 * PAGE; i++)
+    src[i] = pattern (i);
+  CHECK (write (fds[1], src, 2 * PAGE) == 2 * PAGE, "write two pages");
+  memset (src, 0, PAGE);
+  CHECK (read (fds[0], dst, 2 * PAGE) == 2 * PAGE, "read two pages");
+  for (i = 0; i < 2 * PAGE; i++)
+    if (dst[i] != pattern (i))
+      fail ("byte %zu read from pipe is %d, not %d",
+            i, dst[i], pattern (i));
+  memset (dst + PAGE, 0, PAGE);
+  for (i = PAGE; i < 2 * PAGE; i++)
+    if (src[i] != pattern (i))
+      fail ("writer's byte %zu changed by reader", i);
+
+  CHECK (read (fds[1], buf, 1) == -1, "read from write end fails");
+  CHECK (write (fds[0], buf, 1) == -1, "write to read end fails");
+
+  close (fds[1]);
+  CHECK (read (fds[0], buf, 1) == 0, "read after closing write end");
+  close (fds[0]);
+}
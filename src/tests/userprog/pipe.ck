@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe) begin
+(pipe) pipe
+(pipe) pipe returned two new descriptors
+(pipe) write sample
+(pipe) read first 10 bytes
+(pipe) read the rest
+(pipe) write two pages
+(pipe) read two pages
+(pipe) read from write end fails
+(pipe) write to read end fails
+(pipe) read after closing write end
+(pipe) end
+pipe: exit(0)
+EOF
+pass;
@@ -0,0 +1,42 @@
+/* Writes and reads "sample.txt"'s contents at given offsets with
+   pwrite() and pread(), and checks that neither moves the file
+   position. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[sizeof sample];
+  size_t size = sizeof sample - 1;
+  int handle, byte_cnt;
+
+  CHECK (create ("test.txt", size), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  byte_cnt = pwrite (handle, sample + 20, size - 20, 20);
+  if (byte_cnt != (int) size - 20)
+    fail ("pwrite() returned %d instead of %zu", byte_cnt, size - 20);
+  byte_cnt = pwrite (handle, sample, 20, 0);
+  if (byte_cnt != 20)
+    fail ("pwrite() returned %d instead of 20", byte_cnt);
+  CHECK (tell (handle) == 0, "pwrite leaves position alone");
+
+  memset (buf, 0, sizeof buf);
+  byte_cnt = pread (handle, buf + 5, size - 5, 5);
+  if (byte_cnt != (int) size - 5)
+    fail ("pread() returned %d instead of %zu", byte_cnt, size - 5);
+  byte_cnt = pread (handle, buf, 5, 0);
+  if (byte_cnt != 5)
+    fail ("pread() returned %d instead of 5", byte_cnt);
+  CHECK (tell (handle) == 0, "pread leaves position alone");
+  compare_bytes (buf, sample, size, 0, "test.txt");
+
+  CHECK (pread (STDOUT_FILENO, buf, 1, 0) == -1,
+         "pread from console fails");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-pwrite) begin
+(pread-pwrite) create "test.txt"
+(pread-pwrite) open "test.txt"
+(pread-pwrite) pwrite leaves position alone
+(pread-pwrite) pread leaves position alone
+(pread-pwrite) pread from console fails
+(pread-pwrite) end
+pread-pwrite: exit(0)
+EOF
+pass;
@@ -0,0 +1,45 @@
+/* Writes "sample.txt"'s contents to a new file as three buffers
+   with writev(), then reads them back with readv() into buffers
+   split at different places and checks the result. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[sizeof sample];
+  struct iovec iov[3];
+  size_t size = sizeof sample - 1;
+  int handle, byte_cnt;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  iov[0].iov_base = sample;
+  iov[0].iov_len = 10;
+  iov[1].iov_base = sample + 10;
+  iov[1].iov_len = 0;
+  iov[2].iov_base = sample + 10;
+  iov[2].iov_len = size - 10;
+  byte_cnt = writev (handle, iov, 3);
+  if (byte_cnt != (int) size)
+    fail ("writev() returned %d instead of %zu", byte_cnt, size);
+
+  seek (handle, 0);
+  memset (buf, 0, sizeof buf);
+  iov[0].iov_base = buf;
+  iov[0].iov_len = 100;
+  iov[1].iov_base = buf + 100;
+  iov[1].iov_len = sizeof buf - 100;
+  byte_cnt = readv (handle, iov, 2);
+  if (byte_cnt != (int) size)
+    fail ("readv() returned %d instead of %zu", byte_cnt, size);
+  compare_bytes (buf, sample, size, 0, "test.txt");
+
+  CHECK (readv (handle, iov, -1) == -1, "readv with negative count fails");
+  CHECK (writev (-1, iov, 1) == -1, "writev to bad fd fails");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(readv-writev) begin
+(readv-writev) create "test.txt"
+(readv-writev) open "test.txt"
+(readv-writev) readv with negative count fails
+(readv-writev) writev to bad fd fails
+(readv-writev) end
+readv-writev: exit(0)
+EOF
+pass;
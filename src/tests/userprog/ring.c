@@ -0,0 +1,70 @@
+/* Queues writes and reads on a file through the submission ring,
+   waits for their completions, and checks the results.  Also
+   checks that a call that may not be queued fails without killing
+   the process. */
+
+#include <ring.h>
+#include <string.h>
+#include <syscall.h>
+#include <syscall-nr.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static struct ring *ring;
+
+/* Queues system call NR with arguments A0...A3. */
+static void
+submit (uint32_t nr, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3)
+{
+  struct ring_sqe *sqe = &ring->sqes[ring->sq_tail % RING_ENTRIES];
+
+  sqe->nr = nr;
+  sqe->args[0] = a0;
+  sqe->args[1] = a1;
+  sqe->args[2] = a2;
+  sqe->args[3] = a3;
+  sqe->user_data = ring->sq_tail;
+  asm volatile ("" : : : "memory");
+  ring->sq_tail++;
+}
+
+/* Consumes the next completion and returns its result. */
+static int32_t
+reap (void)
+{
+  struct ring_cqe *cqe = &ring->cqes[ring->cq_head % RING_ENTRIES];
+  int32_t res = cqe->res;
+
+  if (cqe->user_data != ring->cq_head)
+    fail ("completion %u out of order", (unsigned) ring->cq_head);
+  ring->cq_head++;
+  return res;
+}
+
+void
+test_main (void) 
+{
+  char buf[sizeof sample];
+  size_t size = sizeof sample - 1;
+  int handle;
+
+  CHECK ((ring = ring_setup ()) != NULL, "ring_setup");
+  CHECK (ring_setup () == NULL, "second ring_setup fails");
+  CHECK (create ("test.txt", size), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  memset (buf, 0, sizeof buf);
+  submit (SYS_WRITE, handle, (uint32_t) sample, size, 0);
+  submit (SYS_PREAD, handle, (uint32_t) buf, size, 0);
+  submit (SYS_EXIT, 1, 0, 0, 0);
+  CHECK (ring_enter (3) == 3, "ring_enter");
+
+  if (reap () != (int32_t) size)
+    fail ("queued write did not write %zu bytes", size);
+  if (reap () != (int32_t) size)
+    fail ("queued pread did not read %zu bytes", size);
+  compare_bytes (buf, sample, size, 0, "test.txt");
+  CHECK (reap () == -1, "queued exit fails");
+  CHECK (ring_enter (0) == 0, "no completions left");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(ring) begin
+(ring) ring_setup
+(ring) second ring_setup fails
+(ring) create "test.txt"
+(ring) open "test.txt"
+(ring) ring_enter
+(ring) queued exit fails
+(ring) no completions left
+(ring) end
+ring: exit(0)
+EOF
+pass;
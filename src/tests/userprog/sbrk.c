@@ -0,0 +1,45 @@
+/* Grows the heap with sbrk() and checks that the new memory reads
+   as zeros and can be written, then shrinks and regrows it, and
+   checks that the break cannot move below the start of the
+   heap. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+
+/* Fails unless the SIZE bytes at P all equal C. */
+static void
+check_bytes (const char *p, size_t size, char c, const char *what)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != c)
+      fail ("byte %zu of %s is %d, not %d", i, what, p[i], c);
+}
+
+void
+test_main (void) 
+{
+  char *start = sbrk (0);
+
+  CHECK (start != (void *) -1, "sbrk(0)");
+  CHECK (sbrk (3 * PAGE) == start, "grow heap by 3 pages");
+  CHECK (sbrk (0) == start + 3 * PAGE, "break moved up");
+  check_bytes (start, 3 * PAGE, 0, "new heap");
+  memset (start, 0x5a, 3 * PAGE);
+
+  CHECK (sbrk (-2 * PAGE) == start + 3 * PAGE, "shrink heap by 2 pages");
+  CHECK (sbrk (2 * PAGE) == start + PAGE, "grow heap by 2 pages");
+  check_bytes (start, PAGE, 0x5a, "kept page");
+  check_bytes (start + PAGE, 2 * PAGE, 0, "regrown heap");
+
+  CHECK (sbrk (-3 * PAGE - 1) == (void *) -1,
+         "sbrk below start of heap fails");
+  CHECK (brk (start) == 0, "brk to start of heap");
+  CHECK (sbrk (0) == start, "heap is empty");
+}
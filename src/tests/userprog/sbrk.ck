@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sbrk) begin
+(sbrk) sbrk(0)
+(sbrk) grow heap by 3 pages
+(sbrk) break moved up
+(sbrk) shrink heap by 2 pages
+(sbrk) grow heap by 2 pages
+(sbrk) sbrk below start of heap fails
+(sbrk) brk to start of heap
+(sbrk) heap is empty
+(sbrk) end
+sbrk: exit(0)
+EOF
+pass;
@@ -0,0 +1,30 @@
+/* Creates a two-page shared memory segment, fills it, and runs
+   child-shm, which opens the segment by name, checks what we
+   wrote and writes back a reply that we must then see.  Also
+   checks that a segment cannot be reopened bigger than it is. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char *buf;
+  int fd, i;
+
+  CHECK ((fd = shm_open ("shm-test", 8192)) > 1, "shm_open \"shm-test\"");
+  CHECK ((buf = shm_map (fd)) != NULL, "shm_map");
+  for (i = 0; i < 8192; i++)
+    buf[i] = i % 251;
+
+  CHECK (shm_open ("shm-test", 3 * 4096) == -1,
+         "shm_open with a bigger size fails");
+  CHECK (shm_open ("shm-empty", 0) == -1, "shm_open with no size fails");
+
+  msg ("wait(exec()) = %d", wait (exec ("child-shm")));
+  if (strcmp (buf + 4096, "reply from child"))
+    fail ("reply not seen");
+  msg ("reply seen");
+}
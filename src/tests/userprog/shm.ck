@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(shm) begin
+(shm) shm_open "shm-test"
+(shm) shm_map
+(shm) shm_open with a bigger size fails
+(shm) shm_open with no size fails
+(child-shm) checked
+(shm) wait(exec()) = 0
+(shm) reply seen
+(shm) end
+EOF
+pass;
@@ -0,0 +1,64 @@
+/* Spawns child-simple with memory limits.  A limit too low to
+   load the program makes spawn() fail, while one with room to
+   spare lets the child run as usual.  Then checks that a
+   descriptor limit keeps spawn() from duplicating a descriptor
+   into the child at or above it, but not below.  Last, has
+   child-fill write into a pipe under a kernel memory limit too
+   small to hold the pipe's pages, which are user data and so do
+   not count against it. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[4096];
+
+void
+test_main (void) 
+{
+  struct spawn_action actions[3];
+  int fds[2];
+  int total, n;
+  pid_t child;
+
+  actions[0] = (struct spawn_action) {SPAWN_LIMIT, SPAWN_LIMIT_RSS, 4};
+  actions[1] = (struct spawn_action) {SPAWN_END, 0, 0};
+  CHECK (spawn ("child-simple", NULL, actions, 0) == PID_ERROR,
+         "spawn with a 4-page limit fails");
+
+  actions[0] = (struct spawn_action) {SPAWN_LIMIT, SPAWN_LIMIT_RSS, 256};
+  actions[1] = (struct spawn_action) {SPAWN_LIMIT, SPAWN_LIMIT_KMEM, 16};
+  actions[2] = (struct spawn_action) {SPAWN_END, 0, 0};
+  child = spawn ("child-simple", NULL, actions, 0);
+  CHECK (child != PID_ERROR, "spawn with room to spare");
+  msg ("wait(spawn()) = %d", wait (child));
+
+  actions[0] = (struct spawn_action) {SPAWN_LIMIT, 7, 256};
+  actions[1] = (struct spawn_action) {SPAWN_END, 0, 0};
+  CHECK (spawn ("child-simple", NULL, actions, 0) == PID_ERROR,
+         "spawn with a bad limit fails");
+
+  actions[0] = (struct spawn_action) {SPAWN_LIMIT, SPAWN_LIMIT_FD, 5};
+  actions[1] = (struct spawn_action) {SPAWN_DUP2, 1, 5};
+  actions[2] = (struct spawn_action) {SPAWN_END, 0, 0};
+  CHECK (spawn ("child-simple", NULL, actions, 0) == PID_ERROR,
+         "spawn with a descriptor at its limit fails");
+
+  actions[0] = (struct spawn_action) {SPAWN_LIMIT, SPAWN_LIMIT_FD, 6};
+  child = spawn ("child-simple", NULL, actions, 0);
+  CHECK (child != PID_ERROR, "spawn with a descriptor below its limit");
+  msg ("wait(spawn()) = %d", wait (child));
+
+  CHECK (pipe (fds) == 0, "pipe");
+  actions[0] = (struct spawn_action) {SPAWN_LIMIT, SPAWN_LIMIT_KMEM, 16};
+  actions[1] = (struct spawn_action) {SPAWN_DUP2, fds[1], STDOUT_FILENO};
+  child = spawn ("child-fill", NULL, actions, 0);
+  CHECK (child != PID_ERROR, "spawn child-fill with stdout to a pipe");
+  close (fds[1]);
+  total = 0;
+  while ((n = read (fds[0], buf, sizeof buf)) > 0)
+    total += n;
+  msg ("read %d bytes", total);
+  msg ("wait(spawn()) = %d", wait (child));
+}
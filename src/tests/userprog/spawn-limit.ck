@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(spawn-limit) begin
+(spawn-limit) spawn with a 4-page limit fails
+(spawn-limit) spawn with room to spare
+(child-simple) run
+(spawn-limit) wait(spawn()) = 81
+(spawn-limit) spawn with a bad limit fails
+(spawn-limit) spawn with a descriptor at its limit fails
+(spawn-limit) spawn with a descriptor below its limit
+(child-simple) run
+(spawn-limit) wait(spawn()) = 81
+(spawn-limit) pipe
+(spawn-limit) spawn child-fill with stdout to a pipe
+(spawn-limit) read 131072 bytes
+(spawn-limit) wait(spawn()) = 0
+(spawn-limit) end
+EOF
+pass;
@@ -0,0 +1,57 @@
+/* Runs child-pipe with spawn(), passing its arguments as an
+   array and redirecting its standard output into a pipe with
+   file actions instead of dup2() and inherit() calls of our own.
+   Then checks that a program spawned without waiting for it to
+   load, which fails to load, reports exit status -1. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char read_fd[16];
+  char *argv[] = {"child-pipe", "20", read_fd, NULL};
+  struct spawn_action actions[4];
+  char buf[2 * sizeof sample];
+  size_t size = sizeof sample - 1;
+  int fds[2];
+  int bytes, n;
+  pid_t child;
+
+  CHECK (pipe (fds) == 0, "pipe");
+
+  /* The child gets the write end as stdout and as descriptor 20,
+     and must not see the read end, even though we inherit it. */
+  CHECK (inherit (fds[0], true), "inherit read end");
+  snprintf (read_fd, sizeof read_fd, "%d", fds[0]);
+  actions[0] = (struct spawn_action) {SPAWN_DUP2, fds[1], STDOUT_FILENO};
+  actions[1] = (struct spawn_action) {SPAWN_DUP2, fds[1], 20};
+  actions[2] = (struct spawn_action) {SPAWN_CLOSE, fds[0], 0};
+  actions[3] = (struct spawn_action) {SPAWN_END, 0, 0};
+  child = spawn ("child-pipe", argv, actions, 0);
+  close (fds[1]);
+  CHECK (child != PID_ERROR, "spawn child-pipe");
+  msg ("wait(spawn()) = %d", wait (child));
+
+  for (bytes = 0; (n = read (fds[0], buf + bytes, sizeof buf - bytes)) > 0;
+       bytes += n)
+    continue;
+  CHECK (bytes == (int) (2 * size), "read %d bytes until end of file",
+         bytes);
+  compare_bytes (buf, sample, size, 0, "stdout");
+  compare_bytes (buf + size, sample, size, 0, "descriptor 20");
+
+  /* A file action on a descriptor that is not open fails. */
+  actions[0] = (struct spawn_action) {SPAWN_CLOSE, 50, 0};
+  actions[1] = (struct spawn_action) {SPAWN_END, 0, 0};
+  CHECK (spawn ("child-simple", NULL, actions, 0) == PID_ERROR,
+         "spawn with a bad file action fails");
+
+  child = spawn ("no-such-file", NULL, NULL, SPAWN_ASYNC);
+  CHECK (child != PID_ERROR, "spawn no-such-file without waiting");
+  msg ("wait(spawn()) = %d", wait (child));
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(spawn) begin
+(spawn) pipe
+(spawn) inherit read end
+(spawn) spawn child-pipe
+(spawn) wait(spawn()) = 0
+(spawn) read 478 bytes until end of file
+(spawn) spawn with a bad file action fails
+(spawn) spawn no-such-file without waiting
+load: no-such-file: open failed
+(spawn) wait(spawn()) = -1
+(spawn) end
+EOF
+pass;
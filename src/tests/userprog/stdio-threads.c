@@ -0,0 +1,65 @@
+/* Has several threads print lines to one buffered stream at once,
+   then reads the file back and checks that every line came out
+   whole and that each thread's lines are in order. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define LINE_CNT 50
+#define LINE_LEN 5              /* "T:NN\n". */
+
+static FILE *f;
+
+static int
+print_lines (void *aux)
+{
+  int t = *(int *) aux;
+  int i;
+
+  for (i = 0; i < LINE_CNT; i++)
+    fprintf (f, "%d:%02d\n", t, i);
+  return 0;
+}
+
+void
+test_main (void) 
+{
+  static int ids[THREAD_CNT];
+  static char buf[THREAD_CNT * LINE_CNT * LINE_LEN];
+  int next[THREAD_CNT];
+  tid_t tids[THREAD_CNT];
+  size_t i;
+  int t;
+
+  CHECK (create ("test.txt", sizeof buf), "create \"test.txt\"");
+  CHECK ((f = fdopen (open ("test.txt"), "w")) != NULL,
+         "fdopen for writing");
+  for (t = 0; t < THREAD_CNT; t++)
+    {
+      ids[t] = t;
+      if ((tids[t] = thread_spawn (print_lines, &ids[t])) == TID_ERROR)
+        fail ("thread_spawn failed");
+    }
+  for (t = 0; t < THREAD_CNT; t++)
+    thread_join (tids[t]);
+  CHECK (fclose (f) == 0, "fclose");
+
+  CHECK ((f = fdopen (open ("test.txt"), "r")) != NULL,
+         "fdopen for reading");
+  CHECK (fread (buf, 1, sizeof buf, f) == sizeof buf, "fread");
+  for (t = 0; t < THREAD_CNT; t++)
+    next[t] = 0;
+  for (i = 0; i < sizeof buf; i += LINE_LEN)
+    {
+      char *line = buf + i;
+      t = line[0] - '0';
+      if (t < 0 || t >= THREAD_CNT || line[1] != ':' || line[4] != '\n'
+          || (line[2] - '0') * 10 + (line[3] - '0') != next[t]++)
+        fail ("bad line at offset %zu: \"%.*s\"", i, LINE_LEN - 1, line);
+    }
+  msg ("all lines intact");
+  CHECK (fclose (f) == 0, "fclose");
+}
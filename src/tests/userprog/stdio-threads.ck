@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(stdio-threads) begin
+(stdio-threads) create "test.txt"
+(stdio-threads) fdopen for writing
+(stdio-threads) fclose
+(stdio-threads) fdopen for reading
+(stdio-threads) fread
+(stdio-threads) all lines intact
+(stdio-threads) fclose
+(stdio-threads) end
+stdio-threads: exit(0)
+EOF
+pass;
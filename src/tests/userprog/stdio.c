@@ -0,0 +1,36 @@
+/* Writes "sample.txt"'s contents to a file through a buffered
+   stream in small pieces, then reads them back through another
+   stream and checks them. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[sizeof sample];
+  size_t size = sizeof sample - 1;
+  FILE *f;
+  size_t i;
+  int c;
+
+  CHECK (create ("test.txt", size), "create \"test.txt\"");
+  CHECK ((f = fdopen (open ("test.txt"), "w")) != NULL,
+         "fdopen for writing");
+  for (i = 0; i < size; i += 7)
+    fprintf (f, "%.*s", size - i < 7 ? (int) (size - i) : 7, sample + i);
+  CHECK (fclose (f) == 0, "fclose");
+
+  CHECK ((f = fdopen (open ("test.txt"), "r")) != NULL,
+         "fdopen for reading");
+  CHECK ((c = fgetc (f)) == sample[0], "fgetc");
+  buf[0] = c;
+  CHECK (fread (buf + 1, 1, sizeof buf, f) == size - 1, "fread");
+  CHECK (feof (f), "feof");
+  compare_bytes (buf, sample, size, 0, "test.txt");
+  CHECK (fclose (f) == 0, "fclose");
+}
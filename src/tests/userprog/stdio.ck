@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(stdio) begin
+(stdio) create "test.txt"
+(stdio) fdopen for writing
+(stdio) fclose
+(stdio) fdopen for reading
+(stdio) fgetc
+(stdio) fread
+(stdio) feof
+(stdio) fclose
+(stdio) end
+stdio: exit(0)
+EOF
+pass;
@@ -0,0 +1,66 @@
+/* Spawns several threads that sum parts of an array in shared
+   memory, using the heap and deep stacks as they go, and joins
+   them to collect the partial sums. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define ELEM_CNT 4096
+
+static int data[ELEM_CNT];
+
+/* Sums a quarter of DATA.  AUX points to the quarter's index. */
+static int
+sum_part (void *aux)
+{
+  int part = *(int *) aux;
+  char frame[32 * 1024];
+  int sum = 0;
+  int i;
+
+  /* Touch a stack well beyond its first page. */
+  memset (frame, part, sizeof frame);
+
+  for (i = 0; i < 64; i++)
+    free (malloc (i * 16 + 1));
+
+  for (i = part * (ELEM_CNT / THREAD_CNT);
+       i < (part + 1) * (ELEM_CNT / THREAD_CNT); i++)
+    sum += data[i];
+  return sum + frame[sizeof frame - 1] - part;
+}
+
+void
+test_main (void) 
+{
+  static int parts[THREAD_CNT];
+  tid_t tids[THREAD_CNT];
+  int expected = 0;
+  int total = 0;
+  int i;
+
+  for (i = 0; i < ELEM_CNT; i++)
+    {
+      data[i] = i;
+      expected += i;
+    }
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      parts[i] = i;
+      tids[i] = thread_spawn (sum_part, &parts[i]);
+      if (tids[i] == TID_ERROR)
+        fail ("thread_spawn failed");
+    }
+  msg ("spawned %d threads", THREAD_CNT);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    total += thread_join (tids[i]);
+  CHECK (total == expected, "sum is %d", total);
+  CHECK (thread_join (tids[0]) == -1, "second join fails");
+  CHECK (thread_join (-1) == -1, "join of bad tid fails");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-join) begin
+(thread-join) spawned 4 threads
+(thread-join) sum is 8386560
+(thread-join) second join fails
+(thread-join) join of bad tid fails
+(thread-join) end
+thread-join: exit(0)
+EOF
+pass;
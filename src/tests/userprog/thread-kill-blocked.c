@@ -0,0 +1,54 @@
+/* Spawns threads that block in the kernel, reading an empty pipe,
+   joining another thread and waiting for a child, then exits
+   from the main thread, which must end the whole process
+   anyway. */
+
+#include <syscall.h>
+#include <time.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int fds[2];
+static tid_t reader;
+static pid_t child;
+
+static int
+read_pipe (void *aux UNUSED)
+{
+  char c;
+
+  return read (fds[0], &c, 1);
+}
+
+static int
+join_reader (void *aux UNUSED)
+{
+  return thread_join (reader);
+}
+
+static int
+wait_child (void *aux UNUSED)
+{
+  return wait (child);
+}
+
+void
+test_main (void) 
+{
+  uint64_t start;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK ((child = exec ("child-wait 50")) != PID_ERROR,
+         "exec \"child-wait 50\"");
+  CHECK ((reader = thread_spawn (read_pipe, NULL)) != TID_ERROR,
+         "spawn thread reading pipe");
+  CHECK (thread_spawn (join_reader, NULL) != TID_ERROR,
+         "spawn thread joining it");
+  CHECK (thread_spawn (wait_child, NULL) != TID_ERROR,
+         "spawn thread waiting for child");
+
+  /* Give the threads time to block. */
+  start = clock_ns ();
+  while (clock_ns () - start < 100000000ULL)
+    continue;
+}
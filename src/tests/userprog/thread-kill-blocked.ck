@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-kill-blocked) begin
+(thread-kill-blocked) pipe
+(thread-kill-blocked) exec "child-wait 50"
+(thread-kill-blocked) spawn thread reading pipe
+(thread-kill-blocked) spawn thread joining it
+(thread-kill-blocked) spawn thread waiting for child
+(thread-kill-blocked) end
+thread-kill-blocked: exit(0)
+EOF
+pass;
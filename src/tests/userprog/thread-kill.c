@@ -0,0 +1,22 @@
+/* Spawns a thread that never stops running, then exits from the
+   main thread, which must end the whole process. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int
+spin (void *aux UNUSED)
+{
+  volatile int x = 0;
+
+  for (;;)
+    x++;
+  return 0;
+}
+
+void
+test_main (void) 
+{
+  CHECK (thread_spawn (spin, NULL) != TID_ERROR, "spawn spinning thread");
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-kill) begin
+(thread-kill) spawn spinning thread
+(thread-kill) end
+thread-kill: exit(0)
+EOF
+pass;
@@ -0,0 +1,37 @@
+/* Starts children that run for different times, and reaps them
+   with waitpid(WAIT_ANY) in the order they finish, which is the
+   reverse of the order they were started. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 3
+
+void
+test_main (void) 
+{
+  static const char *cmds[CHILD_CNT] =
+    {"child-wait 3", "child-wait 2", "child-wait 1"};
+  pid_t pids[CHILD_CNT];
+  int status;
+  pid_t pid;
+  int i;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    CHECK ((pids[i] = exec (cmds[i])) != PID_ERROR, "exec \"%s\"", cmds[i]);
+
+  CHECK (waitpid (WAIT_ANY, &status, WNOHANG) == 0,
+         "no child has exited yet");
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pid = waitpid (WAIT_ANY, &status, 0);
+      if (status < 1 || status > CHILD_CNT || pid != pids[CHILD_CNT - status])
+        fail ("waitpid returned pid %d with status %d", pid, status);
+      msg ("reaped child with status %d", status);
+    }
+
+  CHECK (waitpid (WAIT_ANY, &status, WNOHANG) == -1, "no children left");
+  CHECK (wait (pids[0]) == -1, "reaped child cannot be waited for");
+}
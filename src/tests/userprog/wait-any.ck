@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(wait-any) begin
+(wait-any) exec "child-wait 3"
+(wait-any) exec "child-wait 2"
+(wait-any) exec "child-wait 1"
+(wait-any) no child has exited yet
+(wait-any) reaped child with status 1
+(wait-any) reaped child with status 2
+(wait-any) reaped child with status 3
+(wait-any) no children left
+(wait-any) reaped child cannot be waited for
+(wait-any) end
+EOF
+pass;
@@ -0,0 +1,34 @@
+/* Starts a child from the main thread and reaps it from another
+   thread of the process, which shares the main thread's
+   children. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static pid_t child;
+
+/* Waits for CHILD and returns its exit status. */
+static int
+reap_child (void *aux UNUSED)
+{
+  int status;
+
+  if (waitpid (child, &status, 0) != child)
+    return -1;
+  return status;
+}
+
+void
+test_main (void) 
+{
+  tid_t tid;
+
+  CHECK ((child = exec ("child-wait 2")) != PID_ERROR,
+         "exec \"child-wait 2\"");
+  tid = thread_spawn (reap_child, NULL);
+  if (tid == TID_ERROR)
+    fail ("thread_spawn failed");
+  CHECK (thread_join (tid) == 2, "thread reaped child with status 2");
+  CHECK (wait (child) == -1, "reaped child cannot be waited for");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(wait-thread) begin
+(wait-thread) exec "child-wait 2"
+(wait-thread) thread reaped child with status 2
+(wait-thread) reaped child cannot be waited for
+(wait-thread) end
+EOF
+pass;
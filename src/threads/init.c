@@ -25,7 +25,11 @@
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
+#include "userprog/exec-cache.h"
+#include "userprog/futex.h"
+#include "userprog/fdtable.h"
 #include "userprog/gdt.h"
+#include "userprog/shm.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
 #else
@@ -33,6 +37,7 @@
 #endif
 #ifdef VM
 #include "devices/swap.h"
+#include "vm/ksm.h"
 #endif
 #ifdef FILESYS
 #include "devices/block.h"
@@ -44,6 +49,14 @@
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
 
+/* True if the CPU supports 4 MB pages and they are enabled. */
+bool init_large_pages;
+
+/* CR4 bits that enable the CPUID features in init.h.  See
+   [IA32-v3a] 2.5 "Control Registers". */
+#define CR4_PSE 0x00000010      /* Page Size Extension. */
+#define CR4_PGE 0x00000080      /* Page Global Enable. */
+
 #ifdef FILESYS
 /* -f: Format the file system? */
 static bool format_filesys;
@@ -57,6 +70,14 @@ static const char *swap_bdev_name;
 #endif
 #endif /* FILESYS */
 
+#ifdef VM
+/* -zswap: Maximum number of pages in the compressed swap pool. */
+static size_t swap_pool_pages = SWAP_POOL_PAGES;
+
+/* -swaptest: Run swap_self_test() during startup? */
+static bool swap_test;
+#endif
+
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
@@ -116,6 +137,10 @@ main (void)
 #ifdef USERPROG
   exception_init ();
   syscall_init ();
+  process_init ();
+  exec_cache_init ();
+  futex_init ();
+  shm_init ();
 #endif
 
   /* Start thread scheduler and enable interrupts. */
@@ -132,7 +157,12 @@ main (void)
 
 #ifdef VM
   /* Initialise the swap disk */  
-  swap_init ();
+  swap_init (swap_pool_pages);
+  if (swap_test)
+    swap_self_test ();
+
+  /* Start merging identical user pages. */
+  ksm_init ();
 #endif
 
   printf ("Boot complete.\n");
@@ -158,16 +188,47 @@ bss_init (void)
   memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* Returns the feature flags that CPUID leaf 1 reports in EDX. */
+uint32_t
+cpu_features (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+  asm volatile ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return edx;
+}
+
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports it, each 4 MB chunk of RAM that is entirely
+   present and holds no kernel text is mapped with a single large
+   page, which needs no page table and only one TLB entry.  The
+   kernel mapping is also marked global where possible, so that
+   its TLB entries survive switches between page directories. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
   extern char _start, _end_kernel_text;
+  uint32_t features = cpu_features ();
+  uint32_t global = 0;
+  uint32_t cr4;
+
+  asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+  if (features & CPUID_PSE)
+    {
+      cr4 |= CR4_PSE;
+      init_large_pages = true;
+    }
+  if (features & CPUID_PGE)
+    {
+      cr4 |= CR4_PGE;
+      global = PTE_G;
+    }
+  asm volatile ("movl %0, %%cr4" : : "r" (cr4));
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
@@ -179,13 +240,22 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      if (init_large_pages && pte_idx == 0
+          && page + PTSPAN / PGSIZE <= init_ram_pages
+          && (vaddr + PTSPAN <= &_start || vaddr >= &_end_kernel_text))
+        {
+          pd[pde_idx] = pde_create_large (vaddr, false, true) | global;
+          page += PTSPAN / PGSIZE - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
           pd[pde_idx] = pde_create (pt);
         }
 
-      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
+      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text) | global;
     }
 
   /* Store the physical address of the page directory into CR3
@@ -259,6 +329,12 @@ parse_options (char **argv)
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
 #endif
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-zswap"))
+        swap_pool_pages = atoi (value);
+      else if (!strcmp (name, "-swaptest"))
+        swap_test = true;
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
@@ -267,6 +343,14 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+      else if (!strcmp (name, "-fdlimit"))
+        fd_limit_default = atoi (value);
+      else if (!strcmp (name, "-rsslimit"))
+        rss_limit_default = atoi (value);
+      else if (!strcmp (name, "-kmemlimit"))
+        kmem_limit_default = atoi (value);
+      else if (!strcmp (name, "-oomkill"))
+        oom_kill = true;
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -389,6 +473,14 @@ usage (void)
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+          "  -fdlimit=COUNT     Limit new processes to COUNT file descriptors.\n"
+          "  -rsslimit=COUNT    Limit processes to COUNT pages of user memory.\n"
+          "  -kmemlimit=COUNT   Limit processes to COUNT pages of kernel memory.\n"
+          "  -oomkill           Kill the biggest process when memory runs out.\n"
+#endif
+#ifdef VM
+          "  -zswap=COUNT       Compress up to COUNT pages of swap in memory.\n"
+          "  -swaptest          Test swap during startup.\n"
 #endif
           );
   shutdown_power_off ();
@@ -9,4 +9,14 @@
 /* Page directory with kernel mappings only. */
 extern uint32_t *init_page_dir;
 
+/* True if the CPU supports 4 MB pages and they are enabled. */
+extern bool init_large_pages;
+
+/* CPUID leaf 1 feature flags in EDX.  See [IA32-v2a] "CPUID". */
+#define CPUID_PSE 0x00000008    /* Page Size Extension. */
+#define CPUID_SEP 0x00000800    /* SYSENTER and SYSEXIT. */
+#define CPUID_PGE 0x00002000    /* Page Global Enable. */
+
+uint32_t cpu_features (void);
+
 #endif /* threads/init.h */
@@ -9,6 +9,10 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/process.h"
+#endif
 
 /* Programmable Interrupt Controller (PIC) registers.
    A PC has two PICs, called the master and slave PICs, with the
@@ -386,6 +390,13 @@ intr_handler (struct intr_frame *frame)
       if (yield_on_return) 
         thread_yield (); 
     }
+
+#ifdef USERPROG
+  /* A thread whose process is exiting dies instead of returning
+     to user mode. */
+  if (frame->cs == SEL_UCSEG)
+    process_check_exit ();
+#endif
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
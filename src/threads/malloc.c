@@ -153,6 +153,23 @@ malloc (size_t size)
   return b;
 }
 
+/* Returns the number of bytes of memory that malloc(SIZE) takes:
+   the size of the block it hands out, or of the pages it
+   allocates for a request too big for any block. */
+size_t
+malloc_size (size_t size) 
+{
+  struct desc *d;
+
+  if (size == 0)
+    return 0;
+
+  for (d = descs; d < descs + desc_cnt; d++)
+    if (d->block_size >= size)
+      return d->block_size;
+  return DIV_ROUND_UP (size + sizeof (struct arena), PGSIZE) * PGSIZE;
+}
+
 /* Allocates and return A times B bytes initialized to zeroes.
    Returns a null pointer if memory is not available. */
 void *
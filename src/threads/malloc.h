@@ -6,6 +6,7 @@
 
 void malloc_init (void);
 void *malloc (size_t) __attribute__ ((malloc));
+size_t malloc_size (size_t);
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
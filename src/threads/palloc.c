@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -23,13 +24,22 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Every allocated page carries a reference count, which starts at
+   1.  palloc_ref_page() lets the same page be shared, for example
+   by several page directories, and freeing a page only returns it
+   to its pool once the last reference is dropped.  Reference
+   counts are updated with interrupts off, rather than under the
+   pool lock, because thread_schedule_tail() frees pages from
+   inside the scheduler. */
 
 /* A memory pool. */
 struct pool
   {
     struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
+    uint16_t *ref_cnt;                  /* References to each page. */
     uint8_t *base;                      /* Base of pool. */
   };
 
@@ -39,6 +49,10 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static struct pool *pool_of_page (void *page);
+static void drop_ref (struct pool *, size_t page_idx);
+static size_t scan_aligned (struct pool *, size_t page_cnt,
+                            size_t align_cnt);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -69,16 +83,30 @@ palloc_init (size_t user_page_limit)
    FLAGS, in which case the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
+{
+  return palloc_get_aligned (flags, page_cnt, 1);
+}
+
+/* Like palloc_get_multiple(), but the physical address of the
+   first page returned is a multiple of ALIGN_CNT pages, as needed
+   to map the pages with a single large page. */
+void *
+palloc_get_aligned (enum palloc_flags flags, size_t page_cnt,
+                    size_t align_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
   void *pages;
   size_t page_idx;
 
+  ASSERT (align_cnt > 0);
   if (page_cnt == 0)
     return NULL;
 
   lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+  if (align_cnt == 1)
+    page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+  else
+    page_idx = scan_aligned (pool, page_cnt, align_cnt);
   lock_release (&pool->lock);
 
   if (page_idx != BITMAP_ERROR)
@@ -88,6 +116,9 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 
   if (pages != NULL) 
     {
+      size_t i;
+      for (i = 0; i < page_cnt; i++)
+        pool->ref_cnt[page_idx + i] = 1;
       if (flags & PAL_ZERO)
         memset (pages, 0, PGSIZE * page_cnt);
     }
@@ -113,32 +144,48 @@ palloc_get_page (enum palloc_flags flags)
   return palloc_get_multiple (flags, 1);
 }
 
-/* Frees the PAGE_CNT pages starting at PAGES. */
+/* Drops a reference to each of the PAGE_CNT pages starting at
+   PAGES, freeing the pages that are no longer referenced. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
   size_t page_idx;
+  enum intr_level old_level;
+  size_t i;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
     return;
 
-  if (page_from_pool (&kernel_pool, pages))
-    pool = &kernel_pool;
-  else if (page_from_pool (&user_pool, pages))
-    pool = &user_pool;
-  else
-    NOT_REACHED ();
-
+  pool = pool_of_page (pages);
   page_idx = pg_no (pages) - pg_no (pool->base);
 
-#ifndef NDEBUG
-  memset (pages, 0xcc, PGSIZE * page_cnt);
-#endif
+  old_level = intr_disable ();
+  for (i = 0; i < page_cnt; i++)
+    drop_ref (pool, page_idx + i);
+  intr_set_level (old_level);
+}
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+/* Drops a reference to each of the PAGE_CNT single pages in
+   PAGES, which may come from either pool, freeing the pages that
+   are no longer referenced.  Cheaper than freeing them one at a
+   time, since interrupts are turned off only once. */
+void
+palloc_free_pages (void **pages, size_t page_cnt) 
+{
+  enum intr_level old_level;
+  size_t i;
+
+  old_level = intr_disable ();
+  for (i = 0; i < page_cnt; i++)
+    {
+      struct pool *pool = pool_of_page (pages[i]);
+
+      ASSERT (pg_ofs (pages[i]) == 0);
+      drop_ref (pool, pg_no (pages[i]) - pg_no (pool->base));
+    }
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,15 +195,51 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Takes an extra reference to PAGE, which must be allocated and
+   have fewer than PALLOC_REFS_MAX references.  The page is freed
+   only after palloc_free_page() has been called once more for
+   each extra reference. */
+void
+palloc_ref_page (void *page) 
+{
+  struct pool *pool = pool_of_page (page);
+  size_t page_idx = pg_no (page) - pg_no (pool->base);
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  ASSERT (pool->ref_cnt[page_idx] > 0);
+  ASSERT (pool->ref_cnt[page_idx] < PALLOC_REFS_MAX);
+  pool->ref_cnt[page_idx]++;
+  intr_set_level (old_level);
+}
+
+/* Returns the number of references to PAGE, which must be
+   allocated. */
+unsigned
+palloc_page_refs (void *page) 
+{
+  struct pool *pool = pool_of_page (page);
+  return pool->ref_cnt[pg_no (page) - pg_no (pool->base)];
+}
+
+/* Returns true if PAGE was allocated from the user pool. */
+bool
+palloc_is_user_page (void *page) 
+{
+  return page_from_pool (&user_pool, page);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's used_map at its base, followed by the
+     reference counts.  Calculate the space needed for both
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (bm_size + page_cnt * sizeof *p->ref_cnt,
+                                  PGSIZE);
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -165,7 +248,8 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
 
   /* Initialize the pool. */
   lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->ref_cnt = (uint16_t *) ((uint8_t *) base + bm_size);
   p->base = base + bm_pages * PGSIZE;
 }
 
@@ -180,3 +264,53 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Drops a reference to page PAGE_IDX in POOL, freeing the page
+   if it was the last.  Interrupts must be off. */
+static void
+drop_ref (struct pool *pool, size_t page_idx) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (pool->ref_cnt[page_idx] > 0);
+  if (--pool->ref_cnt[page_idx] > 0)
+    return;
+
+#ifndef NDEBUG
+  memset (pool->base + PGSIZE * page_idx, 0xcc, PGSIZE);
+#endif
+
+  ASSERT (bitmap_test (pool->used_map, page_idx));
+  bitmap_reset (pool->used_map, page_idx);
+}
+
+/* Returns the pool that PAGE was allocated from. */
+static struct pool *
+pool_of_page (void *page) 
+{
+  if (page_from_pool (&kernel_pool, page))
+    return &kernel_pool;
+  else if (page_from_pool (&user_pool, page))
+    return &user_pool;
+  else
+    NOT_REACHED ();
+}
+
+/* Finds PAGE_CNT free pages in POOL whose first page's physical
+   address is a multiple of ALIGN_CNT pages, marks them used and
+   returns the index of the first one.  Returns BITMAP_ERROR if
+   there are none.  POOL's lock must be held. */
+static size_t
+scan_aligned (struct pool *pool, size_t page_cnt, size_t align_cnt) 
+{
+  size_t pool_cnt = bitmap_size (pool->used_map);
+  size_t page_idx;
+
+  for (page_idx = (align_cnt - pg_no (pool->base) % align_cnt) % align_cnt;
+       page_idx + page_cnt <= pool_cnt; page_idx += align_cnt)
+    if (bitmap_none (pool->used_map, page_idx, page_cnt))
+      {
+        bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+        return page_idx;
+      }
+  return BITMAP_ERROR;
+}
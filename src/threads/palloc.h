@@ -1,7 +1,12 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+
+/* Most references a page may have. */
+#define PALLOC_REFS_MAX UINT16_MAX
 
 /* How to allocate pages. */
 enum palloc_flags
@@ -14,7 +19,13 @@ enum palloc_flags
 void palloc_init (size_t user_page_limit);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
+void *palloc_get_aligned (enum palloc_flags, size_t page_cnt,
+                          size_t align_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_free_pages (void **pages, size_t page_cnt);
+void palloc_ref_page (void *);
+unsigned palloc_page_refs (void *);
+bool palloc_is_user_page (void *);
 
 #endif /* threads/palloc.h */
@@ -66,6 +66,10 @@ static inline uintptr_t pd_no (const void *va) {
 #define PTE_U 0x4               /* 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20              /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40              /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80             /* 1=4 MB page (PDEs only, needs CR4.PSE). */
+#define PTE_G 0x100             /* 1=global, kept in TLB across CR3 loads. */
+#define PTE_COW 0x200           /* 1=copy-on-write (PTE_AVL, PTEs only). */
+#define PTE_SHARED 0x400        /* 1=shared memory (PTE_AVL, PTEs only). */
 
 /* Returns a PDE that points to page table PT. */
 static inline uint32_t pde_create (uint32_t *pt) {
@@ -77,9 +81,28 @@ static inline uint32_t pde_create (uint32_t *pt) {
    PDE, which must "present", points to. */
 static inline uint32_t *pde_get_pt (uint32_t pde) {
   ASSERT (pde & PTE_P);
+  ASSERT (!(pde & PTE_PS));
   return ptov (pde & PTE_ADDR);
 }
 
+/* Returns a PDE that maps the 4 MB page at PAGE, which must be
+   aligned to a 4 MB physical boundary, directly without a page
+   table.  The page is writable if WRITABLE is true, and usable by
+   user code if USER is true. */
+static inline uint32_t pde_create_large (void *page, bool user,
+                                         bool writable) {
+  ASSERT ((vtop (page) & (PTSPAN - 1)) == 0);
+  return (vtop (page) | PTE_PS | PTE_P
+          | (user ? PTE_U : 0) | (writable ? PTE_W : 0));
+}
+
+/* Returns a pointer to the 4 MB page that large-page PDE points
+   to. */
+static inline void *pde_get_page (uint32_t pde) {
+  ASSERT ((pde & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS));
+  return ptov (pde & ~(uint32_t) (PTSPAN - 1));
+}
+
 /* Returns a PTE that points to PAGE.
    The PTE's page is readable.
    If WRITABLE is true then it will be writable as well.
@@ -112,6 +112,53 @@ sema_try_down (struct semaphore *sema)
   return success;
 }
 
+/* Down or "P" operation on a semaphore, like sema_down(), except
+   that it gives up without decrementing SEMA if *CANCEL is true,
+   or becomes true while the thread waits and sema_cancel_wait()
+   wakes it.  CANCEL may be a null pointer, for a wait that is
+   never cancelled.  Returns true if SEMA was decremented. */
+bool
+sema_down_unless (struct semaphore *sema, const volatile bool *cancel)
+{
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (sema != NULL);
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  while (sema->value == 0 && (cancel == NULL || !*cancel))
+    {
+      list_push_back (&sema->waiters, &t->elem);
+      t->wait_sema = sema;
+      thread_block ();
+      t->wait_sema = NULL;
+    }
+  success = sema->value > 0;
+  if (success)
+    sema->value--;
+  intr_set_level (old_level);
+
+  return success;
+}
+
+/* Wakes up T if it is waiting in sema_down_unless(), so that it
+   checks whether its wait has been cancelled.  Needs no lock, so
+   it may be called in any context, but interrupts must be off. */
+void
+sema_cancel_wait (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->wait_sema != NULL && t->status == THREAD_BLOCKED)
+    {
+      list_remove (&t->elem);
+      t->wait_sema = NULL;
+      thread_unblock (t);
+    }
+}
+
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
    and wakes up one thread of those waiting for SEMA, if any.
 
@@ -374,6 +421,42 @@ cond_wait (struct condition *cond, struct lock *lock)
   lock_acquire (lock);
 }
 
+/* Waits on COND like cond_wait(), except that it gives up waiting
+   if *CANCEL is true, or becomes true while the thread waits and
+   sema_cancel_wait() wakes it, as in sema_down_unless().  LOCK is
+   held again on return either way.  Returns true if COND was
+   signaled. */
+bool
+cond_wait_unless (struct condition *cond, struct lock *lock,
+                  const volatile bool *cancel)
+{
+  struct semaphore_elem waiter;
+  bool signaled;
+
+  ASSERT (cond != NULL);
+  ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (lock_held_by_current_thread (lock));
+
+  sema_init (&waiter.semaphore, 0);
+  waiter.priority = &thread_current ()->priority;
+  list_push_back (&cond->waiters, &waiter.elem);
+  lock_release (lock);
+  signaled = sema_down_unless (&waiter.semaphore, cancel);
+  lock_acquire (lock);
+
+  /* A signal that came after the wait gave up has taken WAITER
+     off COND's list already.  Otherwise, take it off here. */
+  if (!signaled)
+    {
+      if (waiter.semaphore.value > 0)
+        signaled = true;
+      else
+        list_remove (&waiter.elem);
+    }
+  return signaled;
+}
+
 /* If any threads are waiting on COND (protected by LOCK), then
    this function signals one of them to wake up from its wait.
    LOCK must be held before calling this function.
@@ -6,6 +6,8 @@
 
 #define MAX_NESTED_DONATION_LAYERS (8)
 
+struct thread;
+
 /* A counting semaphore. */
 struct semaphore 
   {
@@ -16,7 +18,9 @@ struct semaphore
 void sema_init (struct semaphore *, unsigned value);
 void sema_down (struct semaphore *);
 bool sema_try_down (struct semaphore *);
+bool sema_down_unless (struct semaphore *, const volatile bool *cancel);
 void sema_up (struct semaphore *);
+void sema_cancel_wait (struct thread *);
 void sema_self_test (void);
 
 /* Lock. */
@@ -42,6 +46,8 @@ struct condition
 
 void cond_init (struct condition *);
 void cond_wait (struct condition *, struct lock *);
+bool cond_wait_unless (struct condition *, struct lock *,
+                       const volatile bool *cancel);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
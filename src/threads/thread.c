@@ -164,23 +164,33 @@ threads_ready_or_running (void)
   return total;
 }
 
-/* Called by the timer interrupt handler at each timer tick.
-   Thus, this function runs in an external interrupt context. */
+/* Called by the timer interrupt handler at each timer tick, with
+   USER true if the tick interrupted user code.  Thus, this
+   function runs in an external interrupt context. */
 void
-thread_tick (void)
+thread_tick (bool user)
 {
   struct thread *t = thread_current ();
 
+#ifdef USERPROG
+  /* Charge the tick to the thread, if it runs for a process. */
+  if (t->proc != NULL)
+    {
+      if (user)
+        t->usage.user_ticks++;
+      else
+        t->usage.sys_ticks++;
+    }
+#endif
+
   /* Update statistics. */
   if (t == idle_thread)
     {
       idle_ticks++;
     }
 
-#ifdef USERPROG
-  else if (t->pagedir != NULL)
+  else if (user)
     user_ticks++;
-#endif
   /* If not idle thread. */
   else 
     {
@@ -707,13 +717,12 @@ init_thread (struct thread *t, const char *name, int priority,
   t->base_priority = priority;
   t->magic = THREAD_MAGIC;
   t->lock = NULL;
+  t->wait_sema = NULL;
   list_init (&t->locks);
 
 #ifdef USERPROG
-  t->next_fd = 2; /* Skips STDIN and STDOUT. */
-  t->process = NULL;
-  list_init (&t->files);
-  list_init (&t->children);
+  t->proc = NULL;
+  t->fd_table = NULL;
 #endif
 
   if (thread_mlfqs)
@@ -835,7 +844,15 @@ schedule (void)
   ASSERT (is_thread (next));
 
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+#ifdef USERPROG
+      if (cur->status == THREAD_BLOCKED)
+        cur->usage.vol_switches++;
+      else if (cur->status == THREAD_READY)
+        cur->usage.invol_switches++;
+#endif
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
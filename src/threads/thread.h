@@ -4,6 +4,7 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include "threads/synch.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -22,6 +23,21 @@ typedef int32_t fp;
 typedef int tid_t;
 #define TID_ERROR ((tid_t) - 1)         /* Error value for tid_t. */
 
+/* Resources used by a thread, or by a number of threads added
+   together.  Reported by getrusage(). */
+struct usage
+  {
+    long long user_ticks;       /* Timer ticks spent in user mode. */
+    long long sys_ticks;        /* Timer ticks spent in the kernel. */
+    long long vol_switches;     /* Times the thread blocked. */
+    long long invol_switches;   /* Times it was preempted. */
+    long long min_flt;          /* Page faults serviced without I/O. */
+    long long maj_flt;          /* Page faults that needed I/O. */
+    long long read_bytes;       /* Bytes read by system calls. */
+    long long write_bytes;      /* Bytes written by system calls. */
+    long long syscalls;         /* System calls made. */
+  };
+
 /* Thread priorities. */
 #define PRI_MIN 0                       /* Lowest priority. */
 #define PRI_DEFAULT 31                  /* Default priority. */
@@ -102,15 +118,24 @@ struct thread
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
+    struct semaphore *wait_sema;        /* Waited on in sema_down_unless(). */
+
+    /* Owned by devices/block.c. */
+    unsigned long long sectors_read;    /* Sectors read by block_read(). */
 
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
-    void *process;                      /* For passing data to parent. */
-    struct list children;               /* Child threads. */
-    int next_fd;                        /* Next file descriptor. */
-    struct list files;                  /* List of opened files. */
-    struct file *exec_file;             /* Executable file running on this process. */
+    struct proc *proc;                  /* Process this thread belongs to. */
+    struct fd_table *fd_table;          /* Open file descriptors. */
+    struct usage usage;                 /* Resources used so far. */
+    void *user_esp;                     /* User esp on entry to a syscall. */
+#endif
+
+#ifdef VM
+    /* Owned by vm/ksm.c. */
+    bool ksm_scanned;                   /* On ksm's list of processes? */
+    struct list_elem ksm_elem;          /* List element for ksm. */
 #endif
 
     /* Owned by thread.c. */
@@ -126,7 +151,7 @@ void thread_init (void);
 void thread_start (void);
 size_t threads_ready (void);
 
-void thread_tick (void);
+void thread_tick (bool user);
 void thread_print_stats (void);
 
 typedef void thread_func (void *aux);
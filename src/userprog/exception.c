@@ -2,11 +2,40 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "userprog/syscall.h"
+#include "userprog/uaccess.h"
+#include "devices/timer.h"
+#include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
 
-/* Number of page faults processed. */
-static long long page_fault_cnt;
+/* Page fault statistics. */
+static long long page_fault_cnt;        /* Page faults processed. */
+static long long minor_fault_cnt;       /* Serviced without I/O. */
+static long long major_fault_cnt;       /* Serviced with I/O. */
+static long long cow_fault_cnt;         /* Copy-on-write breaks. */
+static long long stack_fault_cnt;       /* Stack growth. */
+static long long heap_fault_cnt;        /* Heap pages mapped. */
+
+/* Histogram of the time taken to service page faults.  Bucket I
+   counts faults that took between 2**I and 2**(I+1) - 1 CPU
+   cycles. */
+#define FAULT_TIME_BUCKETS 32
+static long long fault_time_hist[FAULT_TIME_BUCKETS];
+
+#ifdef VM
+/* Largest size the user stack may grow to. */
+#define STACK_MAX (8 * 1024 * 1024)
+
+static bool grow_stack (void *fault_addr, void *esp);
+#endif
+static bool map_heap_page (void *fault_addr);
+static bool map_thread_stack_page (void *fault_addr);
+static void account_fault (uint64_t start,
+                           unsigned long long sectors_read);
 
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
@@ -61,7 +90,16 @@ exception_init (void)
 void
 exception_print_stats (void) 
 {
-  printf ("Exception: %lld page faults\n", page_fault_cnt);
+  int i;
+
+  printf ("Exception: %lld page faults (%lld minor, %lld major, "
+          "%lld COW, %lld stack growth, %lld heap)\n",
+          page_fault_cnt, minor_fault_cnt, major_fault_cnt,
+          cow_fault_cnt, stack_fault_cnt, heap_fault_cnt);
+  for (i = 0; i < FAULT_TIME_BUCKETS; i++)
+    if (fault_time_hist[i] != 0)
+      printf ("Exception: %lld faults took %llu-%llu cycles\n",
+              fault_time_hist[i], 1ULL << i, (2ULL << i) - 1);
 }
 
 /* Handler for an exception (probably) caused by a user process. */
@@ -86,10 +124,19 @@ kill (struct intr_frame *f)
       printf ("%s: dying due to interrupt %#04x (%s).\n",
               thread_name (), f->vec_no, intr_name (f->vec_no));
       intr_dump_frame (f);
-      thread_exit ();
+      process_terminate (-1);
       break;
 
     case SEL_KCSEG:
+      /* SYSENTER leaves the trap flag set, so a user process
+         that single-steps into it traps on the first instruction
+         of sysenter_entry.  Let it go on without the flag. */
+      if (f->vec_no == 1 && f->eip == sysenter_entry)
+        {
+          f->eflags &= ~FLAG_TF;
+          return;
+        }
+
       /* Kernel's code segment, which indicates a kernel bug.
          Kernel code shouldn't throw exceptions.  (Page faults
          may cause kernel exceptions--but they shouldn't arrive
@@ -124,6 +171,8 @@ page_fault (struct intr_frame *f)
   bool write;        /* True: access was write, false: access was read. */
   bool user;         /* True: access by user, false: access by kernel. */
   void *fault_addr;  /* Fault address. */
+  uint64_t start = timer_cycles ();
+  unsigned long long sectors_read = thread_current ()->sectors_read;
 
   /* Obtain faulting address, the virtual address that was
      accessed to cause the fault.  It may point to code or to
@@ -146,6 +195,57 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+  /* A write to a present copy-on-write page, from the user
+     program or from the kernel on its behalf, gets a private
+     copy of the page and is then restarted. */
+  if (!not_present && write && is_user_vaddr (fault_addr)
+      && thread_current ()->pagedir != NULL
+      && pagedir_break_cow (thread_current ()->pagedir,
+                            pg_round_down (fault_addr)))
+    {
+      cow_fault_cnt++;
+      account_fault (start, sectors_read);
+      return;
+    }
+
+#ifdef VM
+  /* An access just below the user stack grows the stack.  The
+     kernel may make such an access on the process's behalf in a
+     system call, so use the user's stack pointer in that case. */
+  if (not_present && is_user_vaddr (fault_addr)
+      && grow_stack (fault_addr,
+                     user ? f->esp : thread_current ()->user_esp))
+    {
+      stack_fault_cnt++;
+      account_fault (start, sectors_read);
+      return;
+    }
+#endif
+
+  /* The first access to a heap page, again possibly by the
+     kernel, maps a zeroed page there. */
+  if (not_present && is_user_vaddr (fault_addr)
+      && map_heap_page (fault_addr))
+    {
+      heap_fault_cnt++;
+      account_fault (start, sectors_read);
+      return;
+    }
+
+  /* Likewise for the stacks of threads the process spawned. */
+  if (not_present && is_user_vaddr (fault_addr)
+      && map_thread_stack_page (fault_addr))
+    {
+      stack_fault_cnt++;
+      account_fault (start, sectors_read);
+      return;
+    }
+
+  /* A fault in the kernel's user memory accessors is reported to
+     their caller as an error. */
+  if (!user && uaccess_fixup (f))
+    return;
+
   /* To implement virtual memory, delete the rest of the function
      body, and replace it with code that brings in the page to
      which fault_addr refers. */
@@ -157,3 +257,84 @@ page_fault (struct intr_frame *f)
   kill (f);
 }
 
+#ifdef VM
+/* Maps a zeroed page at FAULT_ADDR in the current process, if
+   the address is a plausible user stack access with stack
+   pointer ESP: within STACK_MAX of the top of user memory, and
+   no more than 32 bytes below ESP, which is as far as PUSHA
+   reaches.  Returns true if successful. */
+static bool
+grow_stack (void *fault_addr, void *esp)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+
+  if (pd == NULL || esp == NULL || fault_addr < PHYS_BASE - STACK_MAX
+      || fault_addr + 32 < esp)
+    return false;
+
+  return process_map_page (pg_round_down (fault_addr));
+}
+#endif
+
+/* Maps a zeroed page at FAULT_ADDR in the current process, if
+   the address lies in its heap, between the end of its loaded
+   segments and its break.  Returns true if successful. */
+static bool
+map_heap_page (void *fault_addr)
+{
+  struct thread *t = thread_current ();
+
+  if (t->pagedir == NULL || (uint8_t *) fault_addr < t->proc->heap_start
+      || (uint8_t *) fault_addr >= t->proc->heap_brk)
+    return false;
+
+  return process_map_page (pg_round_down (fault_addr));
+}
+
+/* Maps a zeroed page at FAULT_ADDR in the current process, if
+   the address lies in the stack of a thread of the process other
+   than its lowest, guard page.  Returns true if successful. */
+static bool
+map_thread_stack_page (void *fault_addr)
+{
+  struct thread *t = thread_current ();
+  uint8_t *addr = fault_addr;
+  int slot = thread_stack_slot (fault_addr);
+
+  if (t->pagedir == NULL || slot < 0
+      || (t->proc->stack_slots & (1ULL << slot)) == 0
+      || addr < THREAD_STACKS_TOP - (slot + 1) * THREAD_STACK_SIZE + PGSIZE)
+    return false;
+
+  return process_map_page (pg_round_down (fault_addr));
+}
+
+/* Accounts for a page fault whose service began at cycle START,
+   when the current thread had read SECTORS_READ sectors.  The
+   fault was major if servicing it read from a block device, such
+   as a file system or swap disk, or minor otherwise. */
+static void
+account_fault (uint64_t start, unsigned long long sectors_read)
+{
+  struct thread *t = thread_current ();
+  uint64_t cycles = timer_cycles () - start;
+  int bucket = 0;
+
+  if (t->sectors_read != sectors_read)
+    {
+      major_fault_cnt++;
+      t->usage.maj_flt++;
+    }
+  else
+    {
+      minor_fault_cnt++;
+      t->usage.min_flt++;
+    }
+
+  while (cycles > 1 && bucket < FAULT_TIME_BUCKETS - 1)
+    {
+      cycles >>= 1;
+      bucket++;
+    }
+  fault_time_hist[bucket]++;
+}
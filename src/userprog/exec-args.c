@@ -0,0 +1,193 @@
+#include "userprog/exec-args.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "userprog/uaccess.h"
+
+/* Size of an exec_args buffer. */
+#define BUF_SIZE (EXEC_ARGS_PAGES * PGSIZE)
+
+/* Returns the end of the offset table of ARGS.  The offset of
+   string I is at index -1 - I. */
+static uint16_t *
+offsets (const struct exec_args *args)
+{
+  return (uint16_t *) (args->buf + BUF_SIZE);
+}
+
+/* Returns the bytes free between the strings of ARGS and its
+   offset table. */
+static size_t
+room (const struct exec_args *args)
+{
+  return BUF_SIZE - args->len - args->argc * sizeof (uint16_t);
+}
+
+/* Starts a new string at the end of the strings of ARGS. */
+static void
+start_string (struct exec_args *args)
+{
+  offsets (args)[-1 - args->argc++] = args->len;
+}
+
+/* Initializes ARGS to hold no arguments.  Returns false if memory
+   is short. */
+bool
+exec_args_init (struct exec_args *args)
+{
+  args->buf = palloc_get_multiple (0, EXEC_ARGS_PAGES);
+  args->len = 0;
+  args->argc = 0;
+  return args->buf != NULL;
+}
+
+/* Frees the memory held by ARGS. */
+void
+exec_args_destroy (struct exec_args *args)
+{
+  palloc_free_multiple (args->buf, EXEC_ARGS_PAGES);
+  args->buf = NULL;
+}
+
+/* Appends the words of CMD_LINE to ARGS in a single pass.  Words
+   are separated by spaces or tabs.  Within single or double
+   quotes, spaces, tabs and the other kind of quote are part of
+   the word, and the quotes themselves are dropped, so that ""
+   is an empty word.  A quote that is not closed extends to the
+   end of CMD_LINE.  CMD_LINE must be in kernel memory; copy a
+   user command line in first, since another thread may change it
+   while it is parsed.  Returns false if the words do not fit. */
+bool
+exec_args_parse (struct exec_args *args, const char *cmd_line)
+{
+  const char *p;
+  bool in_word = false;
+  char quote = '\0';
+
+  for (p = cmd_line; ; p++)
+    {
+      char c = *p;
+
+      if (c == '\0' || (quote == '\0' && (c == ' ' || c == '\t')))
+        {
+          /* A string always has room left for its null. */
+          if (in_word)
+            args->buf[args->len++] = '\0';
+          in_word = false;
+          if (c == '\0')
+            return true;
+          continue;
+        }
+
+      if (!in_word)
+        {
+          if (room (args) < sizeof (uint16_t) + 1)
+            return false;
+          start_string (args);
+          in_word = true;
+        }
+      if (quote == '\0' && (c == '"' || c == '\''))
+        quote = c;
+      else if (c == quote)
+        quote = '\0';
+      else
+        {
+          if (room (args) < 2)
+            return false;
+          args->buf[args->len++] = c;
+        }
+    }
+}
+
+/* Appends string S to ARGS as it is.  Returns false if it does
+   not fit. */
+bool
+exec_args_add (struct exec_args *args, const char *s)
+{
+  size_t size = strlen (s) + 1;
+
+  if (room (args) < sizeof (uint16_t) + size)
+    return false;
+  start_string (args);
+  memcpy (args->buf + args->len, s, size);
+  args->len += size;
+  return true;
+}
+
+/* Appends the strings in the null-terminated array at user
+   address UARGV to ARGS.  Returns 1 if successful, 0 if they do
+   not fit, or -1 if UARGV or one of the strings is not valid
+   user memory. */
+int
+exec_args_from_user (struct exec_args *args, char *const *uargv)
+{
+  for (;; uargv++)
+    {
+      const char *uarg;
+      size_t max;
+      int len;
+
+      if (!copy_from_user (&uarg, uargv, sizeof uarg))
+        return -1;
+      if (uarg == NULL)
+        return 1;
+      if (room (args) < sizeof (uint16_t) + 1)
+        return 0;
+
+      /* A string that fills all the room may have been cut short,
+         so it does not count as fitting. */
+      max = room (args) - sizeof (uint16_t);
+      len = strncpy_from_user (args->buf + args->len, uarg, max);
+      if (len < 0)
+        return -1;
+      if ((size_t) len + 1 >= max)
+        return 0;
+      start_string (args);
+      args->len += len + 1;
+    }
+}
+
+/* Returns argument I of ARGS. */
+const char *
+exec_args_get (const struct exec_args *args, int i)
+{
+  ASSERT (i >= 0 && i < args->argc);
+  return args->buf + offsets (args)[-1 - i];
+}
+
+/* Returns the bytes of stack that exec_args_write() uses. */
+size_t
+exec_args_stack_size (const struct exec_args *args)
+{
+  return ROUND_UP (args->len, sizeof (char *))
+         + (args->argc + 4) * sizeof (char *);
+}
+
+/* Writes ARGS below TOP, the word-aligned top of a user stack, in
+   the layout main() expects: the strings, then argv[] ending in a
+   null pointer, then argv, argc and a null return address.  The
+   exec_args_stack_size() bytes below TOP must be mapped.  Returns
+   the new stack pointer. */
+void *
+exec_args_write (const struct exec_args *args, void *top)
+{
+  char *strs = (char *) top - args->len;
+  char **argv = (char **) ((uintptr_t) strs & ~(sizeof (char *) - 1))
+                - (args->argc + 1);
+  uint32_t *sp = (uint32_t *) argv - 3;
+  const uint16_t *ofs = offsets (args);
+  int i;
+
+  memcpy (strs, args->buf, args->len);
+  for (i = 0; i < args->argc; i++)
+    argv[i] = strs + ofs[-1 - i];
+  memset (argv + args->argc, 0, strs - (char *) (argv + args->argc));
+
+  sp[0] = 0;
+  sp[1] = args->argc;
+  sp[2] = (uint32_t) argv;
+  return sp;
+}
@@ -0,0 +1,37 @@
+#ifndef USERPROG_EXEC_ARGS_H
+#define USERPROG_EXEC_ARGS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Pages of kernel memory that hold a new process's arguments,
+   which bounds their total size.  Offsets into them must fit in
+   16 bits. */
+#define EXEC_ARGS_PAGES 8
+
+/* Command-line arguments for a new process.
+
+   BUF is EXEC_ARGS_PAGES pages.  The strings are packed from its
+   start, each with its null terminator, and the offset of each
+   string is stored in a table that grows down from the end of
+   BUF, so that the two meet only when BUF is full.  With the
+   offsets at hand, argv[] is written without looking at the
+   strings again. */
+struct exec_args
+  {
+    char *buf;                  /* Strings, free space, offsets. */
+    size_t len;                 /* Bytes of strings. */
+    int argc;                   /* Number of strings. */
+  };
+
+bool exec_args_init (struct exec_args *);
+void exec_args_destroy (struct exec_args *);
+bool exec_args_parse (struct exec_args *, const char *cmd_line);
+bool exec_args_add (struct exec_args *, const char *);
+int exec_args_from_user (struct exec_args *, char *const *uargv);
+const char *exec_args_get (const struct exec_args *, int i);
+
+size_t exec_args_stack_size (const struct exec_args *);
+void *exec_args_write (const struct exec_args *, void *top);
+
+#endif /* userprog/exec-args.h */
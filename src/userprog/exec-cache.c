@@ -0,0 +1,294 @@
+#include "userprog/exec-cache.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+
+/* Cached executables, most recently used first.
+
+   An image is looked up by the inode of the opened executable,
+   so a file reached through different names is cached once.  A
+   hit skips reading and validating the ELF headers and reading
+   the file's pages.  The image keeps its inode open, and the
+   inode's write generation tells whether the file has changed
+   since it was loaded.  When memory runs out, the cache is
+   emptied before the OOM killer picks a victim (see
+   exec_cache_shrink()). */
+static struct list images;
+
+/* Protects IMAGES and the reference counts of images. */
+static struct lock cache_lock;
+
+/* Statistics. */
+static long long hit_cnt;       /* Execs served from the cache. */
+static long long miss_cnt;      /* Execs that had to read the file. */
+static long long stale_cnt;     /* Images dropped because of a write. */
+static long long shrink_cnt;    /* Images dropped for lack of memory. */
+
+static void free_image (struct exec_image *);
+
+/* Initializes the exec cache. */
+void
+exec_cache_init (void)
+{
+  list_init (&images);
+  lock_init (&cache_lock);
+}
+
+/* Looks up the executable open as FILE.  If it is cached and has
+   not changed since, returns the image, which the caller must
+   release with exec_cache_release().  Otherwise returns a null
+   pointer.  Images of removed files, which no open can reach
+   again, are dropped along the way. */
+struct exec_image *
+exec_cache_lookup (struct file *file)
+{
+  struct inode *inode = file_get_inode (file);
+  struct exec_image *image = NULL;
+  struct list stale;
+  struct list_elem *e;
+
+  list_init (&stale);
+  lock_acquire (&cache_lock);
+  for (e = list_begin (&images); e != list_end (&images); )
+    {
+      struct exec_image *i = list_entry (e, struct exec_image, elem);
+      bool removed = inode_is_removed (i->inode);
+
+      if (i->inode != inode && !removed)
+        {
+          e = list_next (e);
+          continue;
+        }
+
+      e = list_remove (e);
+      if (removed || inode_write_gen (i->inode) != i->write_gen)
+        {
+          list_push_back (&stale, &i->elem);
+          stale_cnt++;
+        }
+      else
+        {
+          image = i;
+          image->ref_cnt++;
+          list_push_front (&images, &i->elem);
+        }
+    }
+  if (image != NULL)
+    hit_cnt++;
+  else
+    miss_cnt++;
+  lock_release (&cache_lock);
+
+  while (!list_empty (&stale))
+    exec_cache_release (list_entry (list_pop_front (&stale),
+                                    struct exec_image, elem));
+  return image;
+}
+
+/* Returns true if some segment in SEGS[] that covers UPAGE is
+   writable. */
+static bool
+page_writable (const struct exec_segment *segs, size_t seg_cnt,
+               const uint8_t *upage)
+{
+  size_t i;
+
+  for (i = 0; i < seg_cnt; i++)
+    if (segs[i].writable && upage >= segs[i].upage
+        && upage < segs[i].upage + segs[i].size)
+      return true;
+  return false;
+}
+
+/* Returns true if UPAGE is among the first PAGE_CNT of PAGES. */
+static bool
+page_recorded (const struct exec_page *pages, size_t page_cnt,
+               const uint8_t *upage)
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    if (pages[i].upage == upage)
+      return true;
+  return false;
+}
+
+/* Adds the executable FILE, just loaded into page directory PD,
+   to the cache.  ENTRY, SEG_END and the SEG_CNT
+   segments in SEGS describe the image.  Must be called before the
+   process runs, while the file's pages in PD still hold their
+   initial contents.  Failing to cache is not an error, so this
+   function simply returns if the image cannot be kept. */
+void
+exec_cache_insert (struct file *file, uint32_t *pd,
+                   void (*entry) (void), uint8_t *seg_end,
+                   const struct exec_segment *segs, size_t seg_cnt)
+{
+  struct exec_image *image;
+  struct exec_image *evict = NULL;
+  struct list_elem *e;
+  size_t max_pages = 0;
+  size_t i;
+
+  for (i = 0; i < seg_cnt; i++)
+    max_pages += segs[i].read_size / PGSIZE;
+  if (max_pages > EXEC_CACHE_MAX_PAGES)
+    return;
+
+  image = calloc (1, sizeof *image);
+  if (image == NULL)
+    return;
+  image->ref_cnt = 1;
+  image->charged = thread_current ()->proc;
+  image->entry = entry;
+  image->seg_end = seg_end;
+  image->segs = malloc (seg_cnt * sizeof *image->segs);
+  image->pages = malloc (max_pages * sizeof *image->pages);
+  if (image->segs == NULL || (max_pages > 0 && image->pages == NULL))
+    {
+      free_image (image);
+      return;
+    }
+  memcpy (image->segs, segs, seg_cnt * sizeof *segs);
+  image->seg_cnt = seg_cnt;
+
+  /* Keep a frame for every page with file data.  Read-only pages
+     share the process's frame.  Writable pages get a copy, since
+     the process is about to modify its own, and the copy may sit
+     inside a large page. */
+  for (i = 0; i < seg_cnt; i++)
+    {
+      uint8_t *upage;
+
+      for (upage = segs[i].upage; upage < segs[i].upage + segs[i].read_size;
+           upage += PGSIZE)
+        {
+          struct exec_page *p = &image->pages[image->page_cnt];
+
+          if (page_recorded (image->pages, image->page_cnt, upage))
+            continue;
+          p->upage = upage;
+          p->writable = page_writable (segs, seg_cnt, upage);
+          p->kpage = pagedir_get_page (pd, upage);
+          ASSERT (p->kpage != NULL);
+          if (p->writable)
+            {
+              void *copy;
+
+              if (!process_charge_held (image->charged, 1))
+                {
+                  free_image (image);
+                  return;
+                }
+              image->copy_cnt++;
+              copy = palloc_get_page (PAL_USER);
+              if (copy == NULL)
+                {
+                  free_image (image);
+                  return;
+                }
+              memcpy (copy, p->kpage, PGSIZE);
+              p->kpage = copy;
+            }
+          else
+            palloc_ref_page (p->kpage);
+          image->page_cnt++;
+        }
+    }
+
+  image->inode = inode_reopen (file_get_inode (file));
+  image->write_gen = inode_write_gen (image->inode);
+
+  lock_acquire (&cache_lock);
+  for (e = list_begin (&images); e != list_end (&images); e = list_next (e))
+    if (list_entry (e, struct exec_image, elem)->inode == image->inode)
+      {
+        /* Another process cached it first.  Its image may be
+           stale, but then the next lookup drops it. */
+        evict = image;
+        break;
+      }
+  if (evict == NULL)
+    {
+      list_push_front (&images, &image->elem);
+      if (list_size (&images) > EXEC_CACHE_SIZE)
+        evict = list_entry (list_pop_back (&images), struct exec_image, elem);
+    }
+  lock_release (&cache_lock);
+
+  if (evict != NULL)
+    exec_cache_release (evict);
+}
+
+/* Drops a reference to IMAGE, freeing it once it is neither
+   cached nor being loaded. */
+void
+exec_cache_release (struct exec_image *image)
+{
+  bool last;
+
+  lock_acquire (&cache_lock);
+  last = --image->ref_cnt == 0;
+  lock_release (&cache_lock);
+
+  if (last)
+    free_image (image);
+}
+
+/* Drops every cached image, freeing those that no process is
+   loading, to give their frames back when memory runs out.
+   Returns true if any image was dropped. */
+bool
+exec_cache_shrink (void)
+{
+  struct list dropped;
+
+  list_init (&dropped);
+  lock_acquire (&cache_lock);
+  while (!list_empty (&images))
+    list_push_back (&dropped, list_pop_front (&images));
+  lock_release (&cache_lock);
+
+  if (list_empty (&dropped))
+    return false;
+  while (!list_empty (&dropped))
+    {
+      shrink_cnt++;
+      exec_cache_release (list_entry (list_pop_front (&dropped),
+                                      struct exec_image, elem));
+    }
+  return true;
+}
+
+/* Frees IMAGE and the frames and inode it holds, and takes back
+   the charge for its copies. */
+static void
+free_image (struct exec_image *image)
+{
+  size_t i;
+
+  for (i = 0; i < image->page_cnt; i++)
+    palloc_free_page (image->pages[i].kpage);
+  if (image->copy_cnt > 0)
+    process_uncharge_held (image->charged, image->copy_cnt);
+  inode_close (image->inode);
+  free (image->pages);
+  free (image->segs);
+  free (image);
+}
+
+/* Prints exec cache statistics. */
+void
+exec_cache_print_stats (void)
+{
+  printf ("Exec cache: %lld hits, %lld misses, %lld stale, %lld shrunk\n",
+          hit_cnt, miss_cnt, stale_cnt, shrink_cnt);
+}
@@ -0,0 +1,71 @@
+#ifndef USERPROG_EXEC_CACHE_H
+#define USERPROG_EXEC_CACHE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct file;
+struct inode;
+
+/* Maximum number of cached executables. */
+#define EXEC_CACHE_SIZE 8
+
+/* Executables with more pages of file data than this are not
+   cached. */
+#define EXEC_CACHE_MAX_PAGES 256
+
+/* A PT_LOAD segment, after validation. */
+struct exec_segment
+  {
+    uint8_t *upage;             /* First user page. */
+    size_t read_size;           /* Bytes of pages holding file data. */
+    size_t size;                /* Total bytes, a multiple of PGSIZE. */
+    bool writable;              /* Writable by the process? */
+  };
+
+/* A page of an executable holding file data. */
+struct exec_page
+  {
+    uint8_t *upage;             /* User virtual address. */
+    void *kpage;                /* Frame with the initial contents. */
+    bool writable;              /* Mapped copy-on-write if true. */
+  };
+
+/* A loaded executable.
+
+   SEGS is the segment layout of the ELF file, as load() validated
+   it.  PAGES holds a reference to a frame for every page that
+   contains file data.  Read-only pages share the frame that the
+   first process to load the image read from disk; writable pages
+   keep a private pristine copy, which later processes map
+   copy-on-write.  The copies are charged to the process that
+   first loaded the image, as long as the image exists.  Pages
+   without file data are not kept. */
+struct exec_image
+  {
+    struct list_elem elem;      /* In the cache's LRU list. */
+    int ref_cnt;                /* Cache's reference plus loaders'. */
+    struct inode *inode;        /* Executable, kept open. */
+    unsigned write_gen;         /* INODE's write generation. */
+    void (*entry) (void);       /* Entry point. */
+    uint8_t *seg_end;           /* End of the highest segment. */
+    struct exec_segment *segs;  /* Segments. */
+    size_t seg_cnt;             /* Number of segments. */
+    struct exec_page *pages;    /* Pages with file data. */
+    size_t page_cnt;            /* Number of pages. */
+    struct proc *charged;       /* Process charged for the copies. */
+    size_t copy_cnt;            /* Number of copies. */
+  };
+
+void exec_cache_init (void);
+struct exec_image *exec_cache_lookup (struct file *);
+void exec_cache_insert (struct file *, uint32_t *pd,
+                        void (*entry) (void), uint8_t *seg_end,
+                        const struct exec_segment *segs, size_t seg_cnt);
+void exec_cache_release (struct exec_image *);
+bool exec_cache_shrink (void);
+void exec_cache_print_stats (void);
+
+#endif /* userprog/exec-cache.h */
@@ -0,0 +1,287 @@
+#include "userprog/fdtable.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "userprog/pipe.h"
+#include "userprog/shm.h"
+
+/* Initial number of slots in a descriptor table. */
+#define FD_TABLE_MIN 16
+
+/* Descriptors reserved for the console. */
+#define FD_RESERVED 2
+
+/* What the reserved descriptors refer to when not redirected. */
+static const struct fd console[FD_RESERVED] =
+  {
+    {FD_STDIN, true, NULL, NULL, NULL},
+    {FD_STDOUT, true, NULL, NULL, NULL},
+  };
+
+/* Soft limit given to processes whose parent has no descriptor
+   table, such as the initial process. */
+size_t fd_limit_default = FD_LIMIT_DEFAULT;
+
+static bool grow (struct fd_table *, size_t min_size);
+static bool copy_fd (struct fd *dst, const struct fd *src);
+static void release_fd (struct fd *);
+
+/* Creates and returns a descriptor table that will hand out
+   descriptors less than LIMIT, or a null pointer if memory is
+   not available. */
+struct fd_table *
+fd_table_create (size_t limit)
+{
+  struct fd_table *t = malloc (sizeof *t);
+  if (t == NULL)
+    return NULL;
+
+  if (limit < FD_RESERVED + 1)
+    limit = FD_RESERVED + 1;
+  t->size = limit < FD_TABLE_MIN ? limit : FD_TABLE_MIN;
+  t->limit = limit;
+  t->first_free = FD_RESERVED;
+  t->fds = calloc (t->size, sizeof *t->fds);
+  t->used = bitmap_create (t->size);
+  if (t->fds == NULL || t->used == NULL)
+    {
+      free (t->fds);
+      bitmap_destroy (t->used);
+      free (t);
+      return NULL;
+    }
+  memcpy (t->fds, console, sizeof console);
+  bitmap_set_multiple (t->used, 0, FD_RESERVED, true);
+  return t;
+}
+
+/* Gives CHILD, a table fresh from fd_table_create(), its own
+   copies of the descriptors in PARENT marked for inheritance, and
+   of the console descriptors, at the same numbers.  Returns false
+   if memory is short, in which case CHILD may hold some of the
+   copies. */
+bool
+fd_table_inherit (struct fd_table *child, const struct fd_table *parent)
+{
+  size_t fd;
+
+  for (fd = 0; fd < parent->size && fd < child->limit; fd++)
+    {
+      const struct fd *f = &parent->fds[fd];
+      if (f->type == FD_FREE || (fd >= FD_RESERVED && !f->inherit))
+        continue;
+
+      if (fd >= child->size && !grow (child, fd + 1))
+        return false;
+      if (!copy_fd (&child->fds[fd], f))
+        return false;
+      bitmap_mark (child->used, fd);
+    }
+  return true;
+}
+
+/* Closes every descriptor still open in T and frees T. */
+void
+fd_table_destroy (struct fd_table *t)
+{
+  size_t fd;
+
+  if (t == NULL)
+    return;
+
+  for (fd = 0; fd < t->size; fd++)
+    release_fd (&t->fds[fd]);
+  free (t->fds);
+  bitmap_destroy (t->used);
+  free (t);
+}
+
+/* Grows T to at least MIN_SIZE slots, doubling its size if that
+   is more, but never past its limit.  Returns false if MIN_SIZE
+   is over T's limit or memory is short. */
+static bool
+grow (struct fd_table *t, size_t min_size)
+{
+  size_t new_size, fd;
+  struct fd *fds;
+  struct bitmap *used;
+
+  new_size = t->size * 2 > min_size ? t->size * 2 : min_size;
+  if (new_size > t->limit)
+    new_size = t->limit;
+  if (new_size < min_size)
+    return false;
+
+  used = bitmap_create (new_size);
+  if (used == NULL)
+    return false;
+  fds = realloc (t->fds, new_size * sizeof *fds);
+  if (fds == NULL)
+    {
+      bitmap_destroy (used);
+      return false;
+    }
+
+  for (fd = 0; fd < t->size; fd++)
+    bitmap_set (used, fd, bitmap_test (t->used, fd));
+  memset (fds + t->size, 0, (new_size - t->size) * sizeof *fds);
+  bitmap_destroy (t->used);
+  t->used = used;
+  t->fds = fds;
+  t->size = new_size;
+  return true;
+}
+
+/* Makes DST an independent descriptor for what SRC refers to.
+   A copied file has its own position.  Returns false if memory
+   is short. */
+static bool
+copy_fd (struct fd *dst, const struct fd *src)
+{
+  *dst = *src;
+  switch (src->type)
+    {
+    case FD_FILE:
+      dst->file = file_reopen (src->file);
+      if (dst->file == NULL)
+        {
+          dst->type = FD_FREE;
+          return false;
+        }
+      break;
+    case FD_PIPE_READ:
+    case FD_PIPE_WRITE:
+      pipe_open_end (src->pipe, src->type == FD_PIPE_WRITE);
+      break;
+    case FD_SHM:
+      shm_reopen (src->shm);
+      break;
+    default:
+      break;
+    }
+  return true;
+}
+
+/* Drops what F refers to and marks it free. */
+static void
+release_fd (struct fd *f)
+{
+  switch (f->type)
+    {
+    case FD_FILE:
+      file_close (f->file);
+      break;
+    case FD_PIPE_READ:
+    case FD_PIPE_WRITE:
+      pipe_close_end (f->pipe, f->type == FD_PIPE_WRITE);
+      break;
+    case FD_SHM:
+      shm_release (f->shm);
+      break;
+    default:
+      break;
+    }
+  f->type = FD_FREE;
+}
+
+/* Installs F in T at the lowest free descriptor and returns the
+   descriptor, or -1 if T is full.  T takes over the reference F
+   holds. */
+int
+fd_install (struct fd_table *t, const struct fd *f)
+{
+  size_t fd;
+
+  ASSERT (f->type != FD_FREE);
+
+  fd = bitmap_scan_and_flip (t->used, t->first_free, 1, false);
+  if (fd == BITMAP_ERROR)
+    {
+      fd = t->size;
+      if (!grow (t, fd + 1))
+        return -1;
+      bitmap_mark (t->used, fd);
+    }
+  t->fds[fd] = *f;
+  t->fds[fd].inherit = false;
+  t->first_free = fd + 1;
+  return fd;
+}
+
+/* Returns descriptor FD in T, or a null pointer if FD is not
+   open.  The pointer is good only until T next changes. */
+struct fd *
+fd_get (const struct fd_table *t, int fd)
+{
+  if (fd < 0 || (size_t) fd >= t->size || t->fds[fd].type == FD_FREE)
+    return NULL;
+  return &t->fds[fd];
+}
+
+/* Returns the file open as descriptor FD in T, or a null
+   pointer if FD is not open or is not a file. */
+struct file *
+fd_lookup (const struct fd_table *t, int fd)
+{
+  struct fd *f = fd_get (t, fd);
+  return f != NULL && f->type == FD_FILE ? f->file : NULL;
+}
+
+/* Closes descriptor FD in T.  A console descriptor goes back to
+   the console.  Returns false if FD was not open. */
+bool
+fd_close (struct fd_table *t, int fd)
+{
+  struct fd *f = fd_get (t, fd);
+  if (f == NULL)
+    return false;
+
+  release_fd (f);
+  if (fd < FD_RESERVED)
+    *f = console[fd];
+  else
+    {
+      bitmap_reset (t->used, fd);
+      if ((size_t) fd < t->first_free)
+        t->first_free = fd;
+    }
+  return true;
+}
+
+/* Makes NEW_FD in T refer to what OLD_FD does, closing NEW_FD
+   first if it is open.  The copy is not inherited.  Returns
+   NEW_FD, or -1 if OLD_FD is not open, NEW_FD is out of range,
+   or memory is short. */
+int
+fd_dup2 (struct fd_table *t, int old_fd, int new_fd)
+{
+  return fd_dup_from (t, new_fd, t, old_fd);
+}
+
+/* Like fd_dup2(), but OLD_FD is looked up in FROM, which may be
+   another process's table. */
+int
+fd_dup_from (struct fd_table *t, int new_fd,
+             const struct fd_table *from, int old_fd)
+{
+  struct fd copy;
+
+  if (fd_get (from, old_fd) == NULL || new_fd < 0
+      || (size_t) new_fd >= t->limit)
+    return -1;
+  if (from == t && old_fd == new_fd)
+    return new_fd;
+
+  if ((size_t) new_fd >= t->size && !grow (t, new_fd + 1))
+    return -1;
+  if (!copy_fd (&copy, fd_get (from, old_fd)))
+    return -1;
+  copy.inherit = false;
+
+  release_fd (&t->fds[new_fd]);
+  t->fds[new_fd] = copy;
+  bitmap_mark (t->used, new_fd);
+  return new_fd;
+}
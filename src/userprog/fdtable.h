@@ -0,0 +1,63 @@
+#ifndef USERPROG_FDTABLE_H
+#define USERPROG_FDTABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Default soft limit on descriptors, settable with -fdlimit. */
+#define FD_LIMIT_DEFAULT 1024
+
+/* What a descriptor refers to. */
+enum fd_type
+  {
+    FD_FREE,                    /* Not open.  Must be zero. */
+    FD_STDIN,                   /* Console input. */
+    FD_STDOUT,                  /* Console output. */
+    FD_FILE,                    /* Open file. */
+    FD_PIPE_READ,               /* Read end of a pipe. */
+    FD_PIPE_WRITE,              /* Write end of a pipe. */
+    FD_SHM                      /* Shared memory segment. */
+  };
+
+/* An open descriptor. */
+struct fd
+  {
+    enum fd_type type;          /* What the descriptor refers to. */
+    bool inherit;               /* Passed on to processes we exec? */
+    struct file *file;          /* For FD_FILE. */
+    struct pipe *pipe;          /* For FD_PIPE_READ and FD_PIPE_WRITE. */
+    struct shm *shm;            /* For FD_SHM. */
+  };
+
+/* A process's open file descriptors.
+
+   FDS is indexed directly by descriptor and USED marks the
+   descriptors in use, so lookup takes constant time and a new
+   descriptor is always the lowest free one.  Descriptors 0 and 1
+   start out as the console, are never handed out, and revert to
+   the console when closed.  Both arrays grow by doubling, but
+   never past LIMIT descriptors. */
+struct fd_table
+  {
+    struct fd *fds;             /* Descriptors, indexed by number. */
+    struct bitmap *used;        /* Descriptors in use. */
+    size_t size;                /* Number of slots in FDS and USED. */
+    size_t limit;               /* Descriptors must be less than this. */
+    size_t first_free;          /* No free descriptor below this. */
+  };
+
+extern size_t fd_limit_default;
+
+struct fd_table *fd_table_create (size_t limit);
+bool fd_table_inherit (struct fd_table *child, const struct fd_table *);
+void fd_table_destroy (struct fd_table *);
+
+int fd_install (struct fd_table *, const struct fd *);
+struct fd *fd_get (const struct fd_table *, int fd);
+struct file *fd_lookup (const struct fd_table *, int fd);
+bool fd_close (struct fd_table *, int fd);
+int fd_dup2 (struct fd_table *, int old_fd, int new_fd);
+int fd_dup_from (struct fd_table *, int new_fd,
+                 const struct fd_table *from, int old_fd);
+
+#endif /* userprog/fdtable.h */
@@ -0,0 +1,235 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "userprog/uaccess.h"
+
+/* Fast user-space locks.
+
+   A futex is an aligned int in user memory.  futex_wait() sleeps
+   as long as the int holds an expected value and futex_wake()
+   wakes up threads sleeping on it, so user-space locks only need
+   the kernel once they are contended.
+
+   Waiters are kept in a hash table of wait queues keyed by the
+   physical address of the int, which is the same for every
+   mapping of it.  Same-page merging and pipes would move a
+   waiter's int to another frame behind its back, so they leave
+   pages with waiters alone; see futex_page_busy().  The table is protected by
+   turning interrupts off, which also makes looking up a page and
+   queuing on it atomic with respect to merging. */
+
+/* Number of wait queues. */
+#define FUTEX_BUCKETS 64
+
+/* A thread in futex_wait(). */
+struct futex_waiter
+  {
+    struct list_elem elem;      /* In a bucket. */
+    uintptr_t key;              /* Physical address of the int. */
+    struct proc *proc;          /* Process of the waiting thread. */
+    struct semaphore sema;      /* Upped to wake the thread. */
+    bool woken;                 /* Woken by futex_wake()? */
+  };
+
+/* Wait queues, indexed by bucket_of(). */
+static struct list buckets[FUTEX_BUCKETS];
+
+/* Statistics. */
+static long long wait_cnt;      /* Threads that went to sleep. */
+static long long wake_cnt;      /* Threads woken by futex_wake(). */
+static long long timeout_cnt;   /* Waits that timed out. */
+
+/* Initializes the futex table. */
+void
+futex_init (void)
+{
+  size_t i;
+
+  for (i = 0; i < FUTEX_BUCKETS; i++)
+    list_init (&buckets[i]);
+}
+
+/* Returns the wait queue for KEY.  All the ints in a page share
+   a queue, so that futex_page_busy() need only check one. */
+static struct list *
+bucket_of (uintptr_t key)
+{
+  return &buckets[hash_int (key >> PGBITS) % FUTEX_BUCKETS];
+}
+
+/* Returns the physical address of the int at UADDR in the
+   current process, or 0 if its page is not present or is
+   copy-on-write.  Interrupts must be
+   off. */
+static uintptr_t
+lookup_key (int *uaddr)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  void *kaddr;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  kaddr = pagedir_get_page (pd, uaddr);
+  if (kaddr == NULL || pagedir_is_cow (pd, uaddr))
+    return 0;
+  return vtop (kaddr);
+}
+
+/* Returns true if UADDR is an aligned int in user memory. */
+static bool
+valid_futex (const int *uaddr)
+{
+  return ((uintptr_t) uaddr % sizeof *uaddr) == 0 && is_user_vaddr (uaddr);
+}
+
+/* Sleeps until another thread calls futex_wake() on UADDR, if
+   the int there still holds EXPECTED.  Gives up after TIMEOUT
+   milliseconds, unless TIMEOUT is negative.  Returns 0 if woken,
+   1 on timeout, or -1 if *UADDR did not hold EXPECTED or cannot
+   be accessed, or if the process is exiting. */
+int
+futex_wait (int *uaddr, int expected, int timeout)
+{
+  struct futex_waiter w;
+  enum intr_level old_level;
+  bool timed_out = false;
+
+  if (!valid_futex (uaddr))
+    return -1;
+
+  /* Make the page present and private, then check the value and
+     queue up without letting it change. */
+  old_level = intr_disable ();
+  while ((w.key = lookup_key (uaddr)) == 0)
+    {
+      intr_set_level (old_level);
+      if (!probe_user_write (uaddr, sizeof *uaddr))
+        return -1;
+      old_level = intr_disable ();
+    }
+  w.proc = thread_current ()->proc;
+  if (*(int *) ptov (w.key) != expected
+      || (w.proc != NULL && w.proc->exiting))
+    {
+      intr_set_level (old_level);
+      return -1;
+    }
+  w.woken = false;
+  sema_init (&w.sema, 0);
+  list_push_back (bucket_of (w.key), &w.elem);
+  wait_cnt++;
+  intr_set_level (old_level);
+
+  if (timeout < 0)
+    sema_down (&w.sema);
+  else
+    timer_sema_down (&w.sema, DIV_ROUND_UP ((int64_t) timeout * TIMER_FREQ,
+                                            1000));
+
+  /* If the timeout won, no one removed us. */
+  old_level = intr_disable ();
+  if (!w.woken)
+    {
+      list_remove (&w.elem);
+      timed_out = true;
+      timeout_cnt++;
+    }
+  intr_set_level (old_level);
+  return timed_out ? 1 : 0;
+}
+
+/* Wakes up to CNT threads waiting on the int at UADDR, oldest
+   first.  Returns the number of threads woken. */
+int
+futex_wake (int *uaddr, int cnt)
+{
+  enum intr_level old_level;
+  struct list_elem *e, *next;
+  struct list *bucket;
+  uintptr_t key;
+  int woken = 0;
+
+  if (!valid_futex (uaddr))
+    return 0;
+
+  old_level = intr_disable ();
+  key = lookup_key (uaddr);
+  bucket = bucket_of (key);
+  for (e = list_begin (bucket); key != 0 && woken < cnt
+       && e != list_end (bucket); e = next)
+    {
+      struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+      next = list_next (e);
+      if (w->key == key)
+        {
+          list_remove (e);
+          w->woken = true;
+          sema_up (&w->sema);
+          woken++;
+        }
+    }
+  wake_cnt += woken;
+  intr_set_level (old_level);
+  return woken;
+}
+
+/* Wakes every thread of PROC waiting on a futex, so that it
+   notices the process is exiting. */
+void
+futex_wake_proc (struct proc *proc)
+{
+  enum intr_level old_level;
+  struct list_elem *e, *next;
+  size_t i;
+
+  old_level = intr_disable ();
+  for (i = 0; i < FUTEX_BUCKETS; i++)
+    for (e = list_begin (&buckets[i]); e != list_end (&buckets[i]); e = next)
+      {
+        struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+        next = list_next (e);
+        if (w->proc == proc)
+          {
+            list_remove (e);
+            w->woken = true;
+            sema_up (&w->sema);
+          }
+      }
+  intr_set_level (old_level);
+}
+
+/* Returns true if a thread is waiting on an int in frame KPAGE.
+   Interrupts must be off. */
+bool
+futex_page_busy (const void *kpage)
+{
+  uintptr_t page = vtop (kpage);
+  struct list *bucket = bucket_of (page);
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (e = list_begin (bucket); e != list_end (bucket); e = list_next (e))
+    if ((list_entry (e, struct futex_waiter, elem)->key & ~PGMASK) == page)
+      return true;
+  return false;
+}
+
+/* Prints futex statistics. */
+void
+futex_print_stats (void)
+{
+  printf ("Futex: %lld waits, %lld wakes, %lld timeouts\n",
+          wait_cnt, wake_cnt, timeout_cnt);
+}
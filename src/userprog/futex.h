@@ -0,0 +1,15 @@
+#ifndef USERPROG_FUTEX_H
+#define USERPROG_FUTEX_H
+
+#include <stdbool.h>
+
+struct proc;
+
+void futex_init (void);
+int futex_wait (int *uaddr, int expected, int timeout);
+int futex_wake (int *uaddr, int cnt);
+void futex_wake_proc (struct proc *);
+bool futex_page_busy (const void *kpage);
+void futex_print_stats (void);
+
+#endif /* userprog/futex.h */
@@ -3,48 +3,141 @@
 #include <stddef.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 
+/* Number of page directory entries that map user memory. */
+#define USER_PDE_CNT (LOADER_PHYS_BASE >> PDSHIFT)
+
+/* Bookkeeping for a page directory, kept in the page that
+   follows it, so that pagedir_destroy() need not look at every
+   entry of the directory and of its page tables. */
+struct pd_info
+  {
+    uint32_t used[USER_PDE_CNT / 32];   /* Bitmap of user PDEs in use. */
+    uint16_t pte_cnt[USER_PDE_CNT];     /* Present PTEs per page table. */
+  };
+
+/* Pages that pagedir_destroy() frees together, so that it turns
+   interrupts off once per batch rather than once per page. */
+#define FREE_BATCH 32
+struct free_batch
+  {
+    void *pages[FREE_BATCH];
+    size_t cnt;
+  };
+
+static struct pd_info *pd_info (uint32_t *);
+static void free_table (uint32_t *pd, size_t pde_idx, struct free_batch *);
+static void batch_add (struct free_batch *, void *page);
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
+static void load_pagedir (uint32_t *);
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
+   The directory takes PAGEDIR_PAGES pages of kernel memory.
    Returns the new page directory, or a null pointer if memory
    allocation fails. */
 uint32_t *
 pagedir_create (void) 
 {
-  uint32_t *pd = palloc_get_page (0);
+  uint32_t *pd = palloc_get_multiple (0, PAGEDIR_PAGES);
   if (pd != NULL)
-    memcpy (pd, init_page_dir, PGSIZE);
+    {
+      memcpy (pd, init_page_dir, PGSIZE);
+      memset (pd_info (pd), 0, sizeof (struct pd_info));
+    }
   return pd;
 }
 
 /* Destroys page directory PD, freeing all the pages it
-   references. */
+   references.  Only the page tables in use are visited, each up
+   to its last present entry. */
 void
 pagedir_destroy (uint32_t *pd) 
 {
-  uint32_t *pde;
+  struct pd_info *info;
+  struct free_batch batch;
+  size_t i;
 
   if (pd == NULL)
     return;
 
   ASSERT (pd != init_page_dir);
-  for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
-    if (*pde & PTE_P) 
-      {
-        uint32_t *pt = pde_get_pt (*pde);
-        uint32_t *pte;
-        
-        for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
-          if (*pte & PTE_P) 
-            palloc_free_page (pte_get_page (*pte));
-        palloc_free_page (pt);
-      }
-  palloc_free_page (pd);
+  info = pd_info (pd);
+  batch.cnt = 0;
+  for (i = 0; i < USER_PDE_CNT / 32; i++)
+    {
+      uint32_t used = info->used[i];
+      size_t bit;
+
+      for (bit = 0; used != 0; bit++, used >>= 1)
+        if (used & 1)
+          free_table (pd, i * 32 + bit, &batch);
+    }
+  palloc_free_pages (batch.pages, batch.cnt);
+  palloc_free_multiple (pd, PAGEDIR_PAGES);
+}
+
+/* Frees the page table, or 4 MB page, that entry PDE_IDX of PD
+   refers to, along with the pages that the page table maps.
+   Single pages are added to BATCH. */
+static void
+free_table (uint32_t *pd, size_t pde_idx, struct free_batch *batch) 
+{
+  uint32_t pde = pd[pde_idx];
+  uint32_t *pt, *pte;
+  size_t left;
+
+  ASSERT (pde & PTE_P);
+  if (pde & PTE_PS)
+    {
+      palloc_free_multiple (pde_get_page (pde), PTSPAN / PGSIZE);
+      return;
+    }
+
+  pt = pde_get_pt (pde);
+  left = pd_info (pd)->pte_cnt[pde_idx];
+  for (pte = pt; left > 0; pte++)
+    {
+      ASSERT (pte < pt + PGSIZE / sizeof *pte);
+      if (*pte & PTE_P)
+        {
+          batch_add (batch, pte_get_page (*pte));
+          left--;
+        }
+    }
+  batch_add (batch, pt);
+}
+
+/* Adds PAGE to BATCH, freeing the batch's pages if it is full. */
+static void
+batch_add (struct free_batch *batch, void *page) 
+{
+  batch->pages[batch->cnt++] = page;
+  if (batch->cnt == FREE_BATCH)
+    {
+      palloc_free_pages (batch->pages, batch->cnt);
+      batch->cnt = 0;
+    }
+}
+
+/* Returns the bookkeeping for page directory PD. */
+static struct pd_info *
+pd_info (uint32_t *pd) 
+{
+  return (struct pd_info *) (pd + PGSIZE / sizeof *pd);
+}
+
+/* Records that entry PDE_IDX of PD, a user PDE, is in use. */
+static void
+mark_pde_used (uint32_t *pd, size_t pde_idx) 
+{
+  ASSERT (pde_idx < USER_PDE_CNT);
+  pd_info (pd)->used[pde_idx / 32] |= 1u << pde_idx % 32;
 }
 
 /* Returns the address of the page table entry for virtual
@@ -52,7 +145,8 @@ pagedir_destroy (uint32_t *pd)
    If PD does not have a page table for VADDR, behavior depends
    on CREATE.  If CREATE is true, then a new page table is
    created and a pointer into it is returned.  Otherwise, a null
-   pointer is returned. */
+   pointer is returned.  A null pointer is also returned if VADDR
+   lies in a 4 MB page, which has no page table entry. */
 static uint32_t *
 lookup_page (uint32_t *pd, const void *vaddr, bool create)
 {
@@ -66,6 +160,8 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
   /* Check for a page table for VADDR.
      If one is missing, create one if requested. */
   pde = pd + pd_no (vaddr);
+  if (*pde & PTE_PS)
+    return NULL;
   if (*pde == 0) 
     {
       if (create)
@@ -75,6 +171,7 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
             return NULL; 
       
           *pde = pde_create (pt);
+          mark_pde_used (pd, pde - pd);
         }
       else
         return NULL;
@@ -112,12 +209,38 @@ pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool writable)
     {
       ASSERT ((*pte & PTE_P) == 0);
       *pte = pte_create_user (kpage, writable);
+      pd_info (pd)->pte_cnt[pd_no (upage)]++;
       return true;
     }
   else
     return false;
 }
 
+/* Maps the 4 MB of user virtual memory starting at UPAGE in PD
+   to the physically contiguous frames starting at KPAGE with a
+   single large page.  UPAGE must be 4 MB aligned, and KPAGE must
+   be from palloc_get_aligned() with that alignment.  Returns
+   false if any part of the range already has a page table or a
+   mapping. */
+bool
+pagedir_set_large_page (uint32_t *pd, void *upage, void *kpage,
+                        bool writable)
+{
+  uint32_t *pde;
+
+  ASSERT (init_large_pages);
+  ASSERT (((uintptr_t) upage & (PTSPAN - 1)) == 0);
+  ASSERT (is_user_vaddr (upage));
+  ASSERT (pd != init_page_dir);
+
+  pde = pd + pd_no (upage);
+  if (*pde != 0)
+    return false;
+  *pde = pde_create_large (kpage, true, writable);
+  mark_pde_used (pd, pde - pd);
+  return true;
+}
+
 /* Looks up the physical address that corresponds to user virtual
    address UADDR in PD.  Returns the kernel virtual address
    corresponding to that physical address, or a null pointer if
@@ -126,8 +249,13 @@ void *
 pagedir_get_page (uint32_t *pd, const void *uaddr) 
 {
   uint32_t *pte;
+  uint32_t pde;
 
   ASSERT (is_user_vaddr (uaddr));
+
+  pde = pd[pd_no (uaddr)];
+  if (pde & PTE_PS)
+    return pde_get_page (pde) + ((uintptr_t) uaddr & (PTSPAN - 1));
   
   pte = lookup_page (pd, uaddr, false);
   if (pte != NULL && (*pte & PTE_P) != 0)
@@ -152,6 +280,7 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
+      pd_info (pd)->pte_cnt[pd_no (upage)]--;
       invalidate_pagedir (pd);
     }
 }
@@ -241,14 +370,174 @@ pagedir_set_writable (uint32_t *pd, const void *vpage, bool writable)
     }
 }
 
+/* Returns the lowest user virtual page at or above UPAGE that is
+   mapped in PD, or a null pointer if there is none.  Pages
+   inside 4 MB mappings are skipped. */
+void *
+pagedir_next_page (uint32_t *pd, const void *upage) 
+{
+  uintptr_t va = (uintptr_t) upage;
+
+  ASSERT (pg_ofs (upage) == 0);
+
+  while (va < (uintptr_t) PHYS_BASE)
+    {
+      uint32_t pde = pd[pd_no ((void *) va)];
+      if ((pde & (PTE_P | PTE_PS)) == PTE_P)
+        {
+          uint32_t *pt = pde_get_pt (pde);
+          size_t i;
+
+          for (i = pt_no ((void *) va); i < PGSIZE / sizeof *pt; i++)
+            if (pt[i] & PTE_P)
+              return (void *) ((va & PDMASK) | (i << PTSHIFT));
+        }
+      va = (va & PDMASK) + PTSPAN;
+    }
+  return NULL;
+}
+
+/* Returns true if PD has a page table, or a 4 MB page, covering
+   user virtual address UADDR, so that mapping a page there
+   allocates no memory for the page table. */
+bool
+pagedir_has_table (uint32_t *pd, const void *uaddr) 
+{
+  ASSERT (is_user_vaddr (uaddr));
+  return (pd[pd_no (uaddr)] & PTE_P) != 0;
+}
+
+/* Returns true if user virtual page UPAGE in PD is mapped
+   copy-on-write. */
+bool
+pagedir_is_cow (uint32_t *pd, const void *upage) 
+{
+  uint32_t *pte = lookup_page (pd, upage, false);
+  return pte != NULL && (*pte & (PTE_P | PTE_COW)) == (PTE_P | PTE_COW);
+}
+
+/* Makes the mapping for UPAGE in PD copy-on-write, if it is
+   writable.  The next write to the page faults and is resolved by
+   pagedir_break_cow(). */
+void
+pagedir_set_cow (uint32_t *pd, const void *upage) 
+{
+  uint32_t *pte = lookup_page (pd, upage, false);
+  if (pte != NULL && (*pte & (PTE_P | PTE_W)) == (PTE_P | PTE_W)) 
+    {
+      *pte = (*pte & ~(uint32_t) PTE_W) | PTE_COW;
+      invalidate_pagedir (pd);
+    }
+}
+
+/* Points the existing mapping for UPAGE in PD at KPAGE instead,
+   keeping its flags.  The caller is responsible for the reference
+   counts of both frames. */
+void
+pagedir_remap_page (uint32_t *pd, const void *upage, void *kpage) 
+{
+  uint32_t *pte = lookup_page (pd, upage, false);
+
+  ASSERT (pg_ofs (kpage) == 0);
+  ASSERT (pte != NULL && (*pte & PTE_P) != 0);
+
+  *pte = vtop (kpage) | (*pte & PTE_FLAGS);
+  invalidate_pagedir (pd);
+}
+
+/* Resolves a write fault on copy-on-write page UPAGE in PD.  If
+   the frame is no longer shared, the mapping is simply made
+   writable again; otherwise the page gets a private copy.
+   Returns false if UPAGE is not copy-on-write or memory
+   allocation fails. */
+bool
+pagedir_break_cow (uint32_t *pd, const void *upage) 
+{
+  enum intr_level old_level;
+  uint32_t *pte;
+  void *copy;
+  void *kpage = NULL;
+  bool success = false;
+
+  pte = lookup_page (pd, upage, false);
+  if (pte == NULL || (*pte & (PTE_P | PTE_COW)) != (PTE_P | PTE_COW))
+    return false;
+
+  /* Allocate first, since the frame can stop being shared while
+     we sleep; the PTE is then re-examined with interrupts off. */
+  copy = palloc_get_page (PAL_USER);
+
+  old_level = intr_disable ();
+  if ((*pte & (PTE_P | PTE_COW)) == (PTE_P | PTE_COW)) 
+    {
+      kpage = pte_get_page (*pte);
+      if (palloc_page_refs (kpage) == 1) 
+        {
+          *pte = (*pte & ~(uint32_t) PTE_COW) | PTE_W;
+          kpage = NULL;
+          success = true;
+        }
+      else if (copy != NULL) 
+        {
+          memcpy (copy, kpage, PGSIZE);
+          *pte = vtop (copy) | (*pte & (PTE_FLAGS & ~PTE_COW)) | PTE_W;
+          copy = NULL;
+          success = true;
+        }
+      else
+        kpage = NULL;
+      invalidate_pagedir (pd);
+    }
+  else
+    success = (*pte & PTE_W) != 0;
+  intr_set_level (old_level);
+
+  if (kpage != NULL)
+    palloc_free_page (kpage);
+  if (copy != NULL)
+    palloc_free_page (copy);
+  return success;
+}
+
+/* Returns true if user virtual page UPAGE in PD maps a frame of
+   a shared memory segment. */
+bool
+pagedir_is_shared (uint32_t *pd, const void *upage) 
+{
+  uint32_t *pte = lookup_page (pd, upage, false);
+  return pte != NULL && (*pte & (PTE_P | PTE_SHARED)) == (PTE_P | PTE_SHARED);
+}
+
+/* Marks the mapping for UPAGE in PD as one of a shared memory
+   segment, whose frame must stay in place while it is mapped. */
+void
+pagedir_set_shared (uint32_t *pd, const void *upage) 
+{
+  uint32_t *pte = lookup_page (pd, upage, false);
+
+  ASSERT (pte != NULL && (*pte & PTE_P) != 0);
+  *pte |= PTE_SHARED;
+}
+
 /* Loads page directory PD into the CPU's page directory base
-   register. */
+   register, unless it is already loaded. */
 void
 pagedir_activate (uint32_t *pd) 
 {
   if (pd == NULL)
     pd = init_page_dir;
 
+  /* Loading CR3 flushes every non-global TLB entry, so avoid it
+     when the page directory does not change. */
+  if (active_pd () != pd)
+    load_pagedir (pd);
+}
+
+/* Loads page directory PD into the CPU's page directory base
+   register, flushing the TLB's non-global entries. */
+static void
+load_pagedir (uint32_t *pd) 
+{
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
@@ -283,8 +572,9 @@ invalidate_pagedir (uint32_t *pd)
 {
   if (active_pd () == pd) 
     {
-      /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
-         "Translation Lookaside Buffers (TLBs)". */
-      pagedir_activate (pd);
+      /* Re-loading PD clears the TLB of user mappings, which are
+         never global.  See [IA32-v3a] 3.12 "Translation Lookaside
+         Buffers (TLBs)". */
+      load_pagedir (pd);
     } 
 }
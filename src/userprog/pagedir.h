@@ -2,11 +2,18 @@
 #define USERPROG_PAGEDIR_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+/* Pages of kernel memory that a page directory takes: the
+   directory itself and a page of bookkeeping. */
+#define PAGEDIR_PAGES 2
+
 uint32_t *pagedir_create (void);
 void pagedir_destroy (uint32_t *pd);
 bool pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool rw);
+bool pagedir_set_large_page (uint32_t *pd, void *upage, void *kpage,
+                             bool rw);
 void *pagedir_get_page (uint32_t *pd, const void *upage);
 void pagedir_clear_page (uint32_t *pd, void *upage);
 bool pagedir_is_dirty (uint32_t *pd, const void *upage);
@@ -15,6 +22,14 @@ bool pagedir_is_accessed (uint32_t *pd, const void *upage);
 void pagedir_set_accessed (uint32_t *pd, const void *upage, bool accessed);
 bool pagedir_is_writable (uint32_t *pd, const void *upage);
 void pagedir_set_writable (uint32_t *pd, const void *upage, bool writable);
+void *pagedir_next_page (uint32_t *pd, const void *upage);
+bool pagedir_has_table (uint32_t *pd, const void *uaddr);
+bool pagedir_is_cow (uint32_t *pd, const void *upage);
+void pagedir_set_cow (uint32_t *pd, const void *upage);
+void pagedir_remap_page (uint32_t *pd, const void *upage, void *kpage);
+bool pagedir_break_cow (uint32_t *pd, const void *upage);
+bool pagedir_is_shared (uint32_t *pd, const void *upage);
+void pagedir_set_shared (uint32_t *pd, const void *upage);
 void pagedir_activate (uint32_t *pd);
 
 #endif /* userprog/pagedir.h */
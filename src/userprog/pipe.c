@@ -0,0 +1,328 @@
+#include "userprog/pipe.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/futex.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "userprog/uaccess.h"
+
+/* Pipes.
+
+   A pipe holds its data in a ring of up to PIPE_BUFS pages.
+   Small writes are copied into the last page until it fills up.
+   A write of a whole, page-aligned user page instead hands the
+   frame itself to the pipe: the writer's mapping becomes
+   copy-on-write and the pipe takes a reference to the frame.  A
+   read of a whole page into a page-aligned user buffer likewise
+   maps the frame into the reader, copy-on-write, in place of the
+   page that was there.  Data moved a page at a time is therefore
+   never copied unless one side writes to it afterward.  Pages of
+   shared memory segments are always copied, since other processes
+   see them change, and so are pages that a thread is waiting on
+   in futex_wait(), since a futex is keyed by its frame.  A page
+   that a write allocates is charged to the writing process until
+   it is freed; a page handed over stays charged to the writer's
+   mapping.
+
+   The pipe is freed when the last descriptor for either end is
+   closed.  A system call blocked on a pipe counts as a reader or
+   writer, so the pipe cannot go away under it.  It stops waiting
+   if its process exits. */
+
+/* Most pages of data a pipe holds. */
+#define PIPE_BUFS 16
+
+/* A page of data in a pipe. */
+struct pipe_buf
+  {
+    uint8_t *page;              /* Frame, by kernel address. */
+    uint16_t ofs;               /* Offset of the first unread byte. */
+    uint16_t len;               /* Number of unread bytes. */
+    bool shared;                /* Taken from a writer's mapping? */
+    struct proc *charged;       /* Process charged for PAGE, or null. */
+  };
+
+/* A pipe. */
+struct pipe
+  {
+    struct lock lock;                   /* Protects all members. */
+    struct condition not_empty;         /* Signaled on write or close. */
+    struct condition not_full;          /* Signaled on read or close. */
+    struct pipe_buf bufs[PIPE_BUFS];    /* Ring of pages. */
+    size_t head;                        /* Index of the oldest page. */
+    size_t cnt;                         /* Number of pages in use. */
+    int readers;                        /* References to read end. */
+    int writers;                        /* References to write end. */
+  };
+
+/* Frees buffer B's page, if it still has one, and takes back its
+   charge. */
+static void
+free_buf (struct pipe_buf *b)
+{
+  if (b->page != NULL)
+    palloc_free_page (b->page);
+  if (b->charged != NULL)
+    process_uncharge_held (b->charged, 1);
+}
+
+/* Creates and returns a pipe with one reference to each end, or
+   a null pointer if memory is short. */
+struct pipe *
+pipe_create (void)
+{
+  struct pipe *p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+
+  lock_init (&p->lock);
+  cond_init (&p->not_empty);
+  cond_init (&p->not_full);
+  p->head = p->cnt = 0;
+  p->readers = p->writers = 1;
+  return p;
+}
+
+/* Adds a reference to the write end of P if WRITER is true,
+   otherwise to its read end. */
+void
+pipe_open_end (struct pipe *p, bool writer)
+{
+  lock_acquire (&p->lock);
+  if (writer)
+    p->writers++;
+  else
+    p->readers++;
+  lock_release (&p->lock);
+}
+
+/* Drops a reference to the write end of P if WRITER is true,
+   otherwise to its read end, and frees P once both ends are
+   closed. */
+void
+pipe_close_end (struct pipe *p, bool writer)
+{
+  bool dead;
+
+  lock_acquire (&p->lock);
+  if (writer)
+    p->writers--;
+  else
+    p->readers--;
+  ASSERT (p->readers >= 0 && p->writers >= 0);
+  dead = p->readers == 0 && p->writers == 0;
+  cond_broadcast (&p->not_empty, &p->lock);
+  cond_broadcast (&p->not_full, &p->lock);
+  lock_release (&p->lock);
+
+  if (dead)
+    {
+      for (; p->cnt > 0; p->cnt--, p->head++)
+        free_buf (&p->bufs[p->head % PIPE_BUFS]);
+      free (p);
+    }
+}
+
+/* Tries to move the whole page at page-aligned user address UPAGE
+   into P as a new buffer, leaving the writer's mapping
+   copy-on-write.  Returns false if UPAGE is not a plain user page
+   that the writer may write or holds a futex with waiters, in
+   which case it must be copied. */
+static bool
+give_page (struct pipe *p, const void *upage)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  struct pipe_buf *b;
+  enum intr_level old_level;
+  void *kpage;
+  bool success = false;
+
+  /* Same-page merging changes mappings, and futex_wait() queues
+     on frames, with interrupts off. */
+  old_level = intr_disable ();
+  kpage = pagedir_get_page (pd, upage);
+  if (kpage != NULL && palloc_is_user_page (kpage)
+      && !pagedir_is_shared (pd, upage) && !futex_page_busy (kpage)
+      && (pagedir_is_writable (pd, upage) || pagedir_is_cow (pd, upage)))
+    {
+      palloc_ref_page (kpage);
+      pagedir_set_cow (pd, upage);
+      success = true;
+    }
+  intr_set_level (old_level);
+
+  if (success)
+    {
+      b = &p->bufs[(p->head + p->cnt++) % PIPE_BUFS];
+      b->page = kpage;
+      b->ofs = 0;
+      b->len = PGSIZE;
+      b->shared = true;
+      b->charged = NULL;
+    }
+  return success;
+}
+
+/* Tries to map the whole-page buffer B into the reader at
+   page-aligned user address UPAGE, copy-on-write, in place of the
+   page mapped there.  Returns false if UPAGE is not a plain user
+   page that the reader may write or holds a futex with waiters,
+   in which case B must be copied.  On success, the pipe's reference to B's frame passes
+   to the reader's mapping. */
+static bool
+take_page (struct pipe_buf *b, void *upage)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  enum intr_level old_level;
+  void *old = NULL;
+
+  old_level = intr_disable ();
+  old = pagedir_get_page (pd, upage);
+  if (old != NULL && palloc_is_user_page (old)
+      && !pagedir_is_shared (pd, upage) && !futex_page_busy (old)
+      && (pagedir_is_writable (pd, upage) || pagedir_is_cow (pd, upage)))
+    {
+      pagedir_remap_page (pd, upage, b->page);
+      pagedir_set_cow (pd, upage);
+    }
+  else
+    old = NULL;
+  intr_set_level (old_level);
+
+  if (old == NULL)
+    return false;
+  palloc_free_page (old);
+  return true;
+}
+
+/* Reads up to SIZE bytes from P into user buffer BUFFER.  If P is
+   empty, waits for data if BLOCK is true and P has writers.
+   Returns the number of bytes read, which is 0 at end of file or
+   if BLOCK is false and P is empty, or -1 if BUFFER is not valid
+   user memory or the process exits while waiting.  Bytes that
+   cannot be copied stay in P. */
+int
+pipe_read (struct pipe *p, void *buffer_, size_t size, bool block)
+{
+  struct proc *proc = thread_current ()->proc;
+  uint8_t *buffer = buffer_;
+  size_t bytes = 0;
+  bool faulted = false;
+
+  lock_acquire (&p->lock);
+  while (block && p->cnt == 0 && p->writers > 0)
+    if (!cond_wait_unless (&p->not_empty, &p->lock, &proc->exiting))
+      {
+        lock_release (&p->lock);
+        return -1;
+      }
+
+  while (bytes < size && p->cnt > 0)
+    {
+      struct pipe_buf *b = &p->bufs[p->head % PIPE_BUFS];
+      size_t chunk = size - bytes < b->len ? size - bytes : b->len;
+
+      if (chunk == PGSIZE && pg_ofs (buffer + bytes) == 0
+          && take_page (b, buffer + bytes))
+        b->page = NULL;
+      else if (!copy_to_user (buffer + bytes, b->page + b->ofs, chunk))
+        {
+          faulted = true;
+          break;
+        }
+      bytes += chunk;
+      b->ofs += chunk;
+      b->len -= chunk;
+
+      if (b->len == 0)
+        {
+          free_buf (b);
+          p->head++;
+          p->cnt--;
+        }
+    }
+  if (bytes > 0)
+    cond_broadcast (&p->not_full, &p->lock);
+  lock_release (&p->lock);
+
+  return faulted && bytes == 0 ? -1 : (int) bytes;
+}
+
+/* Writes the SIZE bytes in user buffer BUFFER to P, waiting for
+   room as needed.  Returns the number of bytes written, which is
+   less than SIZE only if P has no readers left, BUFFER is not
+   valid user memory or the process exits while waiting, or -1 if
+   nothing could be written. */
+int
+pipe_write (struct pipe *p, const void *buffer_, size_t size)
+{
+  struct proc *proc = thread_current ()->proc;
+  const uint8_t *buffer = buffer_;
+  size_t bytes = 0;
+
+  lock_acquire (&p->lock);
+  while (bytes < size && p->readers > 0)
+    {
+      struct pipe_buf *last = &p->bufs[(p->head + p->cnt - 1) % PIPE_BUFS];
+      size_t room, chunk;
+
+      /* Hand over whole pages, or copy into the last page if it
+         has room, or else into a new page. */
+      if (p->cnt < PIPE_BUFS && size - bytes >= PGSIZE
+          && pg_ofs (buffer + bytes) == 0 && give_page (p, buffer + bytes))
+        {
+          bytes += PGSIZE;
+          cond_broadcast (&p->not_empty, &p->lock);
+          continue;
+        }
+      if (p->cnt == 0 || last->shared || last->ofs + last->len == PGSIZE)
+        {
+          if (p->cnt == PIPE_BUFS)
+            {
+              if (!cond_wait_unless (&p->not_full, &p->lock,
+                                     &proc->exiting))
+                break;
+              continue;
+            }
+          last = &p->bufs[(p->head + p->cnt) % PIPE_BUFS];
+          if (!process_charge_held (proc, 1))
+            break;
+          last->page = palloc_get_page (PAL_USER);
+          if (last->page == NULL)
+            {
+              process_uncharge_held (proc, 1);
+              break;
+            }
+          last->ofs = last->len = 0;
+          last->shared = false;
+          last->charged = proc;
+          p->cnt++;
+        }
+
+      room = PGSIZE - (last->ofs + last->len);
+      chunk = size - bytes < room ? size - bytes : room;
+      if (!copy_from_user (last->page + last->ofs + last->len,
+                           buffer + bytes, chunk))
+        {
+          /* Don't leave an empty page for readers to mistake for
+             end of file. */
+          if (last->len == 0)
+            {
+              free_buf (last);
+              p->cnt--;
+            }
+          break;
+        }
+      last->len += chunk;
+      bytes += chunk;
+      cond_broadcast (&p->not_empty, &p->lock);
+    }
+  lock_release (&p->lock);
+
+  return bytes > 0 || size == 0 ? (int) bytes : -1;
+}
@@ -8,92 +8,354 @@
 #include "threads/interrupt.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/pte.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "userprog/exec-args.h"
+#include "userprog/exec-cache.h"
+#include "userprog/fdtable.h"
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/ring.h"
 #include "userprog/tss.h"
 #include "userprog/syscall.h"
+#ifdef VM
+#include "vm/ksm.h"
+#endif
 #include <debug.h>
 #include <inttypes.h>
 #include <round.h>
+#include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <vclock.h>
 
-/* Child process for parent thread's CHILDREN. This must be on
-   the parent's page, because otherwise it will be lost when the
-   child thread terminates. STATUS should be -1 at first and
-   updated in a call to exit(). */
+/* Record of a child process on its parent's CHILDREN, which any
+   thread of the parent may wait for.  It outlives the child
+   process, which has no memory left to keep its exit status in.
+   STATUS should be -1 at first and updated in a call to exit(). */
 struct child_proc
 {
-  struct list_elem elem;      /* For the list CHILDREN in a thread. */
+  struct list_elem elem;      /* In a struct child_list of PARENT. */
   tid_t tid;                  /* Effectively PID. */
-  struct semaphore semaphore; /* Semaphore for process_wait(). */
+  struct proc *parent;        /* Process that started the process, or
+                                 null if a kernel thread did. */
+  bool exited;                /* Has the process exited? */
   int status;                 /* Exit status, default to -1. */
   void **ref;                 /* Reference to the process pointer in thread. */
 };
 
+/* Protects all struct child_procs and the lists they are on. */
+static struct lock children_lock;
+
+/* Children of kernel threads, which have no process to keep them
+   in. */
+static struct child_list kernel_children;
+
+size_t rss_limit_default;
+size_t kmem_limit_default;
+bool oom_kill;
+
+/* How long an allocation waits for processes killed to free
+   memory, in timer ticks. */
+#define OOM_WAIT_TICKS TIMER_FREQ
+
+/* Processes killed by the OOM killer that have not yet freed
+   their memory, the time of the latest kill, and the number of
+   killed processes that have freed it.  Changed with interrupts
+   off. */
+static int oom_pending;
+static int64_t oom_kill_time;
+static unsigned oom_freed_cnt;
+
 static thread_func start_process NO_RETURN;
+static thread_func start_thread NO_RETURN;
+static struct proc *proc_create (void);
+static void proc_destroy (struct proc *);
+static void leave_thread (struct proc *);
+static void add_usage (struct usage *, const struct usage *);
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
-static bool set_user_stack (char *file_name, char *save_path, void **esp);
-static void push_to_user_stack (void **esp, void *src, size_t size);
+static bool set_user_stack (const struct exec_args *, void **esp);
+static struct fd_table *inherit_fd_table (const struct spawn_action *,
+                                          size_t action_cnt);
+static bool set_limits (struct proc *, const struct spawn_action *,
+                        size_t action_cnt);
+static bool oom_reclaim (void);
+static void wake_proc (struct proc *);
+static void free_child (struct child_proc *);
+static void child_list_init (struct child_list *);
+static struct child_list *child_list (struct proc *);
+
+/* A thread started with process_thread_spawn(), kept on its
+   process's THREADS list until it is joined or the process
+   exits. */
+struct user_thread
+  {
+    struct list_elem elem;      /* In THREADS of a struct proc. */
+    tid_t tid;                  /* The thread's id. */
+    int slot;                   /* Its stack slot. */
+    int status;                 /* Value for thread_join(). */
+    bool joined;                /* Being joined already? */
+    struct semaphore done;      /* Upped when the thread exits. */
+  };
 
-/* Argument package for start_process(). */
+/* Argument package for start_process().  The parent frees it
+   after waiting on SEMAPHORE, or the child does if ASYNC. */
 struct child_proc_loader
 {
-  char *fn;
-  struct semaphore semaphore;
-  struct child_proc *proc;
-  bool success;
+  char file[NAME_MAX + 2];      /* Executable to load. */
+  struct exec_args args;        /* Its arguments. */
+  struct semaphore semaphore;   /* Upped once loading is done. */
+  struct child_proc *child;     /* Record kept by the parent. */
+  struct proc *proc;            /* The new process. */
+  struct fd_table *fd_table;    /* Its descriptors. */
+  bool async;                   /* Is the parent not waiting? */
+  bool success;                 /* Was the program loaded? */
 };
 
-/* Starts a new thread running a user program loaded from
-   FILENAME. The new thread may be scheduled (and may even exit)
-   before process_execute() returns.  Returns the new process's
-   thread id, or TID_ERROR if the thread cannot be created. */
+/* Initializes process management. */
+void
+process_init (void)
+{
+  lock_init (&children_lock);
+  child_list_init (&kernel_children);
+}
+
+/* Starts a new thread running the user program named by the
+   first word of CMD_LINE, which must be in kernel memory, with the
+   words of CMD_LINE as its arguments, and waits for it to load.  The new thread may be
+   scheduled (and may even exit) before process_execute()
+   returns.  Returns the new process's thread id, or TID_ERROR if
+   the thread cannot be created or the program cannot be
+   loaded. */
 tid_t
-process_execute (const char *file_name)
+process_execute (const char *cmd_line)
 {
-  char *fn_copy;
-  tid_t tid;
+  struct exec_args args;
 
-  /* Make a copy of FILE_NAME.
-     Otherwise there's a race between the caller and load(). */
-  fn_copy = palloc_get_page (0);
-  if (fn_copy == NULL)
+  /* Split CMD_LINE into a copy.  Otherwise there's a race between
+     the caller and load(). */
+  if (!exec_args_init (&args))
     return TID_ERROR;
-  strlcpy (fn_copy, file_name, PGSIZE);
+  if (!exec_args_parse (&args, cmd_line) || args.argc == 0)
+    {
+      exec_args_destroy (&args);
+      return TID_ERROR;
+    }
 
-  /* Extract FILE_NAME. */
-  char extracted_fn[NAME_MAX + 1];
-  char *tmp;
-  strlcpy (extracted_fn, file_name, NAME_MAX + 1);
-  strtok_r (extracted_fn, " ", &tmp);
+  return process_spawn (exec_args_get (&args, 0), &args, NULL, 0, false);
+}
 
-  /* Create a child process. Status is initialized to -1. */
-  struct child_proc *proc = malloc (sizeof (struct child_proc));
-  proc->status = -1;
-  sema_init (&proc->semaphore, 0);
-  list_push_back (&thread_current ()->children, &proc->elem);
+/* Starts a new thread running the user program in FILE, with the
+   arguments in ARGS, whose memory this function takes over.  The
+   process gets the descriptors that inherit_fd_table() makes for
+   the ACTION_CNT actions in ACTIONS, and the memory limits that
+   set_limits() gives it.  Waits until the
+   program is loaded, unless ASYNC, in which case a program that
+   fails to load exits with status -1.  Returns the new process's
+   thread id, or TID_ERROR if it cannot be started. */
+tid_t
+process_spawn (const char *file, struct exec_args *args,
+               const struct spawn_action *actions, size_t action_cnt,
+               bool async)
+{
+  struct child_proc_loader *loader;
+  struct child_proc *child;
+  bool success;
+  tid_t tid;
 
-  /* Create a new thread to execute FILE_NAME. */
-  struct child_proc_loader loader;
-  loader.fn = fn_copy;
-  loader.proc = proc;
-  loader.success = false;
-  sema_init (&loader.semaphore, 0);
-  tid = thread_create (extracted_fn, PRI_DEFAULT, start_process, &loader);
-  proc->tid = tid;
+  loader = malloc (sizeof *loader);
+  child = malloc (sizeof *child);
+  if (loader != NULL)
+    {
+      strlcpy (loader->file, file, sizeof loader->file);
+      loader->args = *args;
+      loader->proc = proc_create ();
+      loader->fd_table = inherit_fd_table (actions, action_cnt);
+    }
+  if (loader == NULL || child == NULL || loader->proc == NULL
+      || loader->fd_table == NULL
+      || !set_limits (loader->proc, actions, action_cnt))
+    {
+      if (loader != NULL)
+        {
+          if (loader->proc != NULL)
+            proc_destroy (loader->proc);
+          fd_table_destroy (loader->fd_table);
+          free (loader);
+        }
+      free (child);
+      exec_args_destroy (args);
+      return TID_ERROR;
+    }
+
+  /* Create a child process record, linked to the process before
+     it can run, so that the parent may exit at any time.  Status
+     is initialized to -1. */
+  child->parent = thread_current ()->proc;
+  child->exited = false;
+  child->status = -1;
+  child->ref = &loader->proc->parent;
+  loader->proc->parent = child;
+  lock_acquire (&children_lock);
+  list_push_back (&child_list (child->parent)->running, &child->elem);
+  lock_release (&children_lock);
+
+  /* Create a new thread to execute FILE. */
+  loader->child = child;
+  loader->async = async;
+  loader->success = false;
+  sema_init (&loader->semaphore, 0);
+  tid = thread_create (loader->file, PRI_DEFAULT, start_process, loader);
+  child->tid = tid;
 
-  sema_down (&loader.semaphore);
   if (tid == TID_ERROR)
-    palloc_free_page (fn_copy);
-  if (!loader.success)
+    {
+      child->ref = NULL;
+      exec_args_destroy (&loader->args);
+      fd_table_destroy (loader->fd_table);
+      proc_destroy (loader->proc);
+      success = false;
+    }
+  else if (async)
+    return tid;
+  else
+    {
+      sema_down (&loader->semaphore);
+      success = loader->success;
+    }
+  free (loader);
+
+  /* A child that failed to start cannot be waited for, so that
+     waiting for any child never reports it. */
+  if (!success)
+    {
+      lock_acquire (&children_lock);
+      free_child (child);
+      lock_release (&children_lock);
       tid = TID_ERROR;
+    }
   return tid;
 }
 
+/* Removes child record P from its parent's lists and frees it.  If
+   the child process is still running, it will not report its exit
+   status.  CHILDREN_LOCK must be held. */
+static void
+free_child (struct child_proc *p)
+{
+  list_remove (&p->elem);
+  if (p->ref != NULL)
+    *p->ref = NULL;
+  free (p);
+}
+
+/* Initializes LIST as an empty child list. */
+static void
+child_list_init (struct child_list *list)
+{
+  list_init (&list->running);
+  list_init (&list->exited);
+  cond_init (&list->child_exited);
+}
+
+/* Returns the child list of PROC, or that of the kernel's threads
+   if PROC is null. */
+static struct child_list *
+child_list (struct proc *proc)
+{
+  return proc != NULL ? &proc->children : &kernel_children;
+}
+
+/* Creates the descriptor table for a process started by the
+   current thread, holding copies of the current process's console
+   descriptors and of those it marked for inheritance, and applies
+   the ACTION_CNT file actions in ACTIONS to it.  The table has
+   the current process's descriptor limit, or a lower one that a
+   SPAWN_LIMIT_FD action asks for.  Returns a null pointer if
+   memory is short or an action fails. */
+static struct fd_table *
+inherit_fd_table (const struct spawn_action *actions, size_t action_cnt)
+{
+  struct fd_table *parent = thread_current ()->fd_table;
+  struct fd_table *t;
+  size_t limit;
+  bool success;
+  size_t i;
+
+  limit = parent != NULL ? parent->limit : fd_limit_default;
+  for (i = 0; i < action_cnt; i++)
+    if (actions[i].op == SPAWN_LIMIT && actions[i].fd == SPAWN_LIMIT_FD
+        && actions[i].new_fd > 0 && (size_t) actions[i].new_fd < limit)
+      limit = actions[i].new_fd;
+
+  t = fd_table_create (limit);
+  if (t == NULL)
+    return NULL;
+  lock_acquire (&filesys_lock);
+  success = parent == NULL || fd_table_inherit (t, parent);
+  for (i = 0; success && i < action_cnt; i++)
+    {
+      const struct spawn_action *a = &actions[i];
+      switch (a->op)
+        {
+        case SPAWN_DUP2:
+          success = (parent != NULL
+                     && fd_dup_from (t, a->new_fd, parent, a->fd) != -1);
+          break;
+        case SPAWN_CLOSE:
+          success = fd_close (t, a->fd);
+          break;
+        case SPAWN_LIMIT:
+          break;
+        default:
+          success = false;
+          break;
+        }
+    }
+  lock_release (&filesys_lock);
+  if (!success)
+    {
+      fd_table_destroy (t);
+      return NULL;
+    }
+  return t;
+}
+
+/* Lowers the memory limits of PROC as the SPAWN_LIMIT actions
+   among the ACTION_CNT in ACTIONS ask.  Returns false if one of
+   them is not valid.  inherit_fd_table() has already applied
+   SPAWN_LIMIT_FD. */
+static bool
+set_limits (struct proc *proc, const struct spawn_action *actions,
+            size_t action_cnt)
+{
+  size_t i;
+
+  for (i = 0; i < action_cnt; i++)
+    if (actions[i].op == SPAWN_LIMIT)
+      {
+        size_t pages = actions[i].new_fd;
+        size_t *limit;
+
+        if (actions[i].new_fd <= 0)
+          return false;
+        if (actions[i].fd == SPAWN_LIMIT_RSS)
+          limit = &proc->rss_limit;
+        else if (actions[i].fd == SPAWN_LIMIT_KMEM)
+          limit = &proc->kmem_limit;
+        else if (actions[i].fd == SPAWN_LIMIT_FD)
+          continue;
+        else
+          return false;
+        if (*limit == 0 || pages < *limit)
+          *limit = pages;
+      }
+  return true;
+}
+
 /* A thread function that loads a user process and starts it
    running. */
 static void
@@ -101,11 +363,8 @@ start_process (void *loader_)
 {
   struct child_proc_loader *loader = loader_;
   struct thread *t = thread_current ();
-  struct child_proc *p = loader->proc;
-  char *file_name = loader->fn;
-  char *save_path;
-  char *extracted_fn;
   struct intr_frame if_;
+  bool success;
 
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
@@ -113,24 +372,30 @@ start_process (void *loader_)
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
 
-  /* Separate file name from argument. */
-  extracted_fn = strtok_r (file_name, " ", &save_path);
-  loader->success = load (extracted_fn, &if_.eip, &if_.esp);
-  if (loader->success)
-    loader->success = (set_user_stack (extracted_fn, save_path, &if_.esp));
-
-  /* Link the thread's corresponding child_proc. */
-  t->process = p;
-  p->ref = &t->process;
+  t->fd_table = loader->fd_table;
+  t->proc = loader->proc;
+  success = (load (loader->file, &if_.eip, &if_.esp)
+             && set_user_stack (&loader->args, &if_.esp));
+  exec_args_destroy (&loader->args);
 
-  /* Notify process_execute(). */
-  sema_up (&loader->semaphore);
+  /* Notify process_spawn(), or clean up after it. */
+  if (loader->async)
+    free (loader);
+  else
+    {
+      loader->success = success;
+      sema_up (&loader->semaphore);
+    }
 
   /* If load failed, quit. */
-  palloc_free_page (file_name);
-  if (!loader->success)
+  if (!success)
     thread_exit ();
 
+#ifdef VM
+  /* The address space is complete, so it may now be merged. */
+  ksm_enter (t);
+#endif
+
   /* Start the user process by simulating a return from an
      interrupt, implemented by intr_exit (in
      threads/intr-stubs.S).  Because intr_exit takes all of its
@@ -141,69 +406,20 @@ start_process (void *loader_)
   NOT_REACHED ();
 }
 
-/* Pushes a copy of src to the user stack. */
-static void
-push_to_user_stack (void **esp, void *src, size_t size)
-{
-  *esp -= size;
-  memcpy (*esp, src, size);
-}
-/* Tokenizes FILE_NAME and push arguments to the user stack. */
+/* Writes the arguments in ARGS to the user stack at *ESP, the top
+   of user memory, mapping stack pages below the first as needed.
+   Returns false if memory is short. */
 static bool
-set_user_stack (char *file_name, char *save_path, void **esp)
-{
-  char *token;
-  int argc = 1;
-  void *sp;
-  void *base = *esp;
-  char *null_addr = NULL;
-
-  /* Push the file name. */
-  push_to_user_stack (esp, file_name, strlen (file_name) + 1);
-
-  /* Push arguments. */
-  while ((token = strtok_r (NULL, " ", &save_path)) != NULL)
-    {
-      argc++;
-
-      /* The PintOS implementation of strtok_r() saves the pointer
-         to the final char to SAVE_PTR when reaching the end of
-         string. We add the additional 1 (which is !*save_path) in
-         this case to get token length. */
-      size_t len = (size_t)(save_path - token) + !*save_path;
-
-      /* Check if stack exceeds page limit after pushing.
-         Includev 4 extras - RETADDR, ARGC, ARGV and NULL pointer. */
-      sp = *esp - len;
-      sp = (void *)(((uint32_t)sp >> 2) << 2);
-      sp = sp - (argc + 4) * sizeof (void *);
-      if (base - sp >= PGSIZE)
-        return false;
-
-      push_to_user_stack (esp, token, len);
-    }
-  sp = *esp;
-
-  /* Round down the address for word-alignment. */
-  *esp = (void *)(((uint32_t)*esp >> 2) << 2);
-  memset (*esp, 0, sp - *esp);
-
-  /* Push the address of arguments. */
-  push_to_user_stack (esp, &null_addr, sizeof (char *));
-  for (int i = 0; i < argc; i++)
-    {
-      push_to_user_stack (esp, &sp, sizeof (char *));
-      sp += (strlen (sp) + 1);
-    }
-  sp = *esp;
-  push_to_user_stack (esp, &sp, sizeof (char **));
-
-  /* Push ARGC. */
-  push_to_user_stack (esp, &argc, sizeof (int));
-
-  /* Push the return address */
-  push_to_user_stack (esp, &null_addr, sizeof (void *));
-
+set_user_stack (const struct exec_args *args, void **esp)
+{
+  uint8_t *top = *esp;
+  uint8_t *upage;
+
+  for (upage = pg_round_down (top - exec_args_stack_size (args));
+       upage < top - PGSIZE; upage += PGSIZE)
+    if (!process_map_page (upage))
+      return false;
+  *esp = exec_args_write (args, top);
   return true;
 }
 
@@ -212,84 +428,193 @@ set_user_stack (char *file_name, char *save_path, void **esp)
  * returns -1.
  * If TID is invalid or if it was not a child of the calling process, or if
  * process_wait() has already been successfully called for the given TID,
- * returns -1 immediately, without waiting.
- *
- * This function will be implemented in task 2.
- * For now, it does nothing. */
+ * returns -1 immediately, without waiting. */
 int
 process_wait (tid_t child_tid)
 {
+  int status;
+
+  if (child_tid == -1
+      || process_waitpid (child_tid, &status, false) != child_tid)
+    return -1;
+  return status;
+}
+
+/* Returns the child record for process TID in CHILDREN, or a null
+   pointer if there is none.  CHILDREN_LOCK must be held. */
+static struct child_proc *
+find_child (struct child_list *children, tid_t tid)
+{
+  struct list *lists[] = {&children->running, &children->exited};
   struct list_elem *e;
-  struct list *children = &thread_current ()->children;
+  size_t i;
+
+  for (i = 0; i < sizeof lists / sizeof *lists; i++)
+    for (e = list_begin (lists[i]); e != list_end (lists[i]);
+         e = list_next (e))
+      {
+        struct child_proc *p = list_entry (e, struct child_proc, elem);
+        if (p->tid == tid)
+          return p;
+      }
+  return NULL;
+}
 
-  for (e = list_begin (children); e != list_end (children); e = list_next (e))
+/* Waits for child process PID of the current process to exit, or
+   for any child if PID is -1, and stores its exit status into
+   *STATUS.  Children exit onto a queue, so waiting for any child
+   reaps them in the order they exited.  Returns the pid of the
+   child reaped, or -1 if there is no such child, or if another
+   thread reaped it first.  If NOHANG is true and the child has
+   not exited yet, returns 0 at once instead of waiting, and
+   likewise if the current process exits while waiting. */
+tid_t
+process_waitpid (tid_t pid, int *status, bool nohang)
+{
+  struct proc *proc = thread_current ()->proc;
+  struct child_list *children = child_list (proc);
+  const bool *exiting = proc != NULL ? &proc->exiting : NULL;
+  struct child_proc *p = NULL;
+  tid_t result;
+  bool found;
+
+  lock_acquire (&children_lock);
+  if (pid != -1)
+    {
+      /* Look the child up again after each wait, because another
+         thread of the process may have reaped it. */
+      while ((p = find_child (children, pid)) != NULL
+             && !p->exited && !nohang)
+        if (!cond_wait_unless (&children->child_exited, &children_lock,
+                               exiting))
+          break;
+      found = p != NULL;
+    }
+  else
     {
-      struct child_proc *proc = list_entry (e, struct child_proc, elem);
-      if (child_tid == proc->tid)
+      found = (!list_empty (&children->running)
+               || !list_empty (&children->exited));
+      while (found && list_empty (&children->exited) && !nohang)
         {
-          sema_down (&proc->semaphore);
-          int status = proc->status;
-          list_remove (&proc->elem);
-          free (proc);
-          return status;
+          if (!cond_wait_unless (&children->child_exited, &children_lock,
+                                 exiting))
+            break;
+          found = (!list_empty (&children->running)
+                   || !list_empty (&children->exited));
         }
+      if (!list_empty (&children->exited))
+        p = list_entry (list_front (&children->exited),
+                        struct child_proc, elem);
     }
-  return -1;
+
+  if (!found)
+    result = -1;
+  else if (p == NULL || !p->exited)
+    result = 0;
+  else
+    {
+      list_remove (&p->elem);
+      result = p->tid;
+      *status = p->status;
+      free (p);
+    }
+  lock_release (&children_lock);
+  return result;
 }
 
-/* Frees the current process's resources and releases saved child
-   processes information. */
+/* Exits the current thread, and frees the current process's
+   resources, including its children's records, if it is the last
+   thread of the process. */
 void
 process_exit (void)
 {
   struct thread *t = thread_current ();
+  struct proc *proc = t->proc;
+  struct child_proc *process;
+  enum intr_level old_level;
   uint32_t *pd;
-  struct list_elem *e;
-  struct list *children = &thread_current ()->children;
-  struct list *files = &thread_current ()->files;
-  struct child_proc *process = t->process;
+  bool last = true;
 
-  /* Close the running executable file. NULL check and allow write
-     already performed by file_close(). */
-  file_close (t->exec_file);
-
-  /* Close all opened files. */
-  while (!list_empty (files))
+  if (proc != NULL)
     {
-      e = list_begin (files);
-      struct user_file *file = list_entry (e, struct user_file, elem);
-      file_close (file->file);
-      list_remove (e);
-      free (file);
+      /* Give up our stack, and let a joiner see that we are gone. */
+      leave_thread (proc);
+
+      /* Let go of PROC, which the last thread to do so frees, so
+         that a scan of all threads never finds it freed. */
+      lock_acquire (&proc->lock);
+      t->proc = NULL;
+      last = --proc->ref_cnt == 0;
+      lock_release (&proc->lock);
     }
 
-  /* Release all remaining children information. */
-  while (!list_empty (children))
+  if (last && proc != NULL)
     {
-      e = list_begin (children);
-      struct child_proc *p = list_entry (e, struct child_proc, elem);
-      list_remove (e);
-      if (p->ref != NULL)
+      /* Close the running executable file. NULL check and allow write
+         already performed by file_close(). */
+      file_close (proc->exec_file);
+
+      /* Stop the ring worker, which uses our files and memory
+         and PROC itself.  A call it runs may be blocked, so
+         wake it up the same way as our own threads. */
+      if (proc->ring != NULL)
         {
-          *p->ref = NULL;
+          proc->exiting = true;
+          wake_proc (proc);
+          ring_destroy (proc->ring);
+          proc->ring = NULL;
         }
-      free (p);
-    }
 
-  if (process != NULL)
-    {
-      /* Print process exit message. */
-      printf ("%s: exit(%d)\n", t->name, process->status);
+      /* Close all opened files. */
+      fd_table_destroy (t->fd_table);
+
+      lock_acquire (&children_lock);
+      process = proc->parent;
+      if (process != NULL)
+        {
+          /* Print process exit message. */
+          printf ("%s: exit(%d)\n", t->name, proc->status);
+          process->status = proc->status;
+          process->exited = true;
 
-      /* Prevent parent removing process reference. */
-      process->ref = NULL;
+          /* Prevent parent removing process reference. */
+          process->ref = NULL;
 
-      /* Inform parent to retrieve exit status. */
-      sema_up (&process->semaphore);
+          /* Add our usage, and that of our children, to the
+             parent's. */
+          if (process->parent != NULL)
+            {
+              struct proc *parent = process->parent;
+              lock_acquire (&parent->lock);
+              add_usage (&parent->child_usage, &proc->usage);
+              add_usage (&parent->child_usage, &proc->child_usage);
+              lock_release (&parent->lock);
+            }
+
+          /* Queue up for the parent to retrieve exit status.  Any
+             of its threads may be waiting. */
+          list_remove (&process->elem);
+          list_push_back (&child_list (process->parent)->exited,
+                          &process->elem);
+          cond_broadcast (&child_list (process->parent)->child_exited,
+                          &children_lock);
+        }
+
+      /* Release all remaining children information. */
+      while (!list_empty (&proc->children.running))
+        free_child (list_entry (list_front (&proc->children.running),
+                                struct child_proc, elem));
+      while (!list_empty (&proc->children.exited))
+        free_child (list_entry (list_front (&proc->children.exited),
+                                struct child_proc, elem));
+      lock_release (&children_lock);
     }
+  else if (last)
+    fd_table_destroy (t->fd_table);
+  t->fd_table = NULL;
 
-  /* Destroy the current process's page directory and switch back
-     to the kernel-only page directory. */
+  /* Switch back to the kernel-only page directory, and destroy
+     the current process's if no other thread is using it. */
   pd = t->pagedir;
   if (pd != NULL)
     {
@@ -300,9 +625,28 @@ process_exit (void)
          directory before destroying the process's page
          directory, or our active page directory will be one
          that's been freed (and cleared). */
+#ifdef VM
+      ksm_exit (t);
+#endif
       t->pagedir = NULL;
       pagedir_activate (NULL);
-      pagedir_destroy (pd);
+      if (last)
+        pagedir_destroy (pd);
+    }
+
+  if (last && proc != NULL)
+    {
+      /* No thread refers to PROC any longer, so the OOM killer
+         cannot pick it now.  If it did before, let the processes
+         waiting for memory know that it is free. */
+      old_level = intr_disable ();
+      if (proc->oom_killed)
+        {
+          oom_pending--;
+          oom_freed_cnt++;
+        }
+      intr_set_level (old_level);
+      proc_destroy (proc);
     }
 }
 
@@ -314,24 +658,719 @@ process_activate (void)
 {
   struct thread *t = thread_current ();
 
-  /* Activate thread's page tables. */
-  pagedir_activate (t->pagedir);
+  /* Activate thread's page tables.  Kernel threads never touch
+     user memory, except for ring workers, which set PAGEDIR while
+     they borrow a process's, so they simply keep whichever page
+     directory is loaded instead of flushing the TLB to load
+     init_page_dir.
+     A process's page directory is only destroyed by the process
+     itself, after switching away from it in process_exit(). */
+  if (t->pagedir != NULL)
+    pagedir_activate (t->pagedir);
 
   /* Set thread's kernel stack for use in processing
      interrupts. */
   tss_update ();
 }
 
-/* Passes STATUS back to parent. Does nothing if the parent is
-   no longer maintaining the process. */
+/* Ends the current process with STATUS.  The other threads of
+   the process exit the next time they would return to user mode,
+   which threads blocked in the kernel are woken up for, and the
+   last one to go reports STATUS to the parent. */
+void
+process_terminate (int status)
+{
+  struct proc *proc = thread_current ()->proc;
+
+  if (proc != NULL)
+    {
+      lock_acquire (&proc->lock);
+      if (!proc->exiting)
+        {
+          proc->exiting = true;
+          proc->status = status;
+        }
+      lock_release (&proc->lock);
+      wake_proc (proc);
+    }
+  thread_exit ();
+}
+
+/* Wakes up thread T if it belongs to process PROC_ and is in a
+   wait that gives up when the process exits.  Called by
+   thread_foreach(). */
+static void
+wake_thread (struct thread *t, void *proc_)
+{
+  struct proc *proc = proc_;
+
+  if (t->proc == proc)
+    sema_cancel_wait (t);
+}
+
+/* Wakes up every thread of PROC that is blocked in futex_wait()
+   or in a sema_down_unless() or cond_wait_unless() that gives up
+   if PROC exits, so that it notices PROC is exiting.  Takes no
+   locks, so it may be called with any held. */
+static void
+wake_proc (struct proc *proc)
+{
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  futex_wake_proc (proc);
+  thread_foreach (wake_thread, proc);
+  intr_set_level (old_level);
+}
+
+/* Exits the current thread if its process is exiting.  Called
+   just before returning to user mode, possibly with interrupts
+   off. */
+void
+process_check_exit (void)
+{
+  struct proc *proc = thread_current ()->proc;
+
+  if (proc != NULL && proc->exiting)
+    {
+      intr_enable ();
+      thread_exit ();
+    }
+}
+
+/* Maps a new zeroed, writable page at UPAGE in the current
+   process, unless another thread of the process has mapped one
+   there in the meantime.  Returns true if UPAGE is mapped
+   afterward, false if memory is short or the process is at its
+   limit. */
+bool
+process_map_page (void *upage)
+{
+  struct thread *t = thread_current ();
+  struct proc *proc = t->proc;
+  void *kpage;
+  bool success, retry;
+
+  kpage = process_get_page (PAL_ZERO);
+  if (kpage == NULL)
+    return false;
+
+  do
+    {
+      lock_acquire (&proc->lock);
+      retry = false;
+      if (pagedir_get_page (t->pagedir, upage) != NULL)
+        success = true;
+      else if (process_install_page (upage, kpage, true))
+        {
+          kpage = NULL;
+          success = true;
+        }
+      else
+        {
+          /* Unless the process is at its limit, there was no
+             memory for a page table, which the OOM killer could
+             not wait for while we held the lock. */
+          success = false;
+          retry = process_charge_mem (proc, 1, 1);
+          if (retry)
+            process_uncharge_mem (proc, 1, 1);
+        }
+      lock_release (&proc->lock);
+    }
+  while (retry && oom_reclaim ());
+
+  if (kpage != NULL)
+    palloc_free_page (kpage);
+  return success;
+}
+
+/* Adds a mapping from user virtual address UPAGE to kernel
+   virtual address KPAGE to the current process's page table, and
+   charges the page, and the page table if a new one is needed, to
+   the process.
+   If WRITABLE is true, the user process may modify the page;
+   otherwise, it is read-only.
+   KPAGE should probably be a page obtained from the user pool
+   with process_get_page().
+   Returns true on success, false if UPAGE is already mapped, if
+   the process is at its limit, or if memory allocation fails. */
+bool
+process_install_page (void *upage, void *kpage, bool writable)
+{
+  struct thread *t = thread_current ();
+  size_t tables;
+
+  /* Verify that there's not already a page at that virtual
+     address, then map our page there. */
+  if (pagedir_get_page (t->pagedir, upage) != NULL)
+    return false;
+  tables = !pagedir_has_table (t->pagedir, upage);
+  if (!process_charge_mem (t->proc, 1, tables))
+    return false;
+  while (!pagedir_set_page (t->pagedir, upage, kpage, writable))
+    if (!oom_reclaim ())
+      {
+        process_uncharge_mem (t->proc, 1, tables);
+        return false;
+      }
+  return true;
+}
+
+/* Obtains a page from the user pool for the current process,
+   passing FLAGS on to palloc_get_page().  If the pool is
+   exhausted, the OOM killer may make room (see oom_reclaim()).
+   Returns the page's kernel virtual address, or a null pointer if
+   memory is short. */
+void *
+process_get_page (enum palloc_flags flags)
+{
+  void *kpage;
+
+  while ((kpage = palloc_get_page (PAL_USER | flags)) == NULL
+         && oom_reclaim ())
+    continue;
+  return kpage;
+}
+
+/* Charges RSS pages of user memory and KMEM pages of kernel memory
+   to PROC.  Returns true if successful, false without charging
+   anything if PROC would exceed one of its limits. */
+bool
+process_charge_mem (struct proc *proc, size_t rss, size_t kmem)
+{
+  enum intr_level old_level;
+  bool success;
+
+  old_level = intr_disable ();
+  success = ((proc->rss_limit == 0
+              || proc->rss + proc->held_cnt + rss <= proc->rss_limit)
+             && (proc->kmem_limit == 0
+                 || proc->kmem + kmem <= proc->kmem_limit));
+  if (success)
+    {
+      proc->rss += rss;
+      proc->kmem += kmem;
+    }
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Takes back a charge made with process_charge_mem(). */
+void
+process_uncharge_mem (struct proc *proc, size_t rss, size_t kmem)
+{
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  ASSERT (proc->rss >= rss && proc->kmem >= kmem);
+  proc->rss -= rss;
+  proc->kmem -= kmem;
+  intr_set_level (old_level);
+}
+
+/* Charges PAGES pages of user data to PROC that PROC does not map,
+   for an object that may outlive PROC, such as a pipe buffer.
+   They count against PROC's RSS limit, but are reported apart
+   from its RSS.  The object keeps PROC's struct proc from being
+   freed until it gives the charge back with
+   process_uncharge_held().  Returns true if successful, false if
+   PROC would exceed its limit. */
+bool
+process_charge_held (struct proc *proc, size_t pages)
+{
+  enum intr_level old_level;
+  bool success;
+
+  old_level = intr_disable ();
+  success = (proc->rss_limit == 0
+             || proc->rss + proc->held_cnt + pages <= proc->rss_limit);
+  if (success)
+    proc->held_cnt += pages;
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Takes back a charge made with process_charge_held(), and frees
+   PROC if it was the last one and PROC's threads are gone. */
+void
+process_uncharge_held (struct proc *proc, size_t pages)
+{
+  enum intr_level old_level;
+  bool dead;
+
+  old_level = intr_disable ();
+  ASSERT (proc->held_cnt >= pages);
+  proc->held_cnt -= pages;
+  dead = proc->held_cnt == 0 && proc->destroyed;
+  intr_set_level (old_level);
+
+  if (dead)
+    free (proc);
+}
+
+/* The process using the most memory, for oom_scan(). */
+struct oom_victim
+  {
+    struct proc *proc;          /* The process, or a null pointer. */
+    size_t pages;               /* Its RSS, held and kernel pages. */
+    size_t held;                /* Its held pages. */
+    char name[16];              /* Name of one of its threads. */
+  };
+
+/* Makes the process of thread T the victim in AUX, a struct
+   oom_victim, if it uses more memory than the current one and is
+   not exiting already. */
+static void
+oom_scan (struct thread *t, void *aux)
+{
+  struct oom_victim *v = aux;
+  struct proc *proc = t->proc;
+  size_t pages;
+
+  if (proc == NULL || proc->exiting)
+    return;
+  pages = proc->rss + proc->held_cnt + proc->kmem;
+  if (pages > v->pages)
+    {
+      v->proc = proc;
+      v->pages = pages;
+      v->held = proc->held_cnt;
+      strlcpy (v->name, t->name, sizeof v->name);
+    }
+}
+
+/* Called when memory for the current process has run out.  First
+   empties the exec cache, if it holds anything.  Otherwise, if
+   the OOM killer is enabled, kills the process that uses the most
+   memory, unless it is the current one or a process killed
+   earlier is still on its way out, and waits for a killed process
+   to free its memory.  Returns true if one did, so that the
+   allocation is worth retrying, false if it should fail.
+
+   A victim may need a lock that the current thread holds in order
+   to exit, so a thread that holds any lock does not wait, and the
+   allocation fails instead.  The caller may retry once it has let
+   go of its locks, as process_map_page() does. */
+static bool
+oom_reclaim (void)
+{
+  struct proc *cur = thread_current ()->proc;
+  enum intr_level old_level;
+  struct oom_victim v;
+  unsigned freed_cnt;
+  bool pending;
+  int64_t start;
+
+  /* Cached executables are the cheapest memory to give back. */
+  if (exec_cache_shrink ())
+    return true;
+
+  if (!oom_kill || cur == NULL || cur->exiting)
+    return false;
+
+  v.proc = NULL;
+  v.pages = 0;
+  old_level = intr_disable ();
+  freed_cnt = oom_freed_cnt;
+  if (oom_pending == 0 || timer_elapsed (oom_kill_time) >= OOM_WAIT_TICKS)
+    {
+      thread_foreach (oom_scan, &v);
+      if (v.proc == cur)
+        v.proc = NULL;
+      else if (v.proc != NULL)
+        {
+          v.proc->exiting = true;
+          v.proc->status = -1;
+          v.proc->oom_killed = true;
+          oom_pending++;
+          oom_kill_time = timer_ticks ();
+          wake_proc (v.proc);
+        }
+    }
+  pending = oom_pending > 0;
+  intr_set_level (old_level);
+
+  if (v.proc != NULL)
+    printf ("oom: killed %s, using %zu pages (%zu held)\n",
+            v.name, v.pages, v.held);
+  if (!pending || !list_empty (&thread_current ()->locks))
+    return false;
+
+  start = timer_ticks ();
+  while (oom_freed_cnt == freed_cnt && timer_elapsed (start) < OOM_WAIT_TICKS)
+    timer_sleep (1);
+  return oom_freed_cnt != freed_cnt;
+}
+
+/* Adds the counts in FROM to those in TO. */
+static void
+add_usage (struct usage *to, const struct usage *from)
+{
+  to->user_ticks += from->user_ticks;
+  to->sys_ticks += from->sys_ticks;
+  to->vol_switches += from->vol_switches;
+  to->invol_switches += from->invol_switches;
+  to->min_flt += from->min_flt;
+  to->maj_flt += from->maj_flt;
+  to->read_bytes += from->read_bytes;
+  to->write_bytes += from->write_bytes;
+  to->syscalls += from->syscalls;
+}
+
+/* Adds USAGE, used on behalf of PROC by a thread that does not
+   belong to it, to PROC's usage and resets USAGE. */
+void
+process_charge (struct proc *proc, struct usage *usage)
+{
+  lock_acquire (&proc->lock);
+  add_usage (&proc->usage, usage);
+  lock_release (&proc->lock);
+  memset (usage, 0, sizeof *usage);
+}
+
+/* thread_foreach() helper for process_get_usage(). */
+struct usage_sum
+  {
+    struct proc *proc;          /* Process whose threads to add up. */
+    struct usage *usage;        /* Sum. */
+  };
+
+/* Adds T's usage to AUX's sum, if T belongs to AUX's process. */
+static void
+sum_thread_usage (struct thread *t, void *aux)
+{
+  struct usage_sum *sum = aux;
+
+  if (t->proc == sum->proc)
+    add_usage (sum->usage, &t->usage);
+}
+
+/* Stores into *USAGE the resources used so far by the current
+   process, or if CHILDREN is true, by its child processes that
+   have exited, including their own children. */
 void
-process_pass_status (int status, void *process_)
+process_get_usage (bool children, struct usage *usage)
+{
+  struct proc *proc = thread_current ()->proc;
+
+  /* Holding the lock keeps threads from moving their usage into
+     PROC while we add it up. */
+  lock_acquire (&proc->lock);
+  if (children)
+    *usage = proc->child_usage;
+  else
+    {
+      struct usage_sum sum = {proc, usage};
+      enum intr_level old_level;
+
+      *usage = proc->usage;
+      old_level = intr_disable ();
+      thread_foreach (sum_thread_usage, &sum);
+      intr_set_level (old_level);
+    }
+  lock_release (&proc->lock);
+}
+
+/* Returns a new struct proc for a process being loaded, or a
+   null pointer if memory is short. */
+static struct proc *
+proc_create (void)
+{
+  struct proc *parent = thread_current ()->proc;
+  struct proc *proc = malloc (sizeof *proc);
+
+  if (proc == NULL)
+    return NULL;
+  proc->ref_cnt = 1;
+  lock_init (&proc->lock);
+  proc->parent = NULL;
+  proc->status = -1;
+  proc->exiting = false;
+  proc->exec_file = NULL;
+  proc->ring = NULL;
+  proc->heap_start = proc->heap_brk = NULL;
+  proc->shm_end = HEAP_LIMIT;
+  proc->stack_slots = 0;
+  memset (&proc->usage, 0, sizeof proc->usage);
+  memset (&proc->child_usage, 0, sizeof proc->child_usage);
+  list_init (&proc->threads);
+  child_list_init (&proc->children);
+  proc->rss = 0;
+  proc->kmem = 1;               /* The first thread. */
+  proc->rss_limit = parent != NULL ? parent->rss_limit : rss_limit_default;
+  proc->kmem_limit = (parent != NULL ? parent->kmem_limit
+                      : kmem_limit_default);
+  proc->oom_killed = false;
+  proc->held_cnt = 0;
+  proc->destroyed = false;
+  return proc;
+}
+
+/* Frees PROC, once its last thread has exited, or leaves it for
+   process_uncharge_held() to free if objects charged to it with
+   process_charge_held() remain. */
+static void
+proc_destroy (struct proc *proc)
+{
+  enum intr_level old_level;
+  bool held;
+
+  ASSERT (proc->ring == NULL);
+  while (!list_empty (&proc->threads))
+    free (list_entry (list_pop_front (&proc->threads),
+                      struct user_thread, elem));
+
+  old_level = intr_disable ();
+  held = proc->held_cnt > 0;
+  proc->destroyed = true;
+  intr_set_level (old_level);
+  if (!held)
+    free (proc);
+}
+
+/* Returns the thread TID of PROC, or a null pointer if TID was
+   not spawned in PROC or has been joined.  PROC's lock must be
+   held. */
+static struct user_thread *
+find_thread (struct proc *proc, tid_t tid)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&proc->threads); e != list_end (&proc->threads);
+       e = list_next (e))
+    {
+      struct user_thread *ut = list_entry (e, struct user_thread, elem);
+      if (ut->tid == tid)
+        return ut;
+    }
+  return NULL;
+}
+
+/* Unmaps and frees the pages of stack slot SLOT in the current
+   process.  The process's lock must be held. */
+static void
+free_stack (int slot)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  uint8_t *top = THREAD_STACKS_TOP - slot * THREAD_STACK_SIZE;
+  uint8_t *upage;
+
+  for (upage = top - THREAD_STACK_SIZE; upage < top; upage += PGSIZE)
+    {
+      enum intr_level old_level;
+      void *kpage;
+
+      /* Same-page merging changes mappings with interrupts off. */
+      old_level = intr_disable ();
+      kpage = pagedir_get_page (pd, upage);
+      if (kpage != NULL)
+        pagedir_clear_page (pd, upage);
+      intr_set_level (old_level);
+
+      if (kpage != NULL)
+        {
+          palloc_free_page (kpage);
+          process_uncharge_mem (thread_current ()->proc, 1, 0);
+        }
+    }
+}
+
+/* Called by every thread of PROC as it exits.  Charges the
+   thread's usage to PROC, and if the thread was spawned, frees
+   its stack and wakes up its joiner. */
+static void
+leave_thread (struct proc *proc)
 {
-  if (process_ != NULL)
+  struct user_thread *ut;
+
+  lock_acquire (&proc->lock);
+  add_usage (&proc->usage, &thread_current ()->usage);
+  ut = find_thread (proc, thread_current ()->tid);
+  if (ut != NULL)
+    {
+      free_stack (ut->slot);
+      proc->stack_slots &= ~(1ULL << ut->slot);
+      sema_up (&ut->done);
+    }
+  lock_release (&proc->lock);
+  process_uncharge_mem (proc, 0, 1);
+}
+
+/* Argument package for start_thread(). */
+struct thread_loader
   {
-    struct child_proc *process = process_;
-    process->status = status;
-  }
+    uint32_t *pagedir;          /* Process's page directory. */
+    struct fd_table *fd_table;  /* Process's descriptors. */
+    struct proc *proc;          /* Process. */
+    struct user_thread *ut;     /* The new thread's record. */
+    void *eip;                  /* Where to start in user mode. */
+    void *esp;                  /* Initial user stack pointer. */
+    struct semaphore started;   /* Upped once the above are copied. */
+  };
+
+/* Starts a new thread in the current process, which calls START
+   with ARG0 and ARG1 as its arguments on a stack of its own.
+   START must not return.  Returns the new thread's id, or
+   TID_ERROR if there is no free stack slot, memory is short, or
+   the process is exiting. */
+tid_t
+process_thread_spawn (void *start, void *arg0, void *arg1)
+{
+  struct thread *t = thread_current ();
+  struct proc *proc = t->proc;
+  struct thread_loader loader;
+  struct user_thread *ut;
+  uint32_t *kpage;
+  uint8_t *top;
+  tid_t tid;
+  int slot;
+
+  if (!process_charge_mem (proc, 0, 1))
+    return TID_ERROR;
+  ut = malloc (sizeof *ut);
+  kpage = process_get_page (PAL_ZERO);
+  if (ut == NULL || kpage == NULL)
+    goto fail;
+  ut->tid = TID_ERROR;
+  ut->status = -1;
+  ut->joined = false;
+  sema_init (&ut->done, 0);
+
+  /* The new stack's top page holds the arguments for START, above
+     a null return address. */
+  kpage[PGSIZE / sizeof *kpage - 1] = (uint32_t) arg1;
+  kpage[PGSIZE / sizeof *kpage - 2] = (uint32_t) arg0;
+
+  lock_acquire (&proc->lock);
+  for (slot = 0; slot < THREAD_STACK_CNT; slot++)
+    if ((proc->stack_slots & (1ULL << slot)) == 0)
+      break;
+  top = THREAD_STACKS_TOP - slot * THREAD_STACK_SIZE;
+  if (proc->exiting || slot == THREAD_STACK_CNT
+      || !process_install_page (top - PGSIZE, kpage, true))
+    {
+      lock_release (&proc->lock);
+      goto fail;
+    }
+  kpage = NULL;
+  ut->slot = slot;
+  proc->stack_slots |= 1ULL << slot;
+  proc->ref_cnt++;
+  list_push_back (&proc->threads, &ut->elem);
+  lock_release (&proc->lock);
+
+  loader.pagedir = t->pagedir;
+  loader.fd_table = t->fd_table;
+  loader.proc = proc;
+  loader.ut = ut;
+  loader.eip = start;
+  loader.esp = top - 3 * sizeof (uint32_t);
+  sema_init (&loader.started, 0);
+  tid = thread_create (t->name, thread_get_priority (), start_thread, &loader);
+  if (tid == TID_ERROR)
+    {
+      lock_acquire (&proc->lock);
+      free_stack (slot);
+      proc->stack_slots &= ~(1ULL << slot);
+      proc->ref_cnt--;
+      list_remove (&ut->elem);
+      lock_release (&proc->lock);
+      process_uncharge_mem (proc, 0, 1);
+      free (ut);
+      return TID_ERROR;
+    }
+  sema_down (&loader.started);
+  return tid;
+
+ fail:
+  if (kpage != NULL)
+    palloc_free_page (kpage);
+  free (ut);
+  process_uncharge_mem (proc, 0, 1);
+  return TID_ERROR;
+}
+
+/* A thread function that enters user mode in a thread started by
+   process_thread_spawn(). */
+static void
+start_thread (void *loader_)
+{
+  struct thread_loader *loader = loader_;
+  struct thread *t = thread_current ();
+  struct intr_frame if_;
+
+  t->pagedir = loader->pagedir;
+  t->fd_table = loader->fd_table;
+  t->proc = loader->proc;
+  loader->ut->tid = t->tid;
+  process_activate ();
+
+  memset (&if_, 0, sizeof if_);
+  if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
+  if_.cs = SEL_UCSEG;
+  if_.eflags = FLAG_IF | FLAG_MBS;
+  if_.eip = loader->eip;
+  if_.esp = loader->esp;
+  sema_up (&loader->started);
+
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g"(&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Waits for thread TID of the current process to exit and
+   returns the value it passed to process_thread_exit(), or -1 if
+   it was killed.  Returns -1 at once if TID was not spawned in
+   this process, is the current thread, or has already been
+   joined. */
+int
+process_thread_join (tid_t tid)
+{
+  struct proc *proc = thread_current ()->proc;
+  struct user_thread *ut;
+  int status;
+
+  lock_acquire (&proc->lock);
+  ut = find_thread (proc, tid);
+  if (ut == NULL || ut->joined || tid == thread_current ()->tid)
+    {
+      lock_release (&proc->lock);
+      return -1;
+    }
+  ut->joined = true;
+  lock_release (&proc->lock);
+
+  /* Give up if the process exits first, leaving UT for
+     proc_destroy() to free. */
+  if (!sema_down_unless (&ut->done, &proc->exiting))
+    return -1;
+
+  lock_acquire (&proc->lock);
+  list_remove (&ut->elem);
+  lock_release (&proc->lock);
+  status = ut->status;
+  free (ut);
+  return status;
+}
+
+/* Exits the current thread, leaving STATUS for a joiner.  The
+   process goes on as long as it has other threads; if this was
+   the last, it exits with STATUS. */
+void
+process_thread_exit (int status)
+{
+  struct thread *t = thread_current ();
+  struct proc *proc = t->proc;
+  struct user_thread *ut;
+
+  lock_acquire (&proc->lock);
+  ut = find_thread (proc, t->tid);
+  if (ut != NULL)
+    ut->status = status;
+  if (!proc->exiting)
+    proc->status = status;
+  lock_release (&proc->lock);
+  thread_exit ();
 }
 
 /* We load ELF binaries.  The following definitions are taken
@@ -398,10 +1437,12 @@ struct Elf32_Phdr
 #define PF_R 4          /* Readable. */
 
 static bool setup_stack (void **esp);
+static bool map_clock_page (void);
 static bool validate_segment (const struct Elf32_Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
                           uint32_t read_bytes, uint32_t zero_bytes,
                           bool writable);
+static bool map_image (const struct exec_image *);
 
 /* Loads an ELF executable from FILE_NAME into the current thread.
    Stores the executable's entry point into *EIP
@@ -413,11 +1454,17 @@ load (const char *file_name, void (**eip) (void), void **esp)
   struct thread *t = thread_current ();
   struct Elf32_Ehdr ehdr;
   struct file *file = NULL;
+  struct exec_image *image = NULL;
+  struct exec_segment *segs = NULL;
+  size_t seg_cnt = 0;
   off_t file_ofs;
+  uint8_t *seg_end = NULL;
   bool success = false;
   int i;
 
   /* Allocate and activate page directory. */
+  if (!process_charge_mem (t->proc, 0, PAGEDIR_PAGES))
+    goto done;
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL) 
     goto done;
@@ -431,9 +1478,23 @@ load (const char *file_name, void (**eip) (void), void **esp)
       goto done; 
     }
   
-  t->exec_file = file;
+  t->proc->exec_file = file;
   file_deny_write (file);
 
+  /* Find it in the exec cache. */
+  image = exec_cache_lookup (file);
+
+  /* A cached image was validated when it was first loaded, and its
+     pages with file data are still in memory. */
+  if (image != NULL)
+    {
+      if (!map_image (image))
+        goto done;
+      ehdr.e_entry = (Elf32_Addr) image->entry;
+      seg_end = image->seg_end;
+      goto loaded;
+    }
+
   /* Read and verify executable header. */
   if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
       || memcmp (ehdr.e_ident, "\177ELF\1\1\1", 7)
@@ -446,6 +1507,9 @@ load (const char *file_name, void (**eip) (void), void **esp)
       printf ("load: %s: error loading executable\n", file_name);
       goto done; 
     }
+  segs = malloc (ehdr.e_phnum * sizeof *segs);
+  if (segs == NULL && ehdr.e_phnum > 0)
+    goto done;
 
   /* Read program headers. */
   file_ofs = ehdr.e_phoff;
@@ -499,6 +1563,13 @@ load (const char *file_name, void (**eip) (void), void **esp)
               if (!load_segment (file, file_page, (void *) mem_page,
                                  read_bytes, zero_bytes, writable))
                 goto done;
+              if ((uint8_t *) mem_page + read_bytes + zero_bytes > seg_end)
+                seg_end = (uint8_t *) mem_page + read_bytes + zero_bytes;
+              segs[seg_cnt].upage = (uint8_t *) mem_page;
+              segs[seg_cnt].read_size = ROUND_UP (read_bytes, PGSIZE);
+              segs[seg_cnt].size = read_bytes + zero_bytes;
+              segs[seg_cnt].writable = writable;
+              seg_cnt++;
             }
           else
             goto done;
@@ -506,10 +1577,23 @@ load (const char *file_name, void (**eip) (void), void **esp)
         }
     }
 
+  /* Cache the image for the next exec, while its pages are
+     still untouched. */
+  exec_cache_insert (file, t->pagedir, (void (*) (void)) ehdr.e_entry,
+                     seg_end, segs, seg_cnt);
+
+ loaded:
+  /* The heap starts out empty, just above the highest segment. */
+  t->proc->heap_start = t->proc->heap_brk = seg_end;
+
   /* Set up stack. */
   if (!setup_stack (esp))
     goto done;
 
+  /* Let the process read the time without system calls. */
+  if (!map_clock_page ())
+    goto done;
+
   /* Start address. */
   *eip = (void (*) (void)) ehdr.e_entry;
 
@@ -517,12 +1601,15 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
  done:
   /* We arrive here whether the load is successful or not. */
+  if (image != NULL)
+    exec_cache_release (image);
+  free (segs);
   return success;
 }
 
 /* load() helpers. */
 
-static bool install_page (void *upage, void *kpage, bool writable);
+static uint8_t *map_large_page (uint8_t *upage, size_t size);
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -594,6 +1681,26 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   file_seek (file, ofs);
   while (read_bytes > 0 || zero_bytes > 0) 
     {
+      /* Back whole, aligned 4 MB stretches of writable segments
+         with a single large page, if aligned memory is free. */
+      uint8_t *large_kpage = NULL;
+      if (writable)
+        large_kpage = map_large_page (upage, read_bytes + zero_bytes);
+      if (large_kpage != NULL)
+        {
+          size_t large_read_bytes = read_bytes < PTSPAN ? read_bytes : PTSPAN;
+          if (file_read (file, large_kpage, large_read_bytes)
+              != (int) large_read_bytes)
+            return false;
+          memset (large_kpage + large_read_bytes, 0,
+                  PTSPAN - large_read_bytes);
+
+          read_bytes -= large_read_bytes;
+          zero_bytes -= PTSPAN - large_read_bytes;
+          upage += PTSPAN;
+          continue;
+        }
+
       /* Calculate how to fill this page.
          We will read PAGE_READ_BYTES bytes from FILE
          and zero the final PAGE_ZERO_BYTES bytes. */
@@ -607,13 +1714,13 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       if (kpage == NULL){
         
         /* Get a new page of memory. */
-        kpage = palloc_get_page (PAL_USER);
+        kpage = process_get_page (0);
         if (kpage == NULL){
           return false;
         }
         
         /* Add the page to the process's address space. */
-        if (!install_page (upage, kpage, writable)) 
+        if (!process_install_page (upage, kpage, writable)) 
         {
           palloc_free_page (kpage);
           return false; 
@@ -642,6 +1749,90 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   return true;
 }
 
+/* Maps zeroed pages over the SIZE bytes at UPAGE, skipping pages
+   that are already mapped.  The pages are writable by the user
+   process if WRITABLE is true, read-only otherwise.  Returns true
+   if successful, false if a memory allocation fails. */
+static bool
+zero_segment (uint8_t *upage, size_t size, bool writable)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (size % PGSIZE == 0);
+
+  while (size > 0)
+    {
+      uint8_t *kpage = NULL;
+
+      if (writable)
+        kpage = map_large_page (upage, size);
+      if (kpage != NULL)
+        {
+          memset (kpage, 0, PTSPAN);
+          upage += PTSPAN;
+          size -= PTSPAN;
+          continue;
+        }
+
+      if (pagedir_get_page (pd, upage) != NULL)
+        {
+          /* Copy-on-write pages already have their final access. */
+          if (writable && !pagedir_is_writable (pd, upage)
+              && !pagedir_is_cow (pd, upage))
+            pagedir_set_writable (pd, upage, true);
+        }
+      else
+        {
+          kpage = process_get_page (PAL_ZERO);
+          if (kpage == NULL)
+            return false;
+          if (!process_install_page (upage, kpage, writable))
+            {
+              palloc_free_page (kpage);
+              return false;
+            }
+        }
+      upage += PGSIZE;
+      size -= PGSIZE;
+    }
+  return true;
+}
+
+/* Maps IMAGE, a cached executable, into the current process.
+   Pages with file data share the cached frames, writable ones
+   copy-on-write; the rest of each segment is zeroed as usual.
+   Returns true if successful, false if a memory allocation
+   fails. */
+static bool
+map_image (const struct exec_image *image)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  size_t i;
+
+  for (i = 0; i < image->page_cnt; i++)
+    {
+      const struct exec_page *p = &image->pages[i];
+
+      palloc_ref_page (p->kpage);
+      if (!process_install_page (p->upage, p->kpage, p->writable))
+        {
+          palloc_free_page (p->kpage);
+          return false;
+        }
+      if (p->writable)
+        pagedir_set_cow (pd, p->upage);
+    }
+  for (i = 0; i < image->seg_cnt; i++)
+    {
+      const struct exec_segment *s = &image->segs[i];
+      if (!zero_segment (s->upage + s->read_size, s->size - s->read_size,
+                         s->writable))
+        return false;
+    }
+  return true;
+}
+
 /* Create a minimal stack by mapping a zeroed page at the top of
    user virtual memory. */
 static bool
@@ -650,10 +1841,10 @@ setup_stack (void **esp)
   uint8_t *kpage;
   bool success = false;
 
-  kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+  kpage = process_get_page (PAL_ZERO);
   if (kpage != NULL) 
     {
-      success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
+      success = process_install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
       if (success)
         *esp = PHYS_BASE;
       else
@@ -662,22 +1853,44 @@ setup_stack (void **esp)
   return success;
 }
 
-/* Adds a mapping from user virtual address UPAGE to kernel
-   virtual address KPAGE to the page table.
-   If WRITABLE is true, the user process may modify the page;
-   otherwise, it is read-only.
-   UPAGE must not already be mapped.
-   KPAGE should probably be a page obtained from the user pool
-   with palloc_get_page().
-   Returns true on success, false if UPAGE is already mapped or
-   if memory allocation fails. */
+/* Maps the kernel's clock page read-only at VCLOCK_ADDR.  See
+   lib/vclock.h. */
 static bool
-install_page (void *upage, void *kpage, bool writable)
+map_clock_page (void)
+{
+  void *kpage = timer_clock_page ();
+
+  palloc_ref_page (kpage);
+  if (process_install_page ((void *) VCLOCK_ADDR, kpage, false))
+    return true;
+  palloc_free_page (kpage);
+  return false;
+}
+
+/* Maps the 4 MB at UPAGE in the current process with a single
+   writable large page, if UPAGE is 4 MB aligned, SIZE covers the
+   whole 4 MB and nothing in it is mapped yet.  Returns the kernel
+   virtual address of the new page, or a null pointer if a large
+   page cannot be used here. */
+static uint8_t *
+map_large_page (uint8_t *upage, size_t size)
 {
   struct thread *t = thread_current ();
+  uint8_t *kpage;
 
-  /* Verify that there's not already a page at that virtual
-     address, then map our page there. */
-  return (pagedir_get_page (t->pagedir, upage) == NULL
-          && pagedir_set_page (t->pagedir, upage, kpage, writable));
+  if (!init_large_pages || ((uintptr_t) upage & (PTSPAN - 1)) != 0
+      || size < PTSPAN
+      || !process_charge_mem (t->proc, PTSPAN / PGSIZE, 0))
+    return NULL;
+
+  kpage = palloc_get_aligned (PAL_USER, PTSPAN / PGSIZE, PTSPAN / PGSIZE);
+  if (kpage != NULL && !pagedir_set_large_page (t->pagedir, upage, kpage,
+                                                true))
+    {
+      palloc_free_multiple (kpage, PTSPAN / PGSIZE);
+      kpage = NULL;
+    }
+  if (kpage == NULL)
+    process_uncharge_mem (t->proc, PTSPAN / PGSIZE, 0);
+  return kpage;
 }
@@ -1,21 +1,113 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include <list.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread-stack.h>
+#include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
 
-tid_t process_execute (const char *file_name);
+/* Shared memory segments are mapped into the SHM_SIZE bytes
+   below SHM_LIMIT (see userprog/shm.c).  The 16 MB above hold the
+   stacks (see lib/thread-stack.h), the clock page (see
+   lib/vclock.h) and the submission ring page (see
+   userprog/ring.c). */
+#define SHM_LIMIT ((uint8_t *) PHYS_BASE - 0x1000000)
+#define SHM_SIZE 0x4000000
+
+/* Highest address the heap may reach. */
+#define HEAP_LIMIT (SHM_LIMIT - SHM_SIZE)
+
+/* Memory limits for new processes, in pages, or 0 for none.  A
+   process inherits its parent's limits, which spawn() may lower
+   (see lib/spawn.h). */
+extern size_t rss_limit_default;
+extern size_t kmem_limit_default;
+
+/* Kill the process using the most memory when memory runs out,
+   instead of failing the allocation? */
+extern bool oom_kill;
+
+/* Child processes of a process, or of the kernel's threads.
+   Protected by a lock in userprog/process.c, since child records
+   link two processes. */
+struct child_list
+  {
+    struct list running;                /* Running child processes. */
+    struct list exited;                 /* Exited ones, oldest first. */
+    struct condition child_exited;      /* Signaled when a child exits. */
+  };
+
+/* State shared by the threads of a user process.
+
+   Every thread of the process points to it, and the threads also
+   share one page directory and one descriptor table, which each
+   of them points to directly.  The last thread to exit frees all
+   of it. */
+struct proc
+  {
+    int ref_cnt;                /* Threads in the process. */
+    struct lock lock;           /* Protects the members below, and
+                                   serializes mapping new pages. */
+    void *parent;               /* For passing data to parent. */
+    int status;                 /* Exit status, -1 by default. */
+    bool exiting;               /* Set by exit() or a fatal fault. */
+    struct file *exec_file;     /* Executable, denied writes. */
+    struct ring_ctx *ring;      /* Asynchronous system call rings. */
+    uint8_t *heap_start;        /* Start of the heap. */
+    uint8_t *heap_brk;          /* End of the heap (the break). */
+    uint8_t *shm_end;           /* End of the shared memory mapped. */
+    uint64_t stack_slots;       /* Bit I set if stack slot I is used. */
+    struct list threads;        /* Spawned threads, for joining. */
+    struct child_list children; /* Child processes, for waiting. */
+    struct usage usage;         /* Used by exited threads. */
+    struct usage child_usage;   /* Used by exited child processes. */
+
+    /* Memory charged to the process, in pages.  Changed with
+       interrupts off, so that the OOM killer can compare
+       processes. */
+    size_t rss;                 /* Pages mapped in user memory. */
+    size_t held_cnt;            /* User data pages held for the process
+                                   but not mapped by it, charged with
+                                   process_charge_held(). */
+    size_t kmem;                /* Kernel pages: page directory, page
+                                   tables and one per thread. */
+    size_t rss_limit;           /* Limit on RSS plus HELD_CNT, or 0
+                                   for none. */
+    size_t kmem_limit;          /* Limit on KMEM, or 0 for none. */
+    bool oom_killed;            /* Killed by the OOM killer? */
+    bool destroyed;             /* Freed once HELD_CNT drops to 0? */
+  };
+
+struct exec_args;
+struct spawn_action;
+
+void process_init (void);
+tid_t process_execute (const char *cmd_line);
+tid_t process_spawn (const char *file, struct exec_args *,
+                     const struct spawn_action *, size_t action_cnt,
+                     bool async);
 int process_wait (tid_t);
+tid_t process_waitpid (tid_t, int *status, bool nohang);
 void process_exit (void);
 void process_activate (void);
-void process_pass_status (int, void *);
-
-/* A file opened by a user program. */
-struct user_file
-{
-  int fd;
-  struct file *file;
-  struct list_elem elem;
-};
+void process_terminate (int status) NO_RETURN;
+void process_check_exit (void);
+bool process_map_page (void *upage);
+bool process_install_page (void *upage, void *kpage, bool writable);
+void *process_get_page (enum palloc_flags);
+bool process_charge_mem (struct proc *, size_t rss, size_t kmem);
+void process_uncharge_mem (struct proc *, size_t rss, size_t kmem);
+bool process_charge_held (struct proc *, size_t pages);
+void process_uncharge_held (struct proc *, size_t pages);
+void process_charge (struct proc *, struct usage *);
+void process_get_usage (bool children, struct usage *);
+
+tid_t process_thread_spawn (void *start, void *arg0, void *arg1);
+int process_thread_join (tid_t);
+void process_thread_exit (int status) NO_RETURN;
 
 #endif /* userprog/process.h */
@@ -0,0 +1,226 @@
+#include "userprog/ring.h"
+#include <debug.h>
+#include <ring.h>
+#include <stdio.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "userprog/syscall.h"
+
+/* Asynchronous system calls through shared rings.
+
+   Each process may set up one pair of rings (see lib/ring.h).
+   The shared page comes from the kernel pool, so that neither
+   same-page merging nor anything else ever replaces it, and the
+   kernel reaches it through its kernel address.  It is mapped
+   into the process at RING_UPAGE and freed along with the rest
+   of the page directory.
+
+   A kernel worker thread runs the queued calls.  While it does,
+   it borrows the process's page directory, file descriptor table,
+   and struct proc, so the ordinary system call code works
+   unchanged and user buffers are reached at their user
+   addresses.  All threads of the process share its rings.  The
+   borrowed struct proc stays alive because the process's last
+   thread stops the worker with ring_destroy() before freeing it. */
+
+/* Where the shared page appears in the process, well below the
+   largest stack the page fault handler grows. */
+#define RING_UPAGE ((void *) (PHYS_BASE - 0x1000000))
+
+/* Kernel state for a process's rings. */
+struct ring_ctx
+  {
+    struct ring *ring;          /* Shared page, kernel address. */
+    struct proc *proc;          /* Owning process. */
+    uint32_t *pagedir;          /* Owning process's page directory. */
+    struct fd_table *fd_table;  /* Owning process's descriptors. */
+    uint32_t sq_head;           /* Next submission to take. */
+    uint32_t cq_tail;           /* Next completion slot to fill. */
+    bool exiting;               /* Set when the owner exits. */
+    struct semaphore work;      /* Upped when there may be work. */
+    struct semaphore done;      /* Upped when the worker stops. */
+    struct lock lock;           /* Protects waiting on COMPLETED. */
+    struct condition completed; /* Signaled for each completion. */
+  };
+
+static thread_func ring_worker;
+static void run_submissions (struct ring_ctx *);
+
+/* Sets up submission and completion rings for the current
+   process and starts its worker.  Returns the user address of
+   the shared struct ring, or a null pointer if the process
+   already has rings or memory is short. */
+void *
+ring_setup (void)
+{
+  struct thread *t = thread_current ();
+  struct proc *proc = t->proc;
+  struct ring_ctx *r;
+  char name[16];
+
+  r = malloc (sizeof *r);
+  if (r == NULL)
+    return NULL;
+  r->ring = palloc_get_page (PAL_ZERO);
+  if (r->ring == NULL)
+    {
+      free (r);
+      return NULL;
+    }
+
+  lock_acquire (&proc->lock);
+  if (proc->ring != NULL
+      || !process_install_page (RING_UPAGE, r->ring, true))
+    {
+      palloc_free_page (r->ring);
+      goto fail;
+    }
+  r->proc = proc;
+  r->pagedir = t->pagedir;
+  r->fd_table = t->fd_table;
+  r->sq_head = r->cq_tail = 0;
+  r->exiting = false;
+  sema_init (&r->work, 0);
+  sema_init (&r->done, 0);
+  lock_init (&r->lock);
+  cond_init (&r->completed);
+
+  snprintf (name, sizeof name, "ring-%d", t->tid);
+  if (thread_create (name, thread_get_priority (), ring_worker, r)
+      == TID_ERROR)
+    {
+      pagedir_clear_page (t->pagedir, RING_UPAGE);
+      process_uncharge_mem (proc, 1, 0);
+      palloc_free_page (r->ring);
+      goto fail;
+    }
+  proc->ring = r;
+  lock_release (&proc->lock);
+  return RING_UPAGE;
+
+ fail:
+  lock_release (&proc->lock);
+  free (r);
+  return NULL;
+}
+
+/* Hands the current process's queued system calls to its worker,
+   then waits until at least MIN_COMPLETE completions are waiting
+   to be consumed, or as many as the calls queued so far can
+   produce if that is fewer, or until the process exits.  Returns
+   the number waiting, or -1 if the process has no rings. */
+int
+ring_enter (unsigned min_complete)
+{
+  struct proc *proc = thread_current ()->proc;
+  struct ring_ctx *r = proc->ring;
+  struct ring *ring;
+  uint32_t sq_tail;
+  int ready;
+
+  if (r == NULL)
+    return -1;
+  ring = r->ring;
+
+  /* The process may change SQ_TAIL at any time, so read it once. */
+  sq_tail = ring->sq_tail;
+  barrier ();
+  if (sq_tail != r->sq_head)
+    sema_up (&r->work);
+
+  lock_acquire (&r->lock);
+  if (min_complete > sq_tail - ring->cq_head)
+    min_complete = sq_tail - ring->cq_head;
+  if (min_complete > RING_ENTRIES)
+    min_complete = RING_ENTRIES;
+  while (r->cq_tail - ring->cq_head < min_complete)
+    if (!cond_wait_unless (&r->completed, &r->lock, &proc->exiting))
+      break;
+  ready = r->cq_tail - ring->cq_head;
+  lock_release (&r->lock);
+
+  return ready;
+}
+
+/* Stops R's worker, after the call it is running finishes, and
+   frees R.  Called by the owning process's last thread as it
+   exits, before it gives up its descriptors, page directory and
+   struct proc, after waking up a call that the worker is blocked
+   in. */
+void
+ring_destroy (struct ring_ctx *r)
+{
+  if (r == NULL)
+    return;
+
+  r->exiting = true;
+  sema_up (&r->work);
+  sema_down (&r->done);
+  free (r);
+}
+
+/* Worker thread for a process's rings. */
+static void
+ring_worker (void *r_)
+{
+  struct ring_ctx *r = r_;
+  struct thread *t = thread_current ();
+
+  for (;;)
+    {
+      sema_down (&r->work);
+      if (r->exiting)
+        break;
+
+      /* Borrow the process's context while we work for it. */
+      t->pagedir = r->pagedir;
+      t->fd_table = r->fd_table;
+      t->proc = r->proc;
+      pagedir_activate (t->pagedir);
+
+      run_submissions (r);
+      process_charge (r->proc, &t->usage);
+
+      t->pagedir = NULL;
+      t->fd_table = NULL;
+      t->proc = NULL;
+      pagedir_activate (NULL);
+    }
+  sema_up (&r->done);
+}
+
+/* Runs the calls queued in R, in order, as long as there is room
+   for their completions. */
+static void
+run_submissions (struct ring_ctx *r)
+{
+  struct ring *ring = r->ring;
+
+  while (r->sq_head != ring->sq_tail && !r->exiting
+         && r->cq_tail - ring->cq_head < RING_ENTRIES)
+    {
+      struct ring_sqe sqe;
+      struct ring_cqe *cqe;
+
+      /* Copy the submission before checking it, because the
+         process may change it at any time. */
+      barrier ();
+      sqe = ring->sqes[r->sq_head++ % RING_ENTRIES];
+      ring->sq_head = r->sq_head;
+
+      cqe = &ring->cqes[r->cq_tail % RING_ENTRIES];
+      cqe->user_data = sqe.user_data;
+      cqe->res = syscall_run_async (sqe.nr, sqe.args);
+      barrier ();
+      ring->cq_tail = ++r->cq_tail;
+
+      lock_acquire (&r->lock);
+      cond_broadcast (&r->completed, &r->lock);
+      lock_release (&r->lock);
+    }
+}
@@ -0,0 +1,12 @@
+#ifndef USERPROG_RING_H
+#define USERPROG_RING_H
+
+#include <stdint.h>
+
+struct ring_ctx;
+
+void *ring_setup (void);
+int ring_enter (unsigned min_complete);
+void ring_destroy (struct ring_ctx *);
+
+#endif /* userprog/ring.h */
@@ -0,0 +1,230 @@
+#include "userprog/shm.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+
+/* Shared memory segments.
+
+   A segment is a named run of zeroed user frames, which every
+   process that opens it by name can map with shm_attach().  Each
+   descriptor for a segment holds a reference to it, and the
+   segment gives up its name once the last one is closed.  Each
+   mapping holds its own reference to every frame, taken with
+   palloc_ref_page(), so a frame stays valid for as long as any
+   process has it mapped, and goes away with the last page
+   directory to map it.  The segment's own references are charged
+   to the process that created it, from creation until the
+   segment goes away, and each mapping is charged to the process
+   that maps it.
+
+   The mappings are marked shared in the page tables, so that
+   pipes, which move whole pages by making them copy-on-write,
+   copy their contents instead.  Same-page merging leaves the
+   frames alone, since they have more than one reference. */
+
+/* A shared memory segment. */
+struct shm
+  {
+    struct list_elem elem;      /* In SEGMENTS. */
+    char name[NAME_MAX + 1];    /* Name it was created under. */
+    int ref_cnt;                /* Descriptors referring to it. */
+    size_t page_cnt;            /* Number of pages. */
+    void **pages;               /* Frames, by kernel address. */
+    struct proc *charged;       /* Process charged for PAGES. */
+  };
+
+/* Segments that are open, by name. */
+static struct list segments;
+
+/* Protects SEGMENTS and the reference counts of segments. */
+static struct lock shm_lock;
+
+static struct shm *shm_create (const char *name, size_t page_cnt);
+static void free_shm (struct shm *);
+
+/* Initializes shared memory segments. */
+void
+shm_init (void)
+{
+  list_init (&segments);
+  lock_init (&shm_lock);
+}
+
+/* Opens the segment called NAME, creating it with SIZE bytes,
+   rounded up to whole pages, if there is none.  An existing
+   segment must have room for SIZE bytes.  Returns the segment,
+   with a reference for the caller to drop with shm_release(), or
+   a null pointer if the segment cannot be opened or created. */
+struct shm *
+shm_lookup (const char *name, size_t size)
+{
+  size_t page_cnt = DIV_ROUND_UP (size, PGSIZE);
+  struct shm *s = NULL;
+  struct list_elem *e;
+
+  if (*name == '\0' || strlen (name) > NAME_MAX)
+    return NULL;
+
+  lock_acquire (&shm_lock);
+  for (e = list_begin (&segments); e != list_end (&segments);
+       e = list_next (e))
+    {
+      struct shm *i = list_entry (e, struct shm, elem);
+      if (!strcmp (i->name, name))
+        {
+          if (page_cnt <= i->page_cnt)
+            {
+              s = i;
+              s->ref_cnt++;
+            }
+          lock_release (&shm_lock);
+          return s;
+        }
+    }
+
+  /* Create it while holding the lock, so that two processes
+     opening the same name get the same segment. */
+  s = shm_create (name, page_cnt);
+  if (s != NULL)
+    list_push_back (&segments, &s->elem);
+  lock_release (&shm_lock);
+  return s;
+}
+
+/* Returns a new segment called NAME, of PAGE_CNT zeroed pages
+   charged to the current process, with one reference, or a null
+   pointer if PAGE_CNT is out of range, the process is at its
+   memory limit or memory is short. */
+static struct shm *
+shm_create (const char *name, size_t page_cnt)
+{
+  struct proc *proc = thread_current ()->proc;
+  struct shm *s;
+
+  if (page_cnt == 0 || page_cnt > SHM_MAX_PAGES)
+    return NULL;
+  if (!process_charge_held (proc, page_cnt))
+    return NULL;
+
+  s = malloc (sizeof *s);
+  if (s != NULL)
+    s->pages = malloc (page_cnt * sizeof *s->pages);
+  if (s == NULL || s->pages == NULL)
+    {
+      free (s);
+      process_uncharge_held (proc, page_cnt);
+      return NULL;
+    }
+  strlcpy (s->name, name, sizeof s->name);
+  s->ref_cnt = 1;
+  s->charged = proc;
+  for (s->page_cnt = 0; s->page_cnt < page_cnt; s->page_cnt++)
+    {
+      s->pages[s->page_cnt] = process_get_page (PAL_ZERO);
+      if (s->pages[s->page_cnt] == NULL)
+        {
+          process_uncharge_held (proc, page_cnt - s->page_cnt);
+          free_shm (s);
+          return NULL;
+        }
+    }
+  return s;
+}
+
+/* Adds a reference to S. */
+void
+shm_reopen (struct shm *s)
+{
+  lock_acquire (&shm_lock);
+  ASSERT (s->ref_cnt > 0);
+  s->ref_cnt++;
+  lock_release (&shm_lock);
+}
+
+/* Drops a reference to S.  Dropping the last one frees S and its
+   name, but not the frames that processes still have mapped. */
+void
+shm_release (struct shm *s)
+{
+  bool last;
+
+  lock_acquire (&shm_lock);
+  last = --s->ref_cnt == 0;
+  if (last)
+    list_remove (&s->elem);
+  lock_release (&shm_lock);
+
+  if (last)
+    free_shm (s);
+}
+
+/* Drops the segment's references to the frames of S, takes back
+   their charge, and frees S. */
+static void
+free_shm (struct shm *s)
+{
+  palloc_free_pages (s->pages, s->page_cnt);
+  if (s->page_cnt > 0)
+    process_uncharge_held (s->charged, s->page_cnt);
+  free (s->pages);
+  free (s);
+}
+
+/* Maps all of S, writable, into the current process at the
+   lowest free address in its shared memory area, and returns
+   that address.  Returns a null pointer if the area is full, the
+   process is at its memory limit or memory is short. */
+void *
+shm_attach (struct shm *s)
+{
+  struct thread *t = thread_current ();
+  struct proc *proc = t->proc;
+  uint8_t *start;
+  size_t i;
+
+  lock_acquire (&proc->lock);
+  start = proc->shm_end;
+  if ((size_t) (SHM_LIMIT - start) < s->page_cnt * PGSIZE)
+    {
+      lock_release (&proc->lock);
+      return NULL;
+    }
+
+  for (i = 0; i < s->page_cnt; i++)
+    {
+      uint8_t *upage = start + i * PGSIZE;
+
+      palloc_ref_page (s->pages[i]);
+      if (!process_install_page (upage, s->pages[i], true))
+        {
+          palloc_free_page (s->pages[i]);
+          break;
+        }
+      pagedir_set_shared (t->pagedir, upage);
+    }
+
+  if (i < s->page_cnt)
+    {
+      /* Undo the mappings made so far. */
+      while (i-- > 0)
+        {
+          pagedir_clear_page (t->pagedir, start + i * PGSIZE);
+          palloc_free_page (s->pages[i]);
+          process_uncharge_mem (proc, 1, 0);
+        }
+      start = NULL;
+    }
+  else
+    proc->shm_end = start + s->page_cnt * PGSIZE;
+  lock_release (&proc->lock);
+  return start;
+}
@@ -0,0 +1,17 @@
+#ifndef USERPROG_SHM_H
+#define USERPROG_SHM_H
+
+#include <stddef.h>
+
+struct shm;
+
+/* Most pages a shared memory segment may have. */
+#define SHM_MAX_PAGES 1024
+
+void shm_init (void);
+struct shm *shm_lookup (const char *name, size_t size);
+void shm_reopen (struct shm *);
+void shm_release (struct shm *);
+void *shm_attach (struct shm *);
+
+#endif /* userprog/shm.h */
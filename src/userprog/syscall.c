@@ -4,22 +4,38 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "devices/timer.h"
 #include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "userprog/exec-args.h"
+#include "userprog/fdtable.h"
+#include "userprog/futex.h"
 #include "userprog/pagedir.h"
+#include "userprog/pipe.h"
 #include "userprog/process.h"
+#include "userprog/ring.h"
+#include "userprog/shm.h"
+#include "userprog/uaccess.h"
+#include <inttypes.h>
+#include <limits.h>
 #include <list.h>
+#include <rusage.h>
+#include <spawn.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include <uio.h>
+#include <wait.h>
 
 typedef int pid_t;
 
 static void syscall_handler (struct intr_frame *);
 
 static void halt (void);
-static void exit (int status);
+static void exit (int status) NO_RETURN;
 static bool create (const char *file, unsigned initial_size);
 static bool remove (const char *file);
 static int open (const char *file);
@@ -29,69 +45,193 @@ static int read (int fd, void *buffer, unsigned size);
 static void seek (int fd, unsigned position);
 static unsigned tell (int fd);
 static void close (int fd);
-static pid_t exec (const char *file);
+static pid_t exec (const char *cmd_line);
+static pid_t spawn (const char *file, char *const *argv,
+                    const struct spawn_action *actions, int flags);
 static int wait (pid_t pid);
+static pid_t waitpid (pid_t pid, int *status, int options);
+static int getrusage (int who, struct rusage *usage);
+static int readv (int fd, const struct iovec *iov, int iovcnt);
+static int writev (int fd, const struct iovec *iov, int iovcnt);
+static int pread (int fd, void *buffer, unsigned size, unsigned offset);
+static int pwrite (int fd, const void *buffer, unsigned size,
+                   unsigned offset);
+static int pipe (int *fds);
+static int dup2 (int old_fd, int new_fd);
+static bool inherit (int fd, bool on);
+static void *sbrk (intptr_t increment);
+static tid_t thread_spawn (void *start, void *arg0, void *arg1);
+static int thread_join (tid_t tid);
+static void exit_thread (int status) NO_RETURN;
+static int shm_open (const char *name, unsigned size);
+static void *shm_map (int fd);
 
-static struct user_file *find_user_file (int fd);
+static struct fd *find_user_fd (int fd);
+static struct file *find_user_file (int fd);
 
-static bool is_mem_valid (const void *ptr, size_t size);
-static bool is_str_mem_valid (const char *ptr, size_t size);
+struct lock filesys_lock;       /* Lock for the file system. */
 
-static struct lock filesys_lock; /* Lock for the file system. */
+/* Kernel buffer that file data passes through on its way between
+   the file system and user memory, under FILESYS_LOCK.  Another
+   thread of the process may unmap a user buffer while the file
+   system waits for the disk, so the file system never touches
+   user memory itself. */
+static uint8_t file_bounce[PGSIZE];
+
+/* How a system call argument is checked before the call. */
+enum syscall_arg
+  {
+    ARG_INT,            /* Plain value, not checked. */
+    ARG_STR,            /* String of less than a page. */
+    ARG_NAME,           /* File name, passed on as a kernel copy. */
+    ARG_BUF_IN,         /* Buffer read by the call, sized by the next
+                           argument. */
+    ARG_BUF_OUT,        /* Buffer written by the call, likewise. */
+    ARG_PTR             /* Accessed by the handler with copy_to_user()
+                           or copy_from_user(). */
+  };
+
+/* A system call handler, which receives the call's arguments and
+   returns the value for the caller's eax. */
+typedef uint32_t syscall_func (const uint32_t *args);
+
+/* A system call. */
+struct syscall
+  {
+    const char *name;                   /* Name, for statistics. */
+    syscall_func *func;                 /* Handler. */
+    int argc;                           /* Number of arguments. */
+    enum syscall_arg args[SYSCALL_MAX_ARGS];    /* Argument kinds. */
+  };
+
+static syscall_func sys_halt, sys_exit, sys_exec, sys_wait, sys_create,
+  sys_remove, sys_open, sys_filesize, sys_read, sys_write, sys_seek,
+  sys_tell, sys_close, sys_getrusage, sys_readv, sys_writev, sys_pread,
+  sys_pwrite, sys_ring_setup, sys_ring_enter, sys_pipe, sys_dup2,
+  sys_inherit, sys_sbrk, sys_thread_spawn, sys_thread_join,
+  sys_thread_exit, sys_futex_wait, sys_futex_wake, sys_waitpid,
+  sys_spawn, sys_shm_open, sys_shm_map;
+
+/* System calls, indexed by number. */
+static const struct syscall syscalls[] =
+  {
+    [SYS_HALT] = {"halt", sys_halt, 0, {}},
+    [SYS_EXIT] = {"exit", sys_exit, 1, {ARG_INT}},
+    [SYS_EXEC] = {"exec", sys_exec, 1, {ARG_STR}},
+    [SYS_WAIT] = {"wait", sys_wait, 1, {ARG_INT}},
+    [SYS_CREATE] = {"create", sys_create, 2, {ARG_NAME, ARG_INT}},
+    [SYS_REMOVE] = {"remove", sys_remove, 1, {ARG_NAME}},
+    [SYS_OPEN] = {"open", sys_open, 1, {ARG_NAME}},
+    [SYS_FILESIZE] = {"filesize", sys_filesize, 1, {ARG_INT}},
+    [SYS_READ] = {"read", sys_read, 3, {ARG_INT, ARG_BUF_OUT, ARG_INT}},
+    [SYS_WRITE] = {"write", sys_write, 3, {ARG_INT, ARG_BUF_IN, ARG_INT}},
+    [SYS_SEEK] = {"seek", sys_seek, 2, {ARG_INT, ARG_INT}},
+    [SYS_TELL] = {"tell", sys_tell, 1, {ARG_INT}},
+    [SYS_CLOSE] = {"close", sys_close, 1, {ARG_INT}},
+    [SYS_GETRUSAGE] = {"getrusage", sys_getrusage, 2, {ARG_INT, ARG_PTR}},
+    [SYS_READV] = {"readv", sys_readv, 3, {ARG_INT, ARG_PTR, ARG_INT}},
+    [SYS_WRITEV] = {"writev", sys_writev, 3, {ARG_INT, ARG_PTR, ARG_INT}},
+    [SYS_PREAD] = {"pread", sys_pread, 4,
+                   {ARG_INT, ARG_BUF_OUT, ARG_INT, ARG_INT}},
+    [SYS_PWRITE] = {"pwrite", sys_pwrite, 4,
+                    {ARG_INT, ARG_BUF_IN, ARG_INT, ARG_INT}},
+    [SYS_RING_SETUP] = {"ring_setup", sys_ring_setup, 0, {}},
+    [SYS_RING_ENTER] = {"ring_enter", sys_ring_enter, 1, {ARG_INT}},
+    [SYS_PIPE] = {"pipe", sys_pipe, 1, {ARG_PTR}},
+    [SYS_DUP2] = {"dup2", sys_dup2, 2, {ARG_INT, ARG_INT}},
+    [SYS_INHERIT] = {"inherit", sys_inherit, 2, {ARG_INT, ARG_INT}},
+    [SYS_SBRK] = {"sbrk", sys_sbrk, 1, {ARG_INT}},
+    [SYS_THREAD_SPAWN] = {"thread_spawn", sys_thread_spawn, 3,
+                          {ARG_INT, ARG_INT, ARG_INT}},
+    [SYS_THREAD_JOIN] = {"thread_join", sys_thread_join, 1, {ARG_INT}},
+    [SYS_THREAD_EXIT] = {"thread_exit", sys_thread_exit, 1, {ARG_INT}},
+    [SYS_FUTEX_WAIT] = {"futex_wait", sys_futex_wait, 3,
+                        {ARG_INT, ARG_INT, ARG_INT}},
+    [SYS_FUTEX_WAKE] = {"futex_wake", sys_futex_wake, 2, {ARG_INT, ARG_INT}},
+    [SYS_WAITPID] = {"waitpid", sys_waitpid, 3, {ARG_INT, ARG_PTR, ARG_INT}},
+    [SYS_SPAWN] = {"spawn", sys_spawn, 4,
+                   {ARG_NAME, ARG_PTR, ARG_PTR, ARG_INT}},
+    [SYS_SHM_OPEN] = {"shm_open", sys_shm_open, 2, {ARG_NAME, ARG_INT}},
+    [SYS_SHM_MAP] = {"shm_map", sys_shm_map, 1, {ARG_INT}},
+  };
+
+static bool prepare_args (const struct syscall *, uint32_t *args,
+                          char name[NAME_MAX + 2]);
+
+/* Number of entries in syscalls[]. */
+#define SYSCALL_CNT (sizeof syscalls / sizeof *syscalls)
+
+/* Calls made to each system call and the CPU cycles spent in
+   them.  Calls that never return, such as exit, add no cycles. */
+static long long syscall_cnt[SYSCALL_CNT];
+static uint64_t syscall_cycles[SYSCALL_CNT];
+
+/* System calls made through SYSENTER rather than `int $0x30'. */
+static long long sysenter_cnt;
+
+/* Finds descriptor FD of the current process.  Returns NULL if
+   it is not open.  The caller must hold FILESYS_LOCK until it is
+   done with the descriptor, because a submission ring worker may
+   close it concurrently. */
+static struct fd *
+find_user_fd (int fd)
+{
+  ASSERT (lock_held_by_current_thread (&filesys_lock));
+  return fd_get (thread_current ()->fd_table, fd);
+}
 
 /* Finds the file with given file descriptor in current thread's opened files. 
-   Returns NULL if the file was not found. */
-static struct user_file *
+   Returns NULL if the file was not found, or FD is not a file.
+   The caller must hold FILESYS_LOCK, as for find_user_fd(). */
+static struct file *
 find_user_file (int fd)
 { 
-  struct list *files = &thread_current ()->files;
-  struct list_elem *e;
-  for (e = list_begin (files); e != list_end (files);
-       e = list_next (e))
-    {
-      struct user_file *file = list_entry (e, struct user_file, elem);
-      if (file->fd == fd)
-        return file;
-    }
-  return NULL;
+  ASSERT (lock_held_by_current_thread (&filesys_lock));
+  return fd_lookup (thread_current ()->fd_table, fd);
 }
 
-/* Returns if the memory slice of size SIZE is valid at PTR. */
-static bool
-is_mem_valid (const void *ptr, size_t size)
-{
-  uint32_t *pd = thread_current ()->pagedir;
-  if ((ptr == NULL) || !is_user_vaddr (ptr)
-      || pagedir_get_page (pd, ptr) == NULL)
-    return false;
-  
-  void *pg_start = pg_round_down (ptr) + PGSIZE;
-  while (pg_start < ptr + size)
-    {
-      if (!is_user_vaddr (pg_start) || pagedir_get_page (pd, pg_start) == NULL)
-        return false;
-      pg_start += PGSIZE;
-    }
-  return true;
-}
+/* Checks the arguments ARGS of system call SC as declared in SC,
+   and replaces a file name argument by a copy in NAME.  Returns
+   false if an argument is not valid user memory, or a string is
+   not terminated within a page.
 
-/* Returns if the string at most of size SIZE is valid at PTR. This function
-   uses a loop and should be used sparingly.
-   Assume that size SIZE is smaller then PGSIZE */
+   File names longer than NAME_MAX are truncated to NAME_MAX + 1
+   characters, which keeps them too long to match any file. */
 static bool
-is_str_mem_valid (const char *ptr, size_t size)
-{
-  uint32_t *pd = thread_current ()->pagedir;
-  const char *p;
-  if ((ptr == NULL) || !is_user_vaddr (ptr)
-      || pagedir_get_page (pd, ptr) == NULL)
-    return false;
-  for (p = ptr; p < ptr + size; p++)
-    {
-      if (*p == '\0')
-        return is_user_vaddr (p) && (pagedir_get_page (pd, p) != NULL);
-    }
-  return is_user_vaddr (p) && (pagedir_get_page (pd, p) != NULL);
+prepare_args (const struct syscall *sc, uint32_t *args,
+              char name[NAME_MAX + 2])
+{
+  int i;
+
+  for (i = 0; i < sc->argc; i++)
+    switch (sc->args[i])
+      {
+      case ARG_INT:
+      case ARG_PTR:
+        break;
+      case ARG_STR:
+        {
+          int len = strnlen_user ((const char *) args[i], PGSIZE);
+          if (len < 0 || len == PGSIZE)
+            return false;
+        }
+        break;
+      case ARG_NAME:
+        if (strncpy_from_user (name, (const char *) args[i],
+                               NAME_MAX + 2) < 0)
+          return false;
+        args[i] = (uint32_t) name;
+        break;
+      case ARG_BUF_IN:
+        if (!probe_user_read ((const void *) args[i], args[i + 1]))
+          return false;
+        break;
+      case ARG_BUF_OUT:
+        if (!probe_user_write ((void *) args[i], args[i + 1]))
+          return false;
+        break;
+      }
+  return true;
 }
 
 void
@@ -101,89 +241,368 @@ syscall_init (void)
   lock_init (&filesys_lock);
 }
 
-/* Handles a system call. */
-static void
-syscall_handler (struct intr_frame *f)
+/* Prints system call statistics. */
+void
+syscall_print_stats (void)
+{
+  size_t nr;
+
+  for (nr = 0; nr < SYSCALL_CNT; nr++)
+    if (syscall_cnt[nr] != 0)
+      printf ("Syscall: %s: %lld calls, %"PRIu64" cycles\n",
+              syscalls[nr].name, syscall_cnt[nr], syscall_cycles[nr]);
+  printf ("Syscall: %lld calls through sysenter\n", sysenter_cnt);
+}
+
+/* Returns the system call numbered NR, killing the process if
+   there is none. */
+static const struct syscall *
+lookup_syscall (uint32_t nr)
 {
-  if (!is_mem_valid (f->esp, 4))
+  if (nr >= SYSCALL_CNT || syscalls[nr].func == NULL)
     exit (-1);
-  int syscall_num = *((int *)f->esp);
-  void *param1 = f->esp + 4;
-  void *param2 = f->esp + 8;
-  void *param3 = f->esp + 12;
+  return &syscalls[nr];
+}
 
-  unsigned *retval = &f->eax;
+/* Charges the bytes transferred by system call NR, which
+   returned RESULT, to the current thread. */
+static void
+account_io (size_t nr, uint32_t result)
+{
+  struct usage *u = &thread_current ()->usage;
 
-  switch (syscall_num)
+  if ((int32_t) result <= 0)
+    return;
+  switch (nr)
     {
-    case SYS_HALT:
-      halt ();
-      break;
-    case SYS_EXIT:
-      if (!is_mem_valid (f->esp, 8))
-        exit (-1);
-      exit (*((int *)param1));
-      break;
-    case SYS_CREATE:
-      if (!is_mem_valid (f->esp, 12))
-        exit (-1);
-      *retval = create (*((char **)param1), *((unsigned *)param2));
-      break;
-    case SYS_REMOVE:
-      if (!is_mem_valid (f->esp, 8))
-        exit (-1);
-      *retval = remove (*((char **)param1));
-      break;
-    case SYS_FILESIZE:
-      if (!is_mem_valid (f->esp, 8))
-        exit (-1);
-      *retval = filesize (*((int *)param1));
-      break;
-    case SYS_OPEN:
-      if (!is_mem_valid (f->esp, 8))
-        exit (-1);
-      *retval = open (*((char **)param1));
-      break;
     case SYS_READ:
-      if (!is_mem_valid (f->esp, 16))
-        exit (-1);
-      *retval
-          = read (*((int *)param1), *((void **)param2), *((unsigned *)param3));
+    case SYS_READV:
+    case SYS_PREAD:
+      u->read_bytes += result;
       break;
     case SYS_WRITE:
-      if (!is_mem_valid (f->esp, 16))
-        exit (-1);
-      *retval = write (*((int *)param1), *((void **)param2),
-                       *((unsigned *)param3));
+    case SYS_WRITEV:
+    case SYS_PWRITE:
+      u->write_bytes += result;
       break;
+    }
+}
+
+/* Calls the handler for system call SC with the checked
+   arguments in ARGS, counting the call and the bytes it moves,
+   and returns its result. */
+static uint32_t
+invoke (const struct syscall *sc, const uint32_t *args)
+{
+  size_t nr = sc - syscalls;
+  uint64_t start = timer_cycles ();
+  uint32_t result;
+
+  syscall_cnt[nr]++;
+  thread_current ()->usage.syscalls++;
+  result = sc->func (args);
+  syscall_cycles[nr] += timer_cycles () - start;
+  account_io (nr, result);
+  return result;
+}
+
+/* Runs system call SC, whose arguments are in ARGS, and stores
+   its return value in F. */
+static void
+run_syscall (struct intr_frame *f, const struct syscall *sc,
+             uint32_t *args)
+{
+  char name[NAME_MAX + 2];
+
+  if (!prepare_args (sc, args, name))
+    exit (-1);
+  f->eax = invoke (sc, args);
+}
+
+/* Handles a system call made with `int $0x30'.  The system call
+   number and then its arguments are on the user stack. */
+static void
+syscall_handler (struct intr_frame *f)
+{
+  const uint32_t *esp = f->esp;
+  const struct syscall *sc;
+  uint32_t nr, args[SYSCALL_MAX_ARGS];
+
+  thread_current ()->user_esp = f->esp;
+  if (!copy_from_user (&nr, esp, sizeof nr))
+    exit (-1);
+  sc = lookup_syscall (nr);
+  if (!copy_from_user (args, esp + 1, sc->argc * sizeof *args))
+    exit (-1);
+  run_syscall (f, sc, args);
+}
+
+/* Runs system call NR with arguments ARGS for a submission ring
+   (see userprog/ring.c), in a worker thread that has borrowed the
+   process's page directory and descriptors.  Only calls that
+   cannot end the process may be queued, and a bad argument makes
+   the call return -1 instead of killing the process.  Pipes are
+   refused too, because a call on one could block the worker
+   forever and with it the process's exit. */
+int32_t
+syscall_run_async (uint32_t nr, const uint32_t args_[SYSCALL_MAX_ARGS])
+{
+  uint32_t args[SYSCALL_MAX_ARGS];
+  char name[NAME_MAX + 2];
+
+  switch (nr)
+    {
+    case SYS_READ:
+    case SYS_WRITE:
+    case SYS_OPEN:
     case SYS_CLOSE:
-      if (!is_mem_valid (f->esp, 8))
-        exit (-1);
-      close (*((int *)param1));
-      break;
-    case SYS_TELL:
-      if (!is_mem_valid (f->esp, 8))
-        exit (-1);
-      *retval = tell (*((int *)param1));
-      break;
     case SYS_SEEK:
-      if (!is_mem_valid (f->esp, 16))
-        exit (-1);
-      seek (*((int *)param1), *((unsigned *)param2));
-      break;
-    case SYS_EXEC:
-      if (!is_mem_valid (f->esp, 8))
-        exit (-1);
-      *retval = exec (*((char **)param1));
-      break;
-    case SYS_WAIT:
-      if (!is_mem_valid (f->esp, 8))
-        exit (-1);;
-      *retval = wait (*(int *)param1);
+    case SYS_PREAD:
+    case SYS_PWRITE:
       break;
     default:
-      exit (-1);
+      return -1;
     }
+
+  if (nr == SYS_READ || nr == SYS_WRITE)
+    {
+      struct fd *f;
+      bool is_pipe;
+
+      lock_acquire (&filesys_lock);
+      f = find_user_fd (args_[0]);
+      is_pipe = (f != NULL && (f->type == FD_PIPE_READ
+                               || f->type == FD_PIPE_WRITE));
+      lock_release (&filesys_lock);
+      if (is_pipe)
+        return -1;
+    }
+
+  memcpy (args, args_, sizeof args);
+  if (!prepare_args (&syscalls[nr], args, name))
+    return -1;
+  return invoke (&syscalls[nr], args);
+}
+
+/* Handles a system call made with SYSENTER, from sysenter_entry.
+   The system call number is in %eax and its arguments are in
+   %ebx, %esi, %edi, and %ebp. */
+void
+syscall_sysenter (struct intr_frame *f)
+{
+  uint32_t args[SYSCALL_MAX_ARGS] = {f->ebx, f->esi, f->edi, f->ebp};
+
+  thread_current ()->user_esp = f->esp;
+  sysenter_cnt++;
+  run_syscall (f, lookup_syscall (f->eax), args);
+
+  /* sysenter_entry returns to user mode without intr_handler(),
+     which would otherwise make this check. */
+  process_check_exit ();
+}
+
+static uint32_t
+sys_halt (const uint32_t *args UNUSED)
+{
+  halt ();
+  NOT_REACHED ();
+}
+
+static uint32_t
+sys_exit (const uint32_t *args)
+{
+  exit (args[0]);
+  NOT_REACHED ();
+}
+
+static uint32_t
+sys_exec (const uint32_t *args)
+{
+  return exec ((const char *) args[0]);
+}
+
+static uint32_t
+sys_wait (const uint32_t *args)
+{
+  return wait (args[0]);
+}
+
+static uint32_t
+sys_create (const uint32_t *args)
+{
+  return create ((const char *) args[0], args[1]);
+}
+
+static uint32_t
+sys_remove (const uint32_t *args)
+{
+  return remove ((const char *) args[0]);
+}
+
+static uint32_t
+sys_open (const uint32_t *args)
+{
+  return open ((const char *) args[0]);
+}
+
+static uint32_t
+sys_filesize (const uint32_t *args)
+{
+  return filesize (args[0]);
+}
+
+static uint32_t
+sys_read (const uint32_t *args)
+{
+  return read (args[0], (void *) args[1], args[2]);
+}
+
+static uint32_t
+sys_write (const uint32_t *args)
+{
+  return write (args[0], (const void *) args[1], args[2]);
+}
+
+static uint32_t
+sys_seek (const uint32_t *args)
+{
+  seek (args[0], args[1]);
+  return 0;
+}
+
+static uint32_t
+sys_tell (const uint32_t *args)
+{
+  return tell (args[0]);
+}
+
+static uint32_t
+sys_close (const uint32_t *args)
+{
+  close (args[0]);
+  return 0;
+}
+
+static uint32_t
+sys_getrusage (const uint32_t *args)
+{
+  return getrusage (args[0], (struct rusage *) args[1]);
+}
+
+static uint32_t
+sys_readv (const uint32_t *args)
+{
+  return readv (args[0], (const struct iovec *) args[1], args[2]);
+}
+
+static uint32_t
+sys_writev (const uint32_t *args)
+{
+  return writev (args[0], (const struct iovec *) args[1], args[2]);
+}
+
+static uint32_t
+sys_pread (const uint32_t *args)
+{
+  return pread (args[0], (void *) args[1], args[2], args[3]);
+}
+
+static uint32_t
+sys_pwrite (const uint32_t *args)
+{
+  return pwrite (args[0], (const void *) args[1], args[2], args[3]);
+}
+
+static uint32_t
+sys_ring_setup (const uint32_t *args UNUSED)
+{
+  return (uint32_t) ring_setup ();
+}
+
+static uint32_t
+sys_ring_enter (const uint32_t *args)
+{
+  return ring_enter (args[0]);
+}
+
+static uint32_t
+sys_pipe (const uint32_t *args)
+{
+  return pipe ((int *) args[0]);
+}
+
+static uint32_t
+sys_dup2 (const uint32_t *args)
+{
+  return dup2 (args[0], args[1]);
+}
+
+static uint32_t
+sys_inherit (const uint32_t *args)
+{
+  return inherit (args[0], args[1]);
+}
+
+static uint32_t
+sys_sbrk (const uint32_t *args)
+{
+  return (uint32_t) sbrk (args[0]);
+}
+
+static uint32_t
+sys_thread_spawn (const uint32_t *args)
+{
+  return thread_spawn ((void *) args[0], (void *) args[1], (void *) args[2]);
+}
+
+static uint32_t
+sys_thread_join (const uint32_t *args)
+{
+  return thread_join (args[0]);
+}
+
+static uint32_t
+sys_thread_exit (const uint32_t *args)
+{
+  exit_thread (args[0]);
+  NOT_REACHED ();
+}
+
+static uint32_t
+sys_futex_wait (const uint32_t *args)
+{
+  return futex_wait ((int *) args[0], args[1], args[2]);
+}
+
+static uint32_t
+sys_futex_wake (const uint32_t *args)
+{
+  return futex_wake ((int *) args[0], args[1]);
+}
+
+static uint32_t
+sys_waitpid (const uint32_t *args)
+{
+  return waitpid (args[0], (int *) args[1], args[2]);
+}
+
+static uint32_t
+sys_spawn (const uint32_t *args)
+{
+  return spawn ((const char *) args[0], (char *const *) args[1],
+                (const struct spawn_action *) args[2], args[3]);
+}
+
+static uint32_t
+sys_shm_open (const uint32_t *args)
+{
+  return shm_open ((const char *) args[0], args[1]);
+}
+
+static uint32_t
+sys_shm_map (const uint32_t *args)
+{
+  return (uint32_t) shm_map (args[0]);
 }
 
 /* Terminates PintOS. */
@@ -197,18 +616,13 @@ halt (void)
 static void
 exit (int status)
 {
-  struct thread *t = thread_current ();
-  process_pass_status (status, t->process);
-  thread_exit ();
+  process_terminate (status);
 }
 
 /* Creates a file. */
 static bool
 create (const char *file, unsigned initial_size)
 {
-  if (!is_str_mem_valid (file, sizeof (char) * 16))
-    exit (-1);
-
   lock_acquire (&filesys_lock);
   bool is_created = filesys_create (file, initial_size);
   lock_release (&filesys_lock);
@@ -219,9 +633,6 @@ create (const char *file, unsigned initial_size)
 static bool
 remove (const char *file)
 {
-  if (!is_str_mem_valid (file, sizeof (char) * 16))
-    exit (-1);
-
   lock_acquire (&filesys_lock);
   bool is_removed = filesys_remove (file);
   lock_release (&filesys_lock);
@@ -232,10 +643,9 @@ remove (const char *file)
 static int
 filesize (int fd)
 {
-  struct user_file *file = find_user_file (fd);
-  ASSERT (file != NULL);
   lock_acquire (&filesys_lock);
-  int size = file_length (file->file);
+  struct file *file = find_user_file (fd);
+  int size = file != NULL ? file_length (file) : -1;
   lock_release (&filesys_lock);
   return size;
 }
@@ -245,90 +655,218 @@ filesize (int fd)
 static int
 open (const char *file)
 {
-  if (!is_str_mem_valid (file, sizeof (char) * 16))
-    exit (-1);
+  int fd = -1;
 
   lock_acquire (&filesys_lock);
   struct file *ret_file = filesys_open (file);
+  if (ret_file != NULL)
+    {
+      /* Give the file the lowest free file descriptor. */
+      struct fd f = {FD_FILE, false, ret_file, NULL, NULL};
+      fd = fd_install (thread_current ()->fd_table, &f);
+      if (fd == -1)
+        file_close (ret_file);
+    }
   lock_release (&filesys_lock);
 
-  if (ret_file == NULL)
-    return -1;
+  return fd;
+}
 
-  /* Generate a new file descriptor and add the file to OPEN_FILES. */
-  struct user_file *new_file = calloc (1, sizeof (struct user_file));
-  new_file->fd = thread_current ()->next_fd++;
-  new_file->file = ret_file;
-  list_push_front (&thread_current ()->files, &new_file->elem);
+/* Transfers SIZE bytes between FILE and user buffer UBUF, from
+   UBUF into FILE if TO_FILE is true and the other way otherwise,
+   starting at offset OFS, or at FILE's position if OFS is
+   negative.  Stops early at end of file, or if FILE cannot grow.
+   Returns the number of bytes transferred, or -1 if UBUF is not
+   valid user memory, in which case FILE's position does not move
+   past the last byte transferred.  The caller must hold
+   FILESYS_LOCK. */
+static int
+file_transfer (struct file *file, void *ubuf, unsigned size, bool to_file,
+               off_t ofs)
+{
+  unsigned done = 0;
+
+  ASSERT (lock_held_by_current_thread (&filesys_lock));
+  while (done < size)
+    {
+      size_t chunk = size - done < PGSIZE ? size - done : PGSIZE;
+      off_t n;
 
-  return new_file->fd;
+      if (to_file)
+        {
+          if (!copy_from_user (file_bounce, ubuf + done, chunk))
+            return done > 0 ? (int) done : -1;
+          n = (ofs < 0 ? file_write (file, file_bounce, chunk)
+               : file_write_at (file, file_bounce, chunk, ofs + done));
+        }
+      else
+        {
+          n = (ofs < 0 ? file_read (file, file_bounce, chunk)
+               : file_read_at (file, file_bounce, chunk, ofs + done));
+          if (!copy_to_user (ubuf + done, file_bounce, n))
+            {
+              if (ofs < 0)
+                file_seek (file, file_tell (file) - n);
+              return done > 0 ? (int) done : -1;
+            }
+        }
+      done += n;
+      if ((size_t) n < chunk)
+        break;
+    }
+  return done;
 }
 
-/* Reads SIZE bites from an opened file. Returns the size actually read or -1
-  if the file could not be read. Also works for STDIN. */
+/* Reads SIZE bytes from the keyboard into user buffer UBUF,
+   waiting for each one.  Returns SIZE, or -1 if UBUF is not valid
+   user memory or the process exits first. */
 static int
-read (int fd, void *buffer, unsigned size)
+console_read (void *ubuf, unsigned size)
 {
-  if (!is_mem_valid (buffer, size))
-    exit (-1);
-  if (fd == STDIN_FILENO)
+  struct proc *proc = thread_current ()->proc;
+  uint8_t buf[64];
+  unsigned done = 0;
+
+  while (done < size)
     {
-      /* Read from STDIN. Always reads the full size. */
-      for (unsigned i = 0; i < size; i++)
-        *(uint8_t *)(buffer + i) = input_getc ();
-      return size;
+      size_t chunk = size - done < sizeof buf ? size - done : sizeof buf;
+      size_t i;
+
+      for (i = 0; i < chunk; i++)
+        if (!input_getc_unless (&buf[i], &proc->exiting))
+          return -1;
+      if (!copy_to_user (ubuf + done, buf, chunk))
+        return done > 0 ? (int) done : -1;
+      done += chunk;
+    }
+  return done;
+}
+
+/* Writes SIZE bytes from user buffer UBUF to the console.  Up to
+   a page at a time goes out in a single putbuf() call, so that
+   output from other processes does not interleave with it.
+   Returns SIZE, or -1 if UBUF is not valid user memory. */
+static int
+console_write (const void *ubuf, unsigned size)
+{
+  char small[128];
+  char *buf = small;
+  size_t buf_size = sizeof small;
+  unsigned done = 0;
+
+  if (size > sizeof small)
+    {
+      size_t want = size < PGSIZE ? size : PGSIZE;
+      char *big = malloc (want);
+      if (big != NULL)
+        {
+          buf = big;
+          buf_size = want;
+        }
     }
-  else
+
+  while (done < size)
     {
-      struct user_file *file = find_user_file (fd);
-      if (file == NULL)
-        return -1;
+      size_t chunk = size - done < buf_size ? size - done : buf_size;
 
-      lock_acquire (&filesys_lock);
-      int bytes = file_read (file->file, buffer, size);
-      lock_release (&filesys_lock);
+      if (!copy_from_user (buf, ubuf + done, chunk))
+        break;
+      putbuf (buf, chunk);
+      done += chunk;
+    }
+
+  if (buf != small)
+    free (buf);
+  return done > 0 || size == 0 ? (int) done : -1;
+}
+
+/* Looks up descriptor FD of the current process and returns its
+   type, or FD_FREE if it is not open.  If FD is a file, the file
+   is read into BUFFER (if TO_FILE is false) or written from it
+   (otherwise) and *BYTES is set to the result.  If FD is the end
+   of a pipe that goes the same way, *PIPE is set to the pipe, with
+   a reference to that end that the caller must drop with
+   pipe_close_end() after using it without FILESYS_LOCK. */
+static enum fd_type
+file_io (int fd, void *buffer, unsigned size, bool to_file, int *bytes,
+         struct pipe **pipe)
+{
+  struct fd *f;
+  enum fd_type type;
 
-      return bytes;
+  lock_acquire (&filesys_lock);
+  f = find_user_fd (fd);
+  type = f != NULL ? f->type : FD_FREE;
+  if (type == FD_FILE)
+    *bytes = file_transfer (f->file, buffer, size, to_file, -1);
+  else if (type == (to_file ? FD_PIPE_WRITE : FD_PIPE_READ))
+    {
+      *pipe = f->pipe;
+      pipe_open_end (*pipe, to_file);
     }
+  lock_release (&filesys_lock);
+
+  return type;
 }
 
-/* Write SIZE bites to an opened file. Returns the size actually written. Also
-  works for STDOUT. */
+/* Reads SIZE bites from an opened file. Returns the size actually read or -1
+  if the file could not be read. Also works for STDIN and for the
+  read end of a pipe, which waits until there is data to read. */
 static int
-write (int fd, const void *buffer, unsigned size)
+read (int fd, void *buffer, unsigned size)
 {
-  if (!is_mem_valid (buffer, size))
-    exit (-1);
-  if (fd == STDOUT_FILENO)
+  struct pipe *p;
+  int bytes = -1;
+
+  switch (file_io (fd, buffer, size, false, &bytes, &p))
     {
-      /* Write to STDOUT. Always writes the full size. */
-      putbuf (buffer, size);
-      return size;
+    case FD_STDIN:
+      /* Read from STDIN. Always reads the full size. */
+      bytes = console_read (buffer, size);
+      break;
+    case FD_PIPE_READ:
+      bytes = pipe_read (p, buffer, size, true);
+      pipe_close_end (p, false);
+      break;
+    default:
+      break;
     }
-  else
-    {
-      struct user_file *file = find_user_file (fd);
-      if (file == NULL)
-        return -1;
+  return bytes;
+}
 
-      lock_acquire (&filesys_lock);
-      int bytes = file_write (file->file, buffer, size);
-      lock_release (&filesys_lock);
+/* Write SIZE bites to an opened file. Returns the size actually written. Also
+  works for STDOUT and for the write end of a pipe, which waits for
+  room as needed. */
+static int
+write (int fd, const void *buffer, unsigned size)
+{
+  struct pipe *p;
+  int bytes = -1;
 
-      return bytes;
+  switch (file_io (fd, (void *) buffer, size, true, &bytes, &p))
+    {
+    case FD_STDOUT:
+      /* Write to STDOUT. Always writes the full size. */
+      bytes = console_write (buffer, size);
+      break;
+    case FD_PIPE_WRITE:
+      bytes = pipe_write (p, buffer, size);
+      pipe_close_end (p, true);
+      break;
+    default:
+      break;
     }
+  return bytes;
 }
 
 /* Changes the position in an opened file. Can reach pass current EOF. */
 static void
 seek (int fd, unsigned position)
 {
-  struct user_file *file = find_user_file (fd);
-  if (file == NULL)
-    return;
-
   lock_acquire (&filesys_lock);
-  file_seek (file->file, position);
+  struct file *file = find_user_file (fd);
+  if (file != NULL)
+    file_seek (file, position);
   lock_release (&filesys_lock);
 }
 
@@ -336,12 +874,9 @@ seek (int fd, unsigned position)
 static unsigned
 tell (int fd)
 {
-  struct user_file *file = find_user_file (fd);
-  if (file == NULL)
-    return 0;
-
   lock_acquire (&filesys_lock);
-  unsigned pos = file_tell (file->file);
+  struct file *file = find_user_file (fd);
+  unsigned pos = file != NULL ? file_tell (file) : 0;
   lock_release (&filesys_lock);
 
   return pos;
@@ -351,31 +886,575 @@ tell (int fd)
 static void
 close (int fd)
 {
-  struct user_file *file = find_user_file (fd);
-  if (file == NULL)
-    return;
-
   lock_acquire (&filesys_lock);
-  file_close (file->file);
+  fd_close (thread_current ()->fd_table, fd);
   lock_release (&filesys_lock);
-
-  list_remove (&file->elem);
-  free (file);
 }
 
-/* Executes an executable file. */
+/* Executes the command line at user address CMD_LINE.  Another
+   thread of the process may change it meanwhile, so it is parsed
+   from a kernel copy. */
 static pid_t
-exec (const char *file)
+exec (const char *cmd_line)
 {
-  if (!is_str_mem_valid (file, PGSIZE))
-    exit (-1);
-  tid_t tid = process_execute (file);
+  char *copy = palloc_get_page (0);
+  tid_t tid = TID_ERROR;
+
+  if (copy == NULL)
+    return -1;
+  if (strncpy_from_user (copy, cmd_line, PGSIZE) >= 0)
+    tid = process_execute (copy);
+  palloc_free_page (copy);
   return tid;
 }
 
+/* Executes FILE with the arguments in the null-terminated array
+   ARGV, or with FILE as its only argument if ARGV is null.  The
+   new process's descriptors are those exec() would give it, as
+   changed by the list of file actions ACTIONS, if not null.
+   With SPAWN_ASYNC in FLAGS, returns without waiting for the
+   program to load.  Returns the new process's pid, or -1 if it
+   cannot be started. */
+static pid_t
+spawn (const char *file, char *const *argv,
+       const struct spawn_action *actions, int flags)
+{
+  struct spawn_action acts[SPAWN_ACTIONS_MAX];
+  struct exec_args args;
+  size_t action_cnt = 0;
+  int copied;
+
+  if ((flags & ~SPAWN_ASYNC) != 0)
+    return -1;
+
+  /* Copy the file actions up to SPAWN_END. */
+  if (actions != NULL)
+    for (;; action_cnt++)
+      {
+        if (action_cnt == SPAWN_ACTIONS_MAX)
+          return -1;
+        if (!copy_from_user (&acts[action_cnt], &actions[action_cnt],
+                             sizeof *acts))
+          exit (-1);
+        if (acts[action_cnt].op == SPAWN_END)
+          break;
+      }
+
+  if (!exec_args_init (&args))
+    return -1;
+  copied = (argv != NULL ? exec_args_from_user (&args, argv)
+            : exec_args_add (&args, file));
+  if (copied != 1 || args.argc == 0)
+    {
+      exec_args_destroy (&args);
+      if (copied < 0)
+        exit (-1);
+      return -1;
+    }
+
+  return process_spawn (file, &args, acts, action_cnt,
+                        (flags & SPAWN_ASYNC) != 0);
+}
+
 /* Waits for a process. */
 static int
 wait (pid_t pid)
 {
   return process_wait (pid);
 }
+
+/* Waits for child process PID, or for whichever child exits
+   first if PID is WAIT_ANY, and stores its exit status into
+   *STATUS unless STATUS is null.  With WNOHANG in OPTIONS, does
+   not wait for a child that is still running.  Returns the pid
+   of the child, 0 if WNOHANG was given and no such child has
+   exited, or -1 if there is no such child. */
+static pid_t
+waitpid (pid_t pid, int *status, int options)
+{
+  int child_status;
+
+  if ((options & ~WNOHANG) != 0)
+    return -1;
+
+  /* Check STATUS first, so as not to lose the child's status. */
+  if (status != NULL && !probe_user_write (status, sizeof *status))
+    exit (-1);
+
+  pid = process_waitpid (pid, &child_status, (options & WNOHANG) != 0);
+  if (pid > 0 && status != NULL
+      && !copy_to_user (status, &child_status, sizeof child_status))
+    exit (-1);
+  return pid;
+}
+
+/* Reports the resource usage of the current process, or of its
+   exited children if WHO is RUSAGE_CHILDREN, in USAGE.  Returns
+   0 if successful, -1 if WHO is not supported. */
+static int
+getrusage (int who, struct rusage *usage)
+{
+  struct thread *t = thread_current ();
+  struct rusage ru;
+  struct usage u;
+
+  if (who != RUSAGE_SELF && who != RUSAGE_CHILDREN)
+    return -1;
+
+  process_get_usage (who == RUSAGE_CHILDREN, &u);
+  ru.ru_minflt = u.min_flt;
+  ru.ru_majflt = u.maj_flt;
+  ru.ru_rss = who == RUSAGE_SELF ? t->proc->rss : 0;
+  ru.ru_held = who == RUSAGE_SELF ? t->proc->held_cnt : 0;
+  ru.ru_utime = u.user_ticks * 1000000 / TIMER_FREQ;
+  ru.ru_stime = u.sys_ticks * 1000000 / TIMER_FREQ;
+  ru.ru_nvcsw = u.vol_switches;
+  ru.ru_nivcsw = u.invol_switches;
+  ru.ru_inbytes = u.read_bytes;
+  ru.ru_outbytes = u.write_bytes;
+  ru.ru_nsyscalls = u.syscalls;
+  if (!copy_to_user (usage, &ru, sizeof ru))
+    exit (-1);
+  return 0;
+}
+
+/* Number of iovec entries that readv() and writev() copy onto the
+   kernel stack; longer arrays are copied into the heap. */
+#define FAST_IOV_CNT 8
+
+/* Copies the IOVCNT entries of user array UIOV into the kernel and
+   checks every buffer they describe, which the caller will read
+   from if TO_FILE is true or write to otherwise.  Uses FAST for the
+   copy if it fits.  Returns the copy, or a null pointer if IOVCNT
+   is out of range, the buffers add up to more than INT_MAX bytes,
+   or memory is short.  Kills the process on a bad user address. */
+static struct iovec *
+import_iovec (const struct iovec *uiov, int iovcnt, bool to_file,
+              struct iovec fast[FAST_IOV_CNT])
+{
+  struct iovec *iov = fast;
+  size_t total = 0;
+  int i;
+
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
+    return NULL;
+  if (iovcnt > FAST_IOV_CNT)
+    {
+      iov = malloc (iovcnt * sizeof *iov);
+      if (iov == NULL)
+        return NULL;
+    }
+
+  if (!copy_from_user (iov, uiov, iovcnt * sizeof *iov))
+    goto bad_address;
+  for (i = 0; i < iovcnt; i++)
+    {
+      if (iov[i].iov_len > INT_MAX - total)
+        {
+          if (iov != fast)
+            free (iov);
+          return NULL;
+        }
+      total += iov[i].iov_len;
+      if (to_file ? !probe_user_read (iov[i].iov_base, iov[i].iov_len)
+                : !probe_user_write (iov[i].iov_base, iov[i].iov_len))
+        goto bad_address;
+    }
+  return iov;
+
+ bad_address:
+  if (iov != fast)
+    free (iov);
+  exit (-1);
+  NOT_REACHED ();
+}
+
+/* Reads from an opened file into the IOVCNT buffers in IOV, in
+   order, stopping early at end of file.  Returns the number of
+   bytes read, or -1 if the file or IOV is invalid.  Also works
+   for STDIN, and for the read end of a pipe, which waits only
+   until there is some data to read. */
+static int
+readv (int fd, const struct iovec *uiov, int iovcnt)
+{
+  struct iovec fast[FAST_IOV_CNT];
+  struct iovec *iov = import_iovec (uiov, iovcnt, false, fast);
+  struct pipe *p = NULL;
+  struct fd *f;
+  enum fd_type type;
+  int bytes = 0;
+  int i;
+
+  if (iov == NULL)
+    return -1;
+
+  lock_acquire (&filesys_lock);
+  f = find_user_fd (fd);
+  type = f != NULL ? f->type : FD_FREE;
+  for (i = 0; type == FD_FILE && i < iovcnt; i++)
+    {
+      int n = file_transfer (f->file, iov[i].iov_base, iov[i].iov_len,
+                             false, -1);
+      if (n < 0)
+        {
+          if (bytes == 0)
+            bytes = -1;
+          break;
+        }
+      bytes += n;
+      if ((size_t) n < iov[i].iov_len)
+        break;
+    }
+  if (type == FD_PIPE_READ)
+    {
+      p = f->pipe;
+      pipe_open_end (p, false);
+    }
+  lock_release (&filesys_lock);
+
+  if (type == FD_STDIN)
+    {
+      for (i = 0; i < iovcnt; i++)
+        {
+          int n = console_read (iov[i].iov_base, iov[i].iov_len);
+          if (n < 0)
+            {
+              if (bytes == 0)
+                bytes = -1;
+              break;
+            }
+          bytes += n;
+        }
+    }
+  else if (type == FD_PIPE_READ)
+    {
+      for (i = 0; i < iovcnt; i++)
+        {
+          int n = pipe_read (p, iov[i].iov_base, iov[i].iov_len,
+                             bytes == 0);
+          if (n < 0)
+            {
+              if (bytes == 0)
+                bytes = -1;
+              break;
+            }
+          bytes += n;
+          if ((size_t) n < iov[i].iov_len)
+            break;
+        }
+      pipe_close_end (p, false);
+    }
+  else if (type != FD_FILE)
+    bytes = -1;
+
+  if (iov != fast)
+    free (iov);
+  return bytes;
+}
+
+/* Writes the IOVCNT buffers in IOV, in order, to an opened file,
+   stopping early if the file cannot grow.  Returns the number of
+   bytes written, or -1 if the file or IOV is invalid.  Also works
+   for STDOUT, and for the write end of a pipe, stopping early
+   there if the pipe loses its readers. */
+static int
+writev (int fd, const struct iovec *uiov, int iovcnt)
+{
+  struct iovec fast[FAST_IOV_CNT];
+  struct iovec *iov = import_iovec (uiov, iovcnt, true, fast);
+  struct pipe *p = NULL;
+  struct fd *f;
+  enum fd_type type;
+  int bytes = 0;
+  int i;
+
+  if (iov == NULL)
+    return -1;
+
+  lock_acquire (&filesys_lock);
+  f = find_user_fd (fd);
+  type = f != NULL ? f->type : FD_FREE;
+  for (i = 0; type == FD_FILE && i < iovcnt; i++)
+    {
+      int n = file_transfer (f->file, iov[i].iov_base, iov[i].iov_len,
+                             true, -1);
+      if (n < 0)
+        {
+          if (bytes == 0)
+            bytes = -1;
+          break;
+        }
+      bytes += n;
+      if ((size_t) n < iov[i].iov_len)
+        break;
+    }
+  if (type == FD_PIPE_WRITE)
+    {
+      p = f->pipe;
+      pipe_open_end (p, true);
+    }
+  lock_release (&filesys_lock);
+
+  if (type == FD_STDOUT)
+    {
+      for (i = 0; i < iovcnt; i++)
+        {
+          int n = console_write (iov[i].iov_base, iov[i].iov_len);
+          if (n < 0)
+            {
+              if (bytes == 0)
+                bytes = -1;
+              break;
+            }
+          bytes += n;
+        }
+    }
+  else if (type == FD_PIPE_WRITE)
+    {
+      for (i = 0; i < iovcnt; i++)
+        {
+          int n = pipe_write (p, iov[i].iov_base, iov[i].iov_len);
+          if (n < 0)
+            {
+              if (bytes == 0)
+                bytes = -1;
+              break;
+            }
+          bytes += n;
+          if ((size_t) n < iov[i].iov_len)
+            break;
+        }
+      pipe_close_end (p, true);
+    }
+  else if (type != FD_FILE)
+    bytes = -1;
+
+  if (iov != fast)
+    free (iov);
+  return bytes;
+}
+
+/* Reads SIZE bytes from an opened file, starting at OFFSET,
+   without moving its position.  Returns the size actually read,
+   or -1 if the file is not open, is the console, or OFFSET is too
+   large. */
+static int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  if (offset > INT_MAX)
+    return -1;
+
+  lock_acquire (&filesys_lock);
+  struct file *file = find_user_file (fd);
+  int bytes = (file != NULL
+               ? file_transfer (file, buffer, size, false, offset) : -1);
+  lock_release (&filesys_lock);
+
+  return bytes;
+}
+
+/* Writes SIZE bytes to an opened file, starting at OFFSET,
+   without moving its position.  Returns the size actually
+   written, or -1 if the file is not open, is the console, or
+   OFFSET is too large. */
+static int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  if (offset > INT_MAX)
+    return -1;
+
+  lock_acquire (&filesys_lock);
+  struct file *file = find_user_file (fd);
+  int bytes = (file != NULL
+               ? file_transfer (file, (void *) buffer, size, true, offset)
+               : -1);
+  lock_release (&filesys_lock);
+
+  return bytes;
+}
+
+/* Creates a pipe and stores descriptors for its read and write
+   ends in FDS[0] and FDS[1].  Returns 0 if successful, -1 if
+   memory or descriptors are short. */
+static int
+pipe (int *ufds)
+{
+  struct fd_table *t = thread_current ()->fd_table;
+  struct pipe *p = pipe_create ();
+  struct fd read_end = {FD_PIPE_READ, false, NULL, p, NULL};
+  struct fd write_end = {FD_PIPE_WRITE, false, NULL, p, NULL};
+  int fds[2];
+
+  if (p == NULL)
+    return -1;
+
+  lock_acquire (&filesys_lock);
+  fds[0] = fd_install (t, &read_end);
+  fds[1] = fds[0] != -1 ? fd_install (t, &write_end) : -1;
+  if (fds[1] == -1)
+    {
+      if (fds[0] != -1)
+        fd_close (t, fds[0]);
+      else
+        pipe_close_end (p, false);
+      pipe_close_end (p, true);
+    }
+  lock_release (&filesys_lock);
+
+  if (fds[1] == -1)
+    return -1;
+  if (!copy_to_user (ufds, fds, sizeof fds))
+    exit (-1);
+  return 0;
+}
+
+/* Makes descriptor NEW_FD refer to what OLD_FD does, closing it
+   first if it is open.  Returns NEW_FD, or -1 if OLD_FD is not
+   open or NEW_FD is out of range. */
+static int
+dup2 (int old_fd, int new_fd)
+{
+  lock_acquire (&filesys_lock);
+  int fd = fd_dup2 (thread_current ()->fd_table, old_fd, new_fd);
+  lock_release (&filesys_lock);
+  return fd;
+}
+
+/* Sets whether processes started with exec() get a copy of
+   descriptor FD.  Descriptors start out not inherited, except
+   STDIN and STDOUT, which always are.  Returns false if FD is not
+   open. */
+static bool
+inherit (int fd, bool on)
+{
+  lock_acquire (&filesys_lock);
+  struct fd *f = find_user_fd (fd);
+  if (f != NULL)
+    f->inherit = on;
+  lock_release (&filesys_lock);
+  return f != NULL;
+}
+
+/* Moves the current process's break by INCREMENT bytes.  Returns
+   the old break, or (void *) -1 if the heap would end below its
+   start or above HEAP_LIMIT.  New heap pages are mapped when
+   first touched, and pages wholly above a lowered break are
+   freed. */
+static void *
+sbrk (intptr_t increment)
+{
+  struct thread *t = thread_current ();
+  struct proc *proc = t->proc;
+  uint8_t *old_brk;
+  uint8_t *upage;
+
+  lock_acquire (&proc->lock);
+  old_brk = proc->heap_brk;
+  if (increment < 0
+      ? (uintptr_t) -increment > (uintptr_t) (old_brk - proc->heap_start)
+      : old_brk > HEAP_LIMIT
+        || (uintptr_t) increment > (uintptr_t) (HEAP_LIMIT - old_brk))
+    {
+      lock_release (&proc->lock);
+      return (void *) -1;
+    }
+
+  proc->heap_brk = old_brk + increment;
+  for (upage = pg_round_up (proc->heap_brk);
+       upage < (uint8_t *) pg_round_up (old_brk); upage += PGSIZE)
+    {
+      enum intr_level old_level;
+      void *kpage;
+
+      /* Same-page merging changes mappings with interrupts off. */
+      old_level = intr_disable ();
+      kpage = pagedir_get_page (t->pagedir, upage);
+      if (kpage != NULL)
+        pagedir_clear_page (t->pagedir, upage);
+      intr_set_level (old_level);
+
+      if (kpage != NULL)
+        {
+          palloc_free_page (kpage);
+          process_uncharge_mem (proc, 1, 0);
+        }
+    }
+  lock_release (&proc->lock);
+  return old_brk;
+}
+
+/* Starts a new thread in the current process, which begins in
+   user mode at START with ARG0 and ARG1 as its arguments.
+   Returns the thread's id, or TID_ERROR on failure. */
+static tid_t
+thread_spawn (void *start, void *arg0, void *arg1)
+{
+  return process_thread_spawn (start, arg0, arg1);
+}
+
+/* Waits for thread TID of the current process and returns its
+   exit value, or -1 if it cannot be joined. */
+static int
+thread_join (tid_t tid)
+{
+  return process_thread_join (tid);
+}
+
+/* Ends the current thread, but not the rest of its process. */
+static void
+exit_thread (int status)
+{
+  process_thread_exit (status);
+}
+
+/* Opens the shared memory segment called NAME, creating it with
+   room for SIZE bytes if it does not exist, and returns a new
+   descriptor for it.  Returns -1 if an existing segment is
+   smaller than SIZE, if SIZE is 0 or too big for a new one, or if
+   memory or descriptors are short. */
+static int
+shm_open (const char *name, unsigned size)
+{
+  struct shm *s = shm_lookup (name, size);
+  struct fd f = {FD_SHM, false, NULL, NULL, s};
+  int fd;
+
+  if (s == NULL)
+    return -1;
+
+  lock_acquire (&filesys_lock);
+  fd = fd_install (thread_current ()->fd_table, &f);
+  lock_release (&filesys_lock);
+
+  if (fd == -1)
+    shm_release (s);
+  return fd;
+}
+
+/* Maps the whole shared memory segment open as descriptor FD into
+   the current process and returns its address.  The mapping
+   lasts until the process exits, even if FD is closed.  Returns a
+   null pointer if FD is not a shared memory segment, or if there
+   is no room for it. */
+static void *
+shm_map (int fd)
+{
+  struct shm *s = NULL;
+  struct fd *f;
+  void *addr;
+
+  lock_acquire (&filesys_lock);
+  f = find_user_fd (fd);
+  if (f != NULL && f->type == FD_SHM)
+    {
+      s = f->shm;
+      shm_reopen (s);
+    }
+  lock_release (&filesys_lock);
+
+  if (s == NULL)
+    return NULL;
+  addr = shm_attach (s);
+  shm_release (s);
+  return addr;
+}
@@ -1,6 +1,25 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include <stdint.h>
+#include "threads/synch.h"
+
+struct intr_frame;
+
+/* Serializes file system access and changes to descriptor
+   tables. */
+extern struct lock filesys_lock;
+
+/* Most arguments a system call takes. */
+#define SYSCALL_MAX_ARGS 4
+
 void syscall_init (void);
+void syscall_print_stats (void);
+int32_t syscall_run_async (uint32_t nr,
+                           const uint32_t args[SYSCALL_MAX_ARGS]);
+
+/* SYSENTER entry point in sysenter.S, and the handler it calls. */
+void sysenter_entry (void);
+void syscall_sysenter (struct intr_frame *);
 
 #endif /* userprog/syscall.h */
@@ -2,6 +2,8 @@
 #include <debug.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
+#include "userprog/syscall.h"
+#include "threads/init.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -75,6 +77,21 @@ struct tss
 /* Kernel TSS. */
 static struct tss *tss;
 
+/* Model-specific registers that configure SYSENTER.  See
+   [IA32-v3a] 5.8.7 "Performing Fast Calls to System Procedures
+   with the SYSENTER and SYSEXIT Instructions". */
+#define MSR_SYSENTER_CS 0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+
+/* Stack pointer that SYSENTER loads: the last word of the TSS's
+   page, which tss_update() keeps equal to esp0.  The unused part
+   of the page below it is stack enough for the debug trap
+   described in kill() in exception.c. */
+static void **sysenter_esp;
+
+static void sysenter_init (void);
+
 /* Initializes the kernel TSS. */
 void
 tss_init (void) 
@@ -85,7 +102,9 @@ tss_init (void)
   tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   tss->ss0 = SEL_KDSEG;
   tss->bitmap = 0xdfff;
+  sysenter_esp = (void **) ((uint8_t *) tss + PGSIZE) - 1;
   tss_update ();
+  sysenter_init ();
 }
 
 /* Returns the kernel TSS. */
@@ -103,4 +122,34 @@ tss_update (void)
 {
   ASSERT (tss != NULL);
   tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
+  *sysenter_esp = tss->esp0;
+}
+
+/* Writes VALUE to model-specific register MSR. */
+static inline void
+wrmsr (uint32_t msr, uint64_t value)
+{
+  asm volatile ("wrmsr" : : "c" (msr), "A" (value));
+}
+
+/* Enables the SYSENTER fast system call path, if the CPU has it.
+
+   SYSENTER loads the kernel %cs from MSR_SYSENTER_CS and %ss from
+   the GDT entry after it, and SYSEXIT loads the user %cs and %ss
+   from the two entries after those, so our GDT must list its
+   segments in that order.  SYSENTER does not look at the TSS, so
+   its stack pointer is SYSENTER_ESP, from which sysenter_entry
+   loads the current thread's kernel stack. */
+static void
+sysenter_init (void)
+{
+  if (!(cpu_features () & CPUID_SEP))
+    return;
+
+  ASSERT (SEL_KDSEG == SEL_KCSEG + 8);
+  ASSERT (SEL_UCSEG == ((SEL_KCSEG + 16) | 3));
+  ASSERT (SEL_UDSEG == ((SEL_KCSEG + 24) | 3));
+  wrmsr (MSR_SYSENTER_CS, SEL_KCSEG);
+  wrmsr (MSR_SYSENTER_ESP, (uintptr_t) sysenter_esp);
+  wrmsr (MSR_SYSENTER_EIP, (uintptr_t) sysenter_entry);
 }
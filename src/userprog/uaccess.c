@@ -0,0 +1,202 @@
+#include "userprog/uaccess.h"
+#include <debug.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/vaddr.h"
+
+/* Access to user memory.
+
+   These functions touch user memory directly instead of first
+   looking up every page in the page directory.  Each instruction
+   that may fault on a bad user address is listed in the
+   exception table, the __ex_table section, together with a fixup
+   address.  When such an instruction faults, page_fault() calls
+   uaccess_fixup(), which resumes execution at the fixup, and the
+   function reports the error to its caller.
+
+   Addresses are still checked against PHYS_BASE first, because
+   a kernel address would not fault. */
+
+/* An exception table entry. */
+struct ex_entry
+  {
+    uintptr_t insn;             /* Instruction that may fault. */
+    uintptr_t fixup;            /* Where to resume if it does. */
+  };
+
+/* Bounds of the exception table, from kernel.lds.S. */
+extern const struct ex_entry _start_ex_table[], _end_ex_table[];
+
+/* Adds an exception table entry for the instruction at local
+   label INSN, resuming at local label FIXUP. */
+#define EX_TABLE(INSN, FIXUP)                   \
+        ".pushsection __ex_table, \"a\"\n"      \
+        ".long " INSN ", " FIXUP "\n"           \
+        ".popsection\n"
+
+/* Returns true if the SIZE bytes at UADDR all lie in user
+   virtual memory. */
+static inline bool
+is_user_range (const void *uaddr, size_t size)
+{
+  uintptr_t start = (uintptr_t) uaddr;
+  return start + size >= start && start + size <= (uintptr_t) PHYS_BASE;
+}
+
+/* Copies SIZE bytes from SRC to DST, where either may be a user
+   address.  Returns false if the copy faulted. */
+static bool
+user_copy (void *dst, const void *src, size_t size)
+{
+  bool ok;
+  asm volatile ("1: rep movsb\n"
+                "   movb $1, %0\n"
+                "   jmp 3f\n"
+                "2: movb $0, %0\n"
+                "3:\n"
+                EX_TABLE ("1b", "2b")
+                : "=q" (ok), "+D" (dst), "+S" (src), "+c" (size)
+                : : "memory");
+  return ok;
+}
+
+/* Reads the byte at user address USRC into *DST.  Returns false
+   if the read faulted. */
+static inline bool
+get_user (uint8_t *dst, const uint8_t *usrc)
+{
+  bool ok;
+  asm volatile ("1: movb %2, %1\n"
+                "   movb $1, %0\n"
+                "   jmp 3f\n"
+                "2: movb $0, %0\n"
+                "3:\n"
+                EX_TABLE ("1b", "2b")
+                : "=&q" (ok), "=&q" (*dst) : "m" (*usrc));
+  return ok;
+}
+
+/* Writes the byte at user address UDST back unchanged, which
+   faults unless the page is writable.  Returns false if the
+   write faulted. */
+static inline bool
+touch_user (uint8_t *udst)
+{
+  bool ok;
+  asm volatile ("1: orb $0, %1\n"
+                "   movb $1, %0\n"
+                "   jmp 3f\n"
+                "2: movb $0, %0\n"
+                "3:\n"
+                EX_TABLE ("1b", "2b")
+                : "=q" (ok), "+m" (*udst));
+  return ok;
+}
+
+/* Copies SIZE bytes from user address USRC to DST.  Returns true
+   if successful, false if USRC is not valid user memory. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  return is_user_range (usrc, size) && user_copy (dst, usrc, size);
+}
+
+/* Copies SIZE bytes from SRC to user address UDST.  Returns true
+   if successful, false if UDST is not valid, writable user
+   memory. */
+bool
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  return is_user_range (udst, size) && user_copy (udst, src, size);
+}
+
+/* Copies the string at user address USRC into the SIZE-byte
+   buffer DST, truncating it if necessary, and always null
+   terminates DST.  SIZE must be at least 1.  Returns the length
+   of the string copied, or -1 if USRC is not valid user
+   memory. */
+int
+strncpy_from_user (char *dst, const char *usrc, size_t size)
+{
+  const uint8_t *p = (const uint8_t *) usrc;
+  size_t len;
+
+  ASSERT (size > 0);
+  for (len = 0; len < size - 1; len++, p++)
+    if (!is_user_vaddr (p) || !get_user ((uint8_t *) &dst[len], p))
+      return -1;
+    else if (dst[len] == '\0')
+      return len;
+  dst[len] = '\0';
+  return len;
+}
+
+/* Returns the length of the string at user address USTR, or MAX
+   if it has no null terminator within its first MAX bytes.
+   Returns -1 if USTR is not valid user memory. */
+int
+strnlen_user (const char *ustr, size_t max)
+{
+  const uint8_t *p = (const uint8_t *) ustr;
+  size_t len;
+
+  for (len = 0; len < max; len++, p++)
+    {
+      uint8_t c;
+      if (!is_user_vaddr (p) || !get_user (&c, p))
+        return -1;
+      if (c == '\0')
+        break;
+    }
+  return len;
+}
+
+/* Returns true if the SIZE bytes at user address UADDR can be
+   read.  Only one byte in each page is actually read. */
+bool
+probe_user_read (const void *uaddr, size_t size)
+{
+  const uint8_t *p = uaddr;
+  const uint8_t *end = p + size;
+  uint8_t c;
+
+  if (!is_user_range (uaddr, size))
+    return false;
+  for (; p < end; p = (const uint8_t *) pg_round_down (p) + PGSIZE)
+    if (!get_user (&c, p))
+      return false;
+  return true;
+}
+
+/* Returns true if the SIZE bytes at user address UADDR can be
+   written.  One byte in each page is written back unchanged,
+   which also breaks any copy-on-write sharing up front. */
+bool
+probe_user_write (void *uaddr, size_t size)
+{
+  uint8_t *p = uaddr;
+  uint8_t *end = p + size;
+
+  if (!is_user_range (uaddr, size))
+    return false;
+  for (; p < end; p = (uint8_t *) pg_round_down (p) + PGSIZE)
+    if (!touch_user (p))
+      return false;
+  return true;
+}
+
+/* If the kernel instruction that faulted in F is in the exception
+   table, makes F resume at its fixup and returns true. */
+bool
+uaccess_fixup (struct intr_frame *f)
+{
+  const struct ex_entry *e;
+
+  for (e = _start_ex_table; e < _end_ex_table; e++)
+    if (e->insn == (uintptr_t) f->eip)
+      {
+        f->eip = (void (*) (void)) e->fixup;
+        return true;
+      }
+  return false;
+}
@@ -0,0 +1,375 @@
+#include "vm/ksm.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/futex.h"
+#include "userprog/pagedir.h"
+
+/* Same-page merging.
+
+   ksmd is a low-priority kernel thread that periodically walks
+   the page directories of all user processes looking for pages
+   with identical contents.  Each page that is not yet shared is
+   checksummed and looked up in two tables: the stable table of
+   frames that are already shared copy-on-write, and the unstable
+   table of pages seen earlier in the same pass.  A match is
+   confirmed with memcmp() and the duplicate's mapping is pointed
+   at the shared frame, read-only and copy-on-write, before its
+   own frame is freed.  Pages in the unstable table are still
+   writable, so the table is only trusted for one pass.
+
+   The stable table holds a reference to each of its frames, which
+   keeps them allocated and unchanged for as long as they are in
+   the table.  Frames that only the table still refers to are
+   dropped at the end of every pass.
+
+   A stable frame is shared by at most KSM_REFS_MAX mappings.  Once
+   it has that many, it leaves the stable table, though it stays
+   on stable_list until it is pruned, and the next page with the
+   same contents starts a new stable frame.
+
+   Checks and page table updates that must agree with each other
+   are made with interrupts off, so the owning process cannot
+   write a page between its comparison and its merge.  ksm_lock
+   is held while a process is scanned, which keeps its page
+   directory from being destroyed, but is dropped between
+   processes so that exiting processes need not wait for a whole
+   pass.  Pages that a thread is waiting on with futex_wait() are
+   left alone, since merging would move the waiter's int to
+   another frame. */
+
+/* Ticks between passes. */
+#define KSM_SCAN_INTERVAL TIMER_FREQ
+
+/* Most references ksmd gives a stable frame.  This leaves room
+   below PALLOC_REFS_MAX for the frame's other sharers, such as
+   processes that inherit the mapping. */
+#define KSM_REFS_MAX (PALLOC_REFS_MAX / 2)
+
+/* A frame in the stable or unstable table. */
+struct ksm_node
+  {
+    struct hash_elem hash_elem;         /* Element in stable or unstable. */
+    struct list_elem list_elem;         /* Element in stable_list. */
+    unsigned checksum;                  /* Checksum of the contents. */
+    bool full;                          /* Stable, but out of the table
+                                           with KSM_REFS_MAX refs? */
+    void *kpage;                        /* The frame. */
+    uint32_t *pd;                       /* Where an unstable frame */
+    void *upage;                        /* was found mapped. */
+  };
+
+/* Processes to scan, linked through their ksm_elem. */
+static struct list ksm_processes;
+
+/* Protects ksm_processes, scan_next and the tables. */
+static struct lock ksm_lock;
+
+/* Next process the current pass scans, or null. */
+static struct list_elem *scan_next;
+
+/* Shared frames, by checksum and in a list for pruning. */
+static struct hash stable;
+static struct list stable_list;
+
+/* Candidate pages from the current pass, by checksum. */
+static struct hash unstable;
+
+/* Statistics. */
+static long long pages_shared;          /* Frames in the stable table. */
+static long long pages_sharing;         /* Mappings of those frames. */
+static long long merge_cnt;             /* Pages merged. */
+static long long pass_cnt;              /* Completed passes. */
+
+static thread_func ksmd;
+static void ksm_scan (void);
+static void scan_page (uint32_t *pd, void *upage);
+static bool promote_node (struct ksm_node *, const void *kpage);
+static void merge_page (uint32_t *pd, void *upage, void *kpage,
+                        void *shared);
+static void prune_stable (void);
+static unsigned page_checksum (const void *kpage);
+static hash_hash_func node_hash;
+static hash_less_func node_less;
+static hash_action_func node_free;
+
+/* Starts ksmd. */
+void
+ksm_init (void) 
+{
+  list_init (&ksm_processes);
+  lock_init (&ksm_lock);
+  list_init (&stable_list);
+  if (!hash_init (&stable, node_hash, node_less, NULL)
+      || !hash_init (&unstable, node_hash, node_less, NULL))
+    PANIC ("ksm: out of memory");
+  thread_create ("ksmd", PRI_MIN, ksmd, NULL);
+}
+
+/* Makes ksmd scan the pages of process T, whose executable must
+   be fully loaded. */
+void
+ksm_enter (struct thread *t) 
+{
+  ASSERT (!t->ksm_scanned);
+
+  lock_acquire (&ksm_lock);
+  list_push_back (&ksm_processes, &t->ksm_elem);
+  t->ksm_scanned = true;
+  lock_release (&ksm_lock);
+}
+
+/* Stops ksmd from scanning process T.  Once this returns, T's
+   page directory may be destroyed.  Candidates from T may be in
+   the unstable table, so the table is emptied, and the rest of
+   the current pass merges fewer pages. */
+void
+ksm_exit (struct thread *t) 
+{
+  if (!t->ksm_scanned)
+    return;
+
+  lock_acquire (&ksm_lock);
+  if (scan_next == &t->ksm_elem)
+    scan_next = list_next (scan_next);
+  list_remove (&t->ksm_elem);
+  t->ksm_scanned = false;
+  hash_clear (&unstable, node_free);
+  lock_release (&ksm_lock);
+}
+
+/* Prints same-page merging statistics. */
+void
+ksm_print_stats (void) 
+{
+  printf ("KSM: %lld pages shared, %lld pages saved, "
+          "%lld merges in %lld passes\n",
+          pages_shared, pages_sharing - pages_shared, merge_cnt, pass_cnt);
+}
+
+/* Scans all processes once every KSM_SCAN_INTERVAL ticks. */
+static void
+ksmd (void *aux UNUSED) 
+{
+  for (;;)
+    {
+      timer_sleep (KSM_SCAN_INTERVAL);
+      ksm_scan ();
+    }
+}
+
+/* Makes one pass over the pages of every process.  ksm_exit()
+   moves scan_next past a process that exits while ksm_lock is
+   dropped. */
+static void
+ksm_scan (void) 
+{
+  lock_acquire (&ksm_lock);
+  scan_next = list_begin (&ksm_processes);
+  while (scan_next != list_end (&ksm_processes))
+    {
+      struct thread *t = list_entry (scan_next, struct thread, ksm_elem);
+      uint32_t *pd = t->pagedir;
+      uint8_t *upage;
+
+      for (upage = pagedir_next_page (pd, 0); upage != NULL;
+           upage = pagedir_next_page (pd, upage + PGSIZE))
+        scan_page (pd, upage);
+
+      scan_next = list_next (scan_next);
+      lock_release (&ksm_lock);
+      lock_acquire (&ksm_lock);
+    }
+  scan_next = NULL;
+  hash_clear (&unstable, node_free);
+  prune_stable ();
+  pass_cnt++;
+  lock_release (&ksm_lock);
+}
+
+/* Merges UPAGE in PD with an identical page, if one is known, or
+   remembers it as a candidate for later pages of this pass. */
+static void
+scan_page (uint32_t *pd, void *upage) 
+{
+  void *kpage = pagedir_get_page (pd, upage);
+  struct ksm_node key, *node;
+  struct hash_elem *e;
+
+  if (!palloc_is_user_page (kpage) || palloc_page_refs (kpage) > 1)
+    return;
+
+  key.checksum = page_checksum (kpage);
+  e = hash_find (&stable, &key.hash_elem);
+  if (e != NULL)
+    {
+      node = hash_entry (e, struct ksm_node, hash_elem);
+      if (palloc_page_refs (node->kpage) < KSM_REFS_MAX)
+        {
+          merge_page (pd, upage, kpage, node->kpage);
+          return;
+        }
+
+      /* Let this page start a new stable frame. */
+      hash_delete (&stable, &node->hash_elem);
+      node->full = true;
+    }
+
+  e = hash_find (&unstable, &key.hash_elem);
+  if (e != NULL)
+    {
+      node = hash_entry (e, struct ksm_node, hash_elem);
+      if (node->kpage != kpage && promote_node (node, kpage))
+        {
+          node->checksum = key.checksum;
+          node->full = false;
+          hash_insert (&stable, &node->hash_elem);
+          list_push_back (&stable_list, &node->list_elem);
+          pages_shared++;
+          merge_page (pd, upage, kpage, node->kpage);
+        }
+      return;
+    }
+
+  node = malloc (sizeof *node);
+  if (node != NULL)
+    {
+      node->checksum = key.checksum;
+      node->kpage = kpage;
+      node->pd = pd;
+      node->upage = upage;
+      hash_insert (&unstable, &node->hash_elem);
+    }
+}
+
+/* Moves unstable NODE out of the unstable table and write-protects
+   its page, if the page is still mapped where it was found and
+   still matches KPAGE.  On success the caller must add NODE to
+   the stable table; otherwise NODE is freed. */
+static bool
+promote_node (struct ksm_node *node, const void *kpage) 
+{
+  enum intr_level old_level;
+  bool success;
+
+  hash_delete (&unstable, &node->hash_elem);
+
+  old_level = intr_disable ();
+  success = (pagedir_get_page (node->pd, node->upage) == node->kpage
+             && palloc_page_refs (node->kpage) < KSM_REFS_MAX
+             && !futex_page_busy (node->kpage)
+             && memcmp (node->kpage, kpage, PGSIZE) == 0);
+  if (success)
+    {
+      pagedir_set_cow (node->pd, node->upage);
+      palloc_ref_page (node->kpage);
+    }
+  intr_set_level (old_level);
+
+  if (!success)
+    free (node);
+  return success;
+}
+
+/* Maps UPAGE in PD, currently backed by KPAGE, to the identical
+   stable frame SHARED instead, and frees KPAGE. */
+static void
+merge_page (uint32_t *pd, void *upage, void *kpage, void *shared) 
+{
+  enum intr_level old_level;
+  bool merged;
+
+  old_level = intr_disable ();
+  merged = (pagedir_get_page (pd, upage) == kpage
+            && !futex_page_busy (kpage)
+            && memcmp (kpage, shared, PGSIZE) == 0);
+  if (merged)
+    {
+      pagedir_set_cow (pd, upage);
+      pagedir_remap_page (pd, upage, shared);
+      palloc_ref_page (shared);
+    }
+  intr_set_level (old_level);
+
+  if (merged)
+    {
+      palloc_free_page (kpage);
+      merge_cnt++;
+    }
+}
+
+/* Drops stable frames that are no longer mapped anywhere and
+   recounts the mappings of the rest. */
+static void
+prune_stable (void) 
+{
+  struct list_elem *e, *next;
+  long long sharing = 0;
+
+  for (e = list_begin (&stable_list); e != list_end (&stable_list); e = next)
+    {
+      struct ksm_node *node = list_entry (e, struct ksm_node, list_elem);
+      unsigned refs = palloc_page_refs (node->kpage);
+
+      next = list_next (e);
+      if (refs == 1)
+        {
+          if (!node->full)
+            hash_delete (&stable, &node->hash_elem);
+          list_remove (&node->list_elem);
+          palloc_free_page (node->kpage);
+          free (node);
+          pages_shared--;
+        }
+      else
+        sharing += refs - 1;
+    }
+  pages_sharing = sharing;
+}
+
+/* Returns a checksum of the page at KPAGE.  This is 32-bit FNV-1a,
+   like hash_bytes(), but taken a word at a time. */
+static unsigned
+page_checksum (const void *kpage) 
+{
+  const uint32_t *word = kpage;
+  unsigned hash = 2166136261u;
+  size_t i;
+
+  for (i = 0; i < PGSIZE / sizeof *word; i++)
+    hash = (hash ^ word[i]) * 16777619u;
+  return hash;
+}
+
+/* Returns the checksum of the node containing hash element E. */
+static unsigned
+node_hash (const struct hash_elem *e, void *aux UNUSED) 
+{
+  return hash_entry (e, struct ksm_node, hash_elem)->checksum;
+}
+
+/* Orders nodes by checksum. */
+static bool
+node_less (const struct hash_elem *a, const struct hash_elem *b,
+           void *aux UNUSED) 
+{
+  return (hash_entry (a, struct ksm_node, hash_elem)->checksum
+          < hash_entry (b, struct ksm_node, hash_elem)->checksum);
+}
+
+/* Frees the node containing hash element E. */
+static void
+node_free (struct hash_elem *e, void *aux UNUSED) 
+{
+  free (hash_entry (e, struct ksm_node, hash_elem));
+}
@@ -0,0 +1,11 @@
+#ifndef VM_KSM_H
+#define VM_KSM_H
+
+struct thread;
+
+void ksm_init (void);
+void ksm_enter (struct thread *);
+void ksm_exit (struct thread *);
+void ksm_print_stats (void);
+
+#endif /* vm/ksm.h */